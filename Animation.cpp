@@ -0,0 +1,182 @@
+#include "Animation.h"
+#include "CompressedClip.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+using namespace std;
+
+void loadPosFile(const string &filename, vector<float> &posArray)
+{
+	ifstream file(filename);
+	int index;
+	float val;
+	while (file >> index >> val) {
+		posArray.push_back(val);
+	}
+	file.close();
+}
+
+Quat4f eulerToQuaternion(const float *angles)
+{
+	// The product of the rotations about each axis, from the half angles. Going
+	// through the rotation matrix loses precision near half turns, where
+	// Quat4f::fromRotationMatrix() also flips the sign of w (inverting the rotation).
+	Quat4f rotateX(cos(angles[0] / 2), sin(angles[0] / 2), 0, 0),
+		rotateY(cos(angles[1] / 2), 0, sin(angles[1] / 2), 0),
+		rotateZ(cos(angles[2] / 2), 0, 0, sin(angles[2] / 2));
+	return (rotateX * rotateY * rotateZ).normalized();
+}
+
+unsigned AnimationClip::numFrames(float fps) const
+{
+	if (empty())
+		return 0;
+	// Tolerate rounding, e.g. so that 1 s at 30 fps has 31 frames
+	return (unsigned) floor(duration() * fps + 1e-3f) + 1;
+}
+
+AnimationClip *loadAnimationClip(const string &filename, const vector<bool> &controlIsTranslation)
+{
+	if (filename.size() >= 5 && filename.compare(filename.size() - 5, 5, ".clip") == 0) {
+		CompressedClip *clip = new CompressedClip();
+		if (clip->load(filename))
+			return clip;
+		delete clip;
+	}
+	else {
+		KeyframeClip *clip = new KeyframeClip();
+		if (clip->load(filename.c_str(), controlIsTranslation))
+			return clip;
+		delete clip;
+	}
+	return NULL;
+}
+
+KeyframeClip::KeyframeClip()
+	: m_interpolation(ROTATION_SQUAD)
+{
+}
+
+bool KeyframeClip::load(const char *animFilename, const vector<bool> &controlIsTranslation)
+{
+	ifstream file(animFilename);
+	string filename(animFilename), fileDir;
+	float nextSecs;
+	vector<float> keyframe;
+	vector<vector<float>> keyframes;
+
+	m_numControls = 0;
+	m_trackIsRotation.clear();
+	m_times.clear();
+	m_translationControls.clear();
+	m_rotationTracks.clear();
+	m_translations.clear();
+	m_rotations.clear();
+	m_tangents.clear();
+	if (!file)
+		return false;
+
+	fileDir = "";
+	if (filename.find('/') != string::npos)
+		fileDir = filename.substr(0, filename.rfind('/') + 1);
+
+	if (!(file >> filename))
+		return false;
+	loadPosFile(fileDir + filename, keyframe);
+	keyframes.push_back(keyframe);
+	m_times.push_back(0);
+
+	while (file >> nextSecs >> filename) {
+		keyframe.clear();
+		loadPosFile(fileDir + filename, keyframe);
+		keyframes.push_back(keyframe);
+		m_times.push_back(m_times.back() + max(nextSecs, 0.f));
+	}
+	file.close();
+
+	// Whole tracks only; missing values are 0
+	m_numControls = (keyframes[0].size() + 2) / 3 * 3;
+	for (auto &values : keyframes)
+		values.resize(m_numControls, 0.f);
+
+	for (int track = 0, numTracks = m_numControls / 3; track < numTracks; ++track) {
+		bool isTranslation = 3 * track < (int) controlIsTranslation.size() && controlIsTranslation[3 * track];
+		if (isTranslation)
+			for (int k = 0; k < 3; ++k)
+				m_translationControls.push_back(3 * track + k);
+		else
+			m_rotationTracks.push_back(track);
+		m_trackIsRotation.push_back(!isTranslation);
+	}
+
+	int numKeyframes = keyframes.size(), numRotations = m_rotationTracks.size();
+	for (auto &values : keyframes) {
+		for (int control : m_translationControls)
+			m_translations.push_back(values[control]);
+		for (int track : m_rotationTracks)
+			m_rotations.push_back(eulerToQuaternion(&values[3 * track]));
+	}
+
+	// Keep every rotation in the hemisphere of the previous keyframe, so that
+	// tangents and interpolation take the shorter arc
+	for (int k = 1; k < numKeyframes; ++k)
+		for (int r = 0; r < numRotations; ++r) {
+			Quat4f &q = m_rotations[k * numRotations + r];
+			if (Quat4f::dot(q, m_rotations[(k - 1) * numRotations + r]) < 0)
+				q = Quat4f(-q[0], -q[1], -q[2], -q[3]);
+		}
+
+	// Squad tangents, the end keyframes being their own neighbors
+	m_tangents.resize(m_rotations.size());
+	for (int k = 0; k < numKeyframes; ++k)
+		for (int r = 0; r < numRotations; ++r) {
+			const Quat4f &before = m_rotations[max(k - 1, 0) * numRotations + r],
+				&center = m_rotations[k * numRotations + r],
+				&after = m_rotations[min(k + 1, numKeyframes - 1) * numRotations + r];
+			Quat4f tangent = Quat4f::squadTangent(before, center, after);
+			// The log of a quaternion rounded just above unit length is not a number
+			bool valid = true;
+			for (int i = 0; i < 4; ++i)
+				valid = valid && tangent[i] == tangent[i];
+			m_tangents[k * numRotations + r] = valid ? tangent.normalized() : center;
+		}
+
+	return true;
+}
+
+void KeyframeClip::sample(float t, vector<float> &values, vector<Quat4f> &rotations) const
+{
+	values.resize(m_numControls);
+	rotations.resize(m_numControls / 3);
+	if (empty())
+		return;
+
+	// Keyframe at or before t, and the next one
+	int numKeyframes = m_times.size();
+	int k = upper_bound(m_times.begin(), m_times.end(), t) - m_times.begin() - 1;
+	k = min(max(k, 0), numKeyframes - 1);
+	int next = min(k + 1, numKeyframes - 1);
+
+	float s = 0;
+	if (next > k && m_times[next] > m_times[k])
+		s = min(max((t - m_times[k]) / (m_times[next] - m_times[k]), 0.f), 1.f);
+
+	int numTranslations = m_translationControls.size();
+	const float *from = m_translations.data() + k * numTranslations, *to = m_translations.data() + next * numTranslations;
+	for (int i = 0; i < numTranslations; ++i)
+		values[m_translationControls[i]] = from[i] + s * (to[i] - from[i]);
+
+	int numRotations = m_rotationTracks.size();
+	const Quat4f *a = m_rotations.data() + k * numRotations, *b = m_rotations.data() + next * numRotations;
+	if (m_interpolation == ROTATION_SQUAD) {
+		const Quat4f *tanA = m_tangents.data() + k * numRotations, *tanB = m_tangents.data() + next * numRotations;
+		for (int r = 0; r < numRotations; ++r)
+			rotations[m_rotationTracks[r]] = Quat4f::squad(a[r], tanA[r], tanB[r], b[r], s).normalized();
+	}
+	else {
+		for (int r = 0; r < numRotations; ++r)
+			rotations[m_rotationTracks[r]] = Quat4f::slerp(a[r], b[r], s).normalized();
+	}
+}
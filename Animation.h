@@ -0,0 +1,95 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <string>
+#include <vector>
+#include <vecmath.h>
+
+// Read the control values of a .pos file ("index value" per line)
+void loadPosFile(const std::string &filename, std::vector<float> &posArray);
+
+// An animation of control values, sampled at any time on demand.
+// Controls are grouped in tracks of 3 (XYZ), like the sliders; a track is
+// either a translation or a joint rotation.
+class AnimationClip
+{
+public:
+	AnimationClip() : m_numControls(0) { }
+	virtual ~AnimationClip() { }
+
+	int numControls() const { return m_numControls; }
+	bool trackIsRotation(int track) const { return m_trackIsRotation[track]; }
+
+	virtual bool empty() const = 0;
+	virtual float duration() const = 0;
+
+	// Number of frames in [0, duration()] at fps, the first and last included
+	unsigned numFrames(float fps) const;
+
+	// Pose at time t in seconds, clamped to [0, duration()]. values is resized to
+	// numControls() and receives the translation controls; rotations is resized
+	// to numControls() / 3 and receives the unit rotation of every rotation track.
+	// Neither allocates after the first call.
+	virtual void sample(float t, std::vector<float> &values, std::vector<Quat4f> &rotations) const = 0;
+
+protected:
+	int m_numControls;
+	std::vector<bool> m_trackIsRotation;
+};
+
+// Load an .anim file (as a KeyframeClip) or a .clip file (as a CompressedClip).
+// Returns NULL if nothing could be loaded.
+AnimationClip *loadAnimationClip(const std::string &filename, const std::vector<bool> &controlIsTranslation);
+
+// The keyframes of an .anim file, sampled at any time on demand.
+// Only the keyframe poses are stored, so memory does not depend on the
+// duration or the frame rate.
+//
+// Translation tracks are interpolated linearly. Rotation tracks are converted once to
+// quaternions and interpolated in quaternion space, by squad through
+// tangents precomputed per keyframe (or by plain slerp), which avoids the
+// gimbal artifacts of interpolating Euler angles independently.
+class KeyframeClip : public AnimationClip
+{
+public:
+	enum RotationInterpolation
+	{
+		ROTATION_SLERP,		// one slerp per joint, continuous but not smooth at keyframes
+		ROTATION_SQUAD		// smooth through the keyframes (default)
+	};
+
+	KeyframeClip();
+
+	// Load an .anim file and the .pos files it refers to.
+	// Returns false (and leaves the clip empty) if nothing was loaded.
+	bool load(const char *animFilename, const std::vector<bool> &controlIsTranslation);
+
+	bool empty() const { return m_times.empty(); }
+	int numKeyframes() const { return m_times.size(); }
+	float duration() const { return empty() ? 0.f : m_times.back(); }
+
+	void setRotationInterpolation(RotationInterpolation interpolation) { m_interpolation = interpolation; }
+
+	void sample(float t, std::vector<float> &values, std::vector<Quat4f> &rotations) const;
+
+private:
+	RotationInterpolation m_interpolation;
+
+	// Start time of every keyframe, from 0 to the duration
+	std::vector<float> m_times;
+
+	// Controls of the translation tracks, and the rotation tracks
+	std::vector<int> m_translationControls;
+	std::vector<int> m_rotationTracks;
+
+	// Per keyframe: the translation controls, then the rotation (and its
+	// squad tangent) of every rotation track, in the order of the lists above
+	std::vector<float> m_translations;
+	std::vector<Quat4f> m_rotations;
+	std::vector<Quat4f> m_tangents;
+};
+
+// Quaternion of the XYZ Euler angles of a joint control track (Rx * Ry * Rz)
+Quat4f eulerToQuaternion(const float *angles);
+
+#endif // ANIMATION_H
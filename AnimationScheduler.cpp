@@ -0,0 +1,72 @@
+#include "AnimationScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+AnimationScheduler::AnimationScheduler()
+	: m_period(1.0 / 30), m_numFrames(0), m_repeat(false), m_playing(false), m_currentSlot(-1),
+	m_onTimeFrames(0), m_lateFrames(0), m_droppedFrames(0)
+{
+}
+
+void AnimationScheduler::start(unsigned numFrames, unsigned fps, bool repeat)
+{
+	m_startTime = Clock::now();
+	m_period = 1.0 / max(fps, 1u);
+	m_numFrames = numFrames;
+	m_repeat = repeat;
+	m_playing = numFrames > 0;
+	m_currentSlot = -1;
+	m_onTimeFrames = m_lateFrames = m_droppedFrames = 0;
+}
+
+void AnimationScheduler::stop()
+{
+	m_playing = false;
+}
+
+AnimationScheduler::Clock::time_point AnimationScheduler::slotTime(long long slot) const
+{
+	return m_startTime + chrono::duration_cast<Clock::duration>(chrono::duration<double>(slot * m_period));
+}
+
+bool AnimationScheduler::beginFrame(float &t)
+{
+	if (!m_playing)
+		return false;
+
+	double elapsedSecs = chrono::duration<double>(Clock::now() - m_startTime).count();
+	long long slot = (long long) floor(elapsedSecs / m_period);
+	if (slot <= m_currentSlot)
+		return false;
+
+	// A play-once animation always ends on its last frame
+	if (!m_repeat && slot >= (long long) m_numFrames) {
+		if (m_currentSlot >= (long long) m_numFrames - 1) {
+			m_playing = false;
+			return false;
+		}
+		slot = m_numFrames - 1;
+	}
+
+	m_droppedFrames += (unsigned) (slot - m_currentSlot - 1);
+	m_currentSlot = slot;
+	t = (float) ((slot % m_numFrames) * m_period);
+	return true;
+}
+
+void AnimationScheduler::endFrame()
+{
+	// Late if it was not done before the next frame became due
+	if (Clock::now() > slotTime(m_currentSlot + 1))
+		++m_lateFrames;
+	else
+		++m_onTimeFrames;
+}
+
+double AnimationScheduler::secondsToNextFrame() const
+{
+	return chrono::duration<double>(slotTime(m_currentSlot + 1) - Clock::now()).count();
+}
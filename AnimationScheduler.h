@@ -0,0 +1,59 @@
+#ifndef ANIMATION_SCHEDULER_H
+#define ANIMATION_SCHEDULER_H
+
+#include <chrono>
+
+// Paces animation playback by the wall clock (a steady clock, so it neither
+// drifts nor counts CPU time). Frame n is due n / fps seconds after the start.
+// When a frame takes longer than its budget, the frames whose time has passed
+// are skipped, so the animation keeps its speed instead of slowing down.
+class AnimationScheduler
+{
+public:
+	AnimationScheduler();
+
+	// Play numFrames frames at fps, starting now
+	void start(unsigned numFrames, unsigned fps, bool repeat);
+	void stop();
+
+	bool playing() const { return m_playing; }
+	void setRepeat(bool repeat) { m_repeat = repeat; }
+
+	// Pick the frame due now, skipping (dropping) those already past.
+	// Returns false if no new frame is due, or if playback has just ended.
+	// t is the presentation time of the frame within the animation, in seconds.
+	bool beginFrame(float &t);
+
+	// Index of the frame from the last beginFrame() within the animation
+	unsigned currentFrame() const { return m_currentSlot < 0 ? 0 : (unsigned) (m_currentSlot % m_numFrames); }
+
+	// Call after the frame from beginFrame() has been updated and drawn
+	void endFrame();
+
+	// Seconds from now until the next frame is due (may be negative)
+	double secondsToNextFrame() const;
+
+	// Statistics of the current (or last) playback
+	unsigned onTimeFrames() const { return m_onTimeFrames; }
+	unsigned lateFrames() const { return m_lateFrames; }
+	unsigned droppedFrames() const { return m_droppedFrames; }
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	// Wall time at which the frame in the given slot is due
+	Clock::time_point slotTime(long long slot) const;
+
+	Clock::time_point m_startTime;
+	double m_period;
+	unsigned m_numFrames;
+	bool m_repeat;
+	bool m_playing;
+
+	// Slot of the frame last begun, counting across repetitions (-1 before the first)
+	long long m_currentSlot;
+
+	unsigned m_onTimeFrames, m_lateFrames, m_droppedFrames;
+};
+
+#endif // ANIMATION_SCHEDULER_H
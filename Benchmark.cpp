@@ -0,0 +1,324 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "RandomPoses.h"
+#include "SkeletalModel.h"
+#include "SyntheticRig.h"
+
+using namespace std;
+
+
+// Poses cycled through by the timed runs, so that no run sees the pose of the one before
+static const int NUM_POSES = 64;
+
+static void printUsage(const char *program)
+{
+	cout << "Usage: " << program << " --benchmark [options] [PREFIX1 PREFIX2 ...]" << endl
+		<< "Without models, runs on data/Model1..4 and a few synthetic rigs." << endl
+		<< "Options:" << endl
+		<< "  --synthetic V J     run on a generated rig of about V vertices and J joints" << endl
+		<< "  --depth N           joints per chain of the generated rigs (default: all in one chain)" << endl
+		<< "  --influences N      joints per vertex of the generated rigs (default: 2)" << endl
+		<< "  --subdivide PREFIX LEVELS  run on a model with every triangle split into 4, LEVELS times" << endl
+		<< "  --rig-dir DIR       where the synthetic rigs are written (default: the temporary directory)" << endl
+		<< "  --reps N            timed runs of every phase, at least (default: 10)" << endl
+		<< "  --min-time S        seconds every phase is timed for, at least (default: 0.5)" << endl
+		<< "  --seed N            seed of the random poses (default: 1)" << endl
+		<< "  --out FILE          write the JSON report to FILE instead of the standard output" << endl;
+}
+
+static long fileSize(const string &filename)
+{
+	ifstream file(filename, ios::binary | ios::ate);
+	return file ? (long) file.tellg() : 0;
+}
+
+static string temporaryDirectory()
+{
+#ifdef WIN32
+	const char *dir = getenv("TEMP");
+	return dir ? dir : ".";
+#else
+	const char *dir = getenv("TMPDIR");
+	return dir ? dir : "/tmp";
+#endif
+}
+
+// Timings of one phase on one model
+struct PhaseResult
+{
+	string name;
+	vector<double> secs;	// every timed run, sorted
+	double bytes;			// read and written by one run
+	const char *unit;		// what the phase processes, e.g. "vertices"
+	double count;			// of them in one run
+};
+
+// Time body() until it ran at least minReps times and for minTime seconds.
+// setup() runs untimed before every run, e.g. to change the pose.
+static PhaseResult timePhase(const string &name, double bytes, const char *unit, double count, int minReps,
+	double minTime, const function<void()> &setup, const function<void()> &body)
+{
+	PhaseResult result = { name, vector<double>(), bytes, unit, count };
+
+	// One untimed run warms up the caches and the allocations
+	setup();
+	body();
+
+	double total = 0;
+	while ((int) result.secs.size() < minReps || total < minTime) {
+		setup();
+		auto start = chrono::steady_clock::now();
+		body();
+		double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		result.secs.push_back(secs);
+		total += secs;
+	}
+	sort(result.secs.begin(), result.secs.end());
+	return result;
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile(const vector<double> &sorted, double p)
+{
+	int rank = (int) ceil(p * sorted.size()) - 1;
+	return sorted[min(max(rank, 0), (int) sorted.size() - 1)];
+}
+
+static double median(const vector<double> &sorted)
+{
+	size_t n = sorted.size();
+	return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+static string jsonString(const string &s)
+{
+	string quoted = "\"";
+	for (char c : s) {
+		if (c == '"' || c == '\\')
+			quoted += '\\';
+		quoted += c;
+	}
+	return quoted + "\"";
+}
+
+// Run every phase on one model and append its JSON object to out
+static void benchmarkModel(const string &name, const string &prefix, int minReps, double minTime, unsigned seed,
+	ostream &out)
+{
+	string skelFile = prefix + ".skel", objFile = prefix + ".obj", attachFile = prefix + ".attach";
+	SkeletalModel model;
+	model.load(prefix);
+	const Mesh &mesh = model.getMesh();
+	int numJoints = model.getJoints().size();
+	double numVertices = mesh.bindVertices.size(), numFaces = mesh.faces.size();
+
+	// Random poses within the slider ranges
+	RandomPoses random(seed);
+	int numControls = model.getNumControls();
+	vector<float> poses(NUM_POSES * numControls);
+	for (int p = 0; p < NUM_POSES; ++p)
+		random.next(model, &poses[p * numControls]);
+	int pose = 0;
+	auto nextPose = [&]() {
+		model.setControlValues(&poses[pose * numControls]);
+		pose = (pose + 1) % NUM_POSES;
+	};
+	auto nextPosedSkeleton = [&]() {
+		nextPose();
+		model.updateCurrentJointToWorldTransforms();
+	};
+	auto nothing = []() {};
+	vector<Vector3f> normals;
+
+	vector<PhaseResult> results;
+	double fileBytes = fileSize(skelFile) + fileSize(objFile) + fileSize(attachFile);
+	results.push_back(timePhase("parse", fileBytes, "bytes", fileBytes, minReps, minTime, nothing, [&]() {
+		SkeletalModel parsed;
+		parsed.loadSkeleton(skelFile.c_str());
+		Mesh parsedMesh;
+		parsedMesh.load(objFile.c_str());
+		parsedMesh.loadAttachments(attachFile.c_str(), parsed.getJoints().size());
+		// SkeletalModel leaves its joints alive (models are copied by value)
+		for (Joint *joint : parsed.getJoints())
+			delete joint;
+	}));
+	results.push_back(timePhase("bind_pose", numJoints * sizeof(Matrix4f), "joints", numJoints, minReps, minTime,
+		nothing, [&]() { model.computeBindWorldToJointTransforms(); }));
+	results.push_back(timePhase("forward_kinematics", numJoints * sizeof(Matrix4f), "joints", numJoints, minReps,
+		minTime, nextPose, [&]() { model.updateCurrentJointToWorldTransforms(); }));
+	// updateMesh() generates the normals too
+	results.push_back(timePhase("skinning",
+		numVertices * (2 * sizeof(Vector3f) + numJoints * sizeof(float)) + numFaces * sizeof(Vector3f),
+		"vertices", numVertices, minReps, minTime, nextPosedSkeleton, [&]() { model.updateMesh(); }));
+	results.push_back(timePhase("normals", numFaces * (sizeof(Tuple3u) + sizeof(Vector3f)), "faces", numFaces,
+		minReps, minTime, nothing, [&]() { mesh.computeNormals(mesh.currentVertices, normals); }));
+
+	out << "    {" << endl
+		<< "      \"model\": " << jsonString(name) << "," << endl
+		<< "      \"vertices\": " << (long) numVertices << "," << endl
+		<< "      \"faces\": " << (long) numFaces << "," << endl
+		<< "      \"joints\": " << numJoints << "," << endl
+		<< "      \"phases\": {" << endl;
+	for (size_t i = 0; i < results.size(); ++i) {
+		const PhaseResult &result = results[i];
+		double medianSecs = median(result.secs);
+		out << "        " << jsonString(result.name) << ": {"
+			<< "\"reps\": " << result.secs.size()
+			<< ", \"median_ms\": " << medianSecs * 1e3
+			<< ", \"p95_ms\": " << percentile(result.secs, 0.95) * 1e3
+			<< ", \"min_ms\": " << result.secs.front() * 1e3
+			<< ", \"" << result.unit << "_per_s\": " << result.count / medianSecs
+			<< ", \"mb_per_s\": " << result.bytes / (1 << 20) / medianSecs
+			<< "}" << (i + 1 < results.size() ? "," : "") << endl;
+	}
+	out << "      }" << endl
+		<< "    }";
+}
+
+int runBenchmark(int argc, char* argv[])
+{
+	vector<string> prefixes;
+	vector<SyntheticRig> rigs;
+	int depth = 0, influences = 2;
+
+	// Existing models to subdivide, and the number of levels
+	vector<pair<string, int>> subdivided;
+	string rigDir = temporaryDirectory(), outFile;
+	int minReps = 10;
+	double minTime = 0.5;
+	unsigned seed = 1;
+
+	// argv[1] is "--benchmark" itself
+	for (int i = 2; i < argc; ++i) {
+		string arg = argv[i];
+		int remaining = argc - i - 1;
+		if (arg == "--synthetic" && remaining >= 2) {
+			SyntheticRig rig;
+			rig.numVertices = max(atoi(argv[++i]), 1);
+			rig.numJoints = max(atoi(argv[++i]), 2);
+			rigs.push_back(rig);
+		}
+		else if (arg == "--depth" && remaining >= 1)
+			depth = max(atoi(argv[++i]), 0);
+		else if (arg == "--influences" && remaining >= 1)
+			influences = max(atoi(argv[++i]), 1);
+		else if (arg == "--subdivide" && remaining >= 2) {
+			subdivided.push_back(make_pair(string(argv[i + 1]), max(atoi(argv[i + 2]), 0)));
+			i += 2;
+		}
+		else if (arg == "--rig-dir" && remaining >= 1)
+			rigDir = argv[++i];
+		else if (arg == "--reps" && remaining >= 1)
+			minReps = max(atoi(argv[++i]), 1);
+		else if (arg == "--min-time" && remaining >= 1)
+			minTime = max(atof(argv[++i]), 0.0);
+		else if (arg == "--seed" && remaining >= 1)
+			seed = (unsigned) atol(argv[++i]);
+		else if (arg == "--out" && remaining >= 1)
+			outFile = argv[++i];
+		else if (arg.compare(0, 2, "--") == 0) {
+			cerr << "Error: unknown or incomplete option " << arg << endl;
+			printUsage(argv[0]);
+			return -1;
+		}
+		else
+			prefixes.push_back(arg);
+	}
+
+	for (SyntheticRig &rig : rigs) {
+		rig.depth = depth;
+		rig.influences = influences;
+	}
+
+	// The bundled models, rigs of 1, 4 and 16 times their size, rigs of many
+	// joints in one deep chain and in many short ones, and a denser Model1
+	if (prefixes.empty() && rigs.empty() && subdivided.empty()) {
+		for (int m = 1; m <= 4; ++m)
+			prefixes.push_back("data/Model" + to_string(m));
+		int sizes[][4] = { { 16384, 18, 0, 2 }, { 65536, 18, 0, 2 }, { 262144, 18, 0, 2 }, { 65536, 128, 0, 2 },
+			{ 65536, 128, 8, 4 } };
+		for (auto &size : sizes) {
+			SyntheticRig rig;
+			rig.numVertices = size[0];
+			rig.numJoints = size[1];
+			rig.depth = size[2];
+			rig.influences = size[3];
+			rigs.push_back(rig);
+		}
+		subdivided.push_back(make_pair(string("data/Model1"), 1));
+	}
+
+	for (const string &prefix : prefixes)
+		if (!ifstream(prefix + ".skel")) {
+			cerr << "Error: couldn't read " << prefix << ".skel" << endl;
+			return -1;
+		}
+
+	// The generated models are written for the run, and deleted after it
+	vector<string> names = prefixes, rigPrefixes;
+	for (const SyntheticRig &rig : rigs) {
+		string name = "synthetic_" + to_string(rig.numVertices) + "_" + to_string(rig.numJoints) + "_depth"
+			+ to_string(rig.depth) + "_influences" + to_string(rig.influences);
+		names.push_back(name);
+		rigPrefixes.push_back(rigDir + "/a3_benchmark_" + name);
+		if (!rig.write(rigPrefixes.back())) {
+			cerr << "Error: couldn't write the synthetic rig " << rigPrefixes.back() << endl;
+			return -1;
+		}
+	}
+	for (const pair<string, int> &source : subdivided) {
+		string base = source.first.substr(source.first.find_last_of("/\\") + 1);
+		string name = base + "_subdivided" + to_string(source.second);
+		names.push_back(name);
+		rigPrefixes.push_back(rigDir + "/a3_benchmark_" + name);
+		if (!SyntheticRig::writeSubdivided(source.first, source.second, 0, rigPrefixes.back())) {
+			cerr << "Error: couldn't subdivide " << source.first << " into " << rigPrefixes.back() << endl;
+			return -1;
+		}
+	}
+	prefixes.insert(prefixes.end(), rigPrefixes.begin(), rigPrefixes.end());
+
+	ostringstream report;
+	report << setprecision(6);
+
+	report << "{" << endl
+		<< "  \"benchmark\": \"skinning\"," << endl
+		<< "  \"seed\": " << seed << "," << endl
+		<< "  \"models\": [" << endl;
+	for (size_t m = 0; m < prefixes.size(); ++m) {
+		cerr << "Benchmarking " << names[m] << endl;
+		benchmarkModel(names[m], prefixes[m], minReps, minTime, seed, report);
+		report << (m + 1 < prefixes.size() ? "," : "") << endl;
+	}
+	report << "  ]" << endl
+		<< "}" << endl;
+
+	for (const string &prefix : rigPrefixes)
+		for (const char *extension : { ".skel", ".obj", ".attach" })
+			remove((prefix + extension).c_str());
+
+	if (outFile.empty())
+		cout << report.str();
+	else {
+		ofstream file(outFile);
+		if (!(file << report.str())) {
+			cerr << "Error: couldn't write " << outFile << endl;
+			return -1;
+		}
+	}
+	return 0;
+}
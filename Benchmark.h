@@ -0,0 +1,9 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+// Entry point of "a3 --benchmark ...": time parsing, bind pose setup, forward
+// kinematics, skinning and normal generation on the bundled and synthetic
+// models, without creating any window, and print the statistics as JSON.
+int runBenchmark(int argc, char* argv[]);
+
+#endif // BENCHMARK_H
@@ -0,0 +1,203 @@
+#include "BlendTree.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace std;
+
+// Sample a clip into a pose of numControls controls; tracks beyond the clip
+// stay in the bind pose. Does not allocate once the pose has grown to the
+// clip size.
+static void sampleClip(const AnimationClip &clip, float t, int numControls, BlendTree::Pose &pose)
+{
+	clip.sample(t, pose.values, pose.rotations);
+	pose.values.resize(numControls, 0.f);
+	pose.rotations.resize(numControls / 3, Quat4f::IDENTITY);
+}
+
+BlendTree::BlendTree(int numControls)
+	: m_numControls(numControls / 3 * 3)
+{
+}
+
+int BlendTree::addNode(const Node &node)
+{
+	// Inputs come before the node, so that evaluation never recurses into a cycle
+#ifndef NDEBUG
+	for (int input : node.inputs)
+		assert(input >= 0 && input < (int) m_nodes.size());
+#endif
+	m_nodes.push_back(node);
+	return m_nodes.size() - 1;
+}
+
+int BlendTree::addClip(const AnimationClip *clip, float speed, bool loop)
+{
+	Node node = { NODE_CLIP, clip, speed, loop, vector<int>(), -1, -1 };
+	return addNode(node);
+}
+
+int BlendTree::addBlend(const vector<int> &inputs, int mask)
+{
+	Node node = { NODE_BLEND, NULL, 1, false, inputs, mask, -1 };
+	return addNode(node);
+}
+
+int BlendTree::addAdditive(int base, int layerClip, int mask)
+{
+	assert(m_nodes[layerClip].type == NODE_CLIP);
+
+	// The layer is applied relative to its first frame
+	Pose reference;
+	sampleClip(*m_nodes[layerClip].clip, 0, m_numControls, reference);
+	m_references.push_back(reference);
+
+	Node node = { NODE_ADDITIVE, NULL, 1, false, { base, layerClip }, mask, (int) m_references.size() - 1 };
+	return addNode(node);
+}
+
+int BlendTree::addMask(const vector<float> &trackWeights)
+{
+	m_masks.push_back(trackWeights);
+	m_masks.back().resize(m_numControls / 3, 0.f);
+	return m_masks.size() - 1;
+}
+
+int BlendTree::addJointMask(const vector<Joint*> &joints, int joint, float weight)
+{
+	// Track 0 is the root translation, track j + 1 the rotation of joint j
+	vector<float> trackWeights(m_numControls / 3, 0.f);
+	vector<const Joint*> stack(1, joints[joint]);
+	while (!stack.empty()) {
+		const Joint *current = stack.back();
+		stack.pop_back();
+		int track = find(joints.begin(), joints.end(), current) - joints.begin() + 1;
+		if (track < (int) trackWeights.size())
+			trackWeights[track] = weight;
+		stack.insert(stack.end(), current->children.begin(), current->children.end());
+	}
+	return addMask(trackWeights);
+}
+
+float BlendTree::duration() const
+{
+	// Until the slowest clip has played once
+	float longest = 0;
+	for (const Node &node : m_nodes)
+		if (node.type == NODE_CLIP && node.speed > 0)
+			longest = max(longest, node.clip->duration() / node.speed);
+	return longest;
+}
+
+void BlendTree::initInstance(Instance &instance) const
+{
+	int numNodes = m_nodes.size();
+	instance.weights.assign(numNodes, 1.f);
+	instance.m_root = numNodes - 1;
+	instance.m_poses.resize(numNodes);
+	for (int n = 0; n < numNodes; ++n) {
+		// Clips sample all their controls before dropping those beyond the tree
+		int numControls = m_nodes[n].type == NODE_CLIP ? max(m_nodes[n].clip->numControls(), m_numControls) : m_numControls;
+		Pose &pose = instance.m_poses[n];
+		pose.values.reserve(numControls);
+		pose.rotations.reserve(numControls / 3);
+		pose.values.assign(m_numControls, 0.f);
+		pose.rotations.assign(m_numControls / 3, Quat4f::IDENTITY);
+	}
+}
+
+void BlendTree::evaluate(float t, Instance &instance) const
+{
+	if (!m_nodes.empty())
+		evaluateNode(instance.m_root, t, instance);
+}
+
+void BlendTree::evaluateNode(int index, float t, Instance &instance) const
+{
+	const Node &node = m_nodes[index];
+	Pose &pose = instance.m_poses[index];
+	const float *mask = node.mask >= 0 ? m_masks[node.mask].data() : NULL;
+	int numTracks = m_numControls / 3;
+
+	switch (node.type) {
+	case NODE_CLIP: {
+		float local = t * node.speed, duration = node.clip->duration();
+		if (node.loop && duration > 0 && (local < 0 || local > duration))
+			local -= floor(local / duration) * duration;
+		sampleClip(*node.clip, local, m_numControls, pose);
+		break;
+	}
+
+	case NODE_BLEND: {
+		// Inputs without weight are not evaluated at all
+		int numInputs = node.inputs.size();
+		for (int i = 0; i < numInputs; ++i)
+			if (instance.weights[node.inputs[i]] > 0 || i == 0)
+				evaluateNode(node.inputs[i], t, instance);
+
+		for (int track = 0; track < numTracks; ++track) {
+			float total = 0;
+			int numWeighted = 0, last = 0;
+			Vector3f translation;
+			Quat4f rotation = Quat4f::ZERO;
+			const Quat4f &first = instance.m_poses[node.inputs[0]].rotations[track];
+			for (int i = 0; i < numInputs; ++i) {
+				float w = max(instance.weights[node.inputs[i]], 0.f);
+				if (mask && i > 0)
+					w *= mask[track];
+				if (w <= 0)
+					continue;
+				const Pose &input = instance.m_poses[node.inputs[i]];
+				total += w;
+				++numWeighted;
+				last = i;
+				if (track == 0)
+					translation += w * Vector3f(input.values[0], input.values[1], input.values[2]);
+				else {
+					// Average on the same hemisphere, so that q and -q do not cancel out
+					const Quat4f &q = input.rotations[track];
+					rotation = rotation + (Quat4f::dot(q, first) < 0 ? -w : w) * q;
+				}
+			}
+
+			// A single input is copied as is; without any weight, the first input is kept
+			const Pose &fallback = instance.m_poses[node.inputs[numWeighted == 1 ? last : 0]];
+			if (numWeighted == 1)
+				total = 0;
+			if (track == 0)
+				for (int k = 0; k < 3; ++k)
+					pose.values[k] = total > 0 ? translation[k] / total : fallback.values[k];
+			else
+				pose.rotations[track] = total > 0 && rotation.absSquared() > 0 ? rotation.normalized() : fallback.rotations[track];
+		}
+		break;
+	}
+
+	case NODE_ADDITIVE: {
+		int base = node.inputs[0], layer = node.inputs[1];
+		float weight = instance.weights[layer];
+		evaluateNode(base, t, instance);
+		if (weight != 0)
+			evaluateNode(layer, t, instance);
+
+		const Pose &basePose = instance.m_poses[base], &layerPose = instance.m_poses[layer];
+		const Pose &reference = m_references[node.reference];
+		for (int track = 0; track < numTracks; ++track) {
+			float w = mask ? weight * mask[track] : weight;
+			if (track == 0)
+				for (int k = 0; k < 3; ++k)
+					pose.values[k] = basePose.values[k] + w * (layerPose.values[k] - reference.values[k]);
+			else if (w == 0)
+				pose.rotations[track] = basePose.rotations[track];
+			else {
+				// The change of the layer in the joint frame, scaled by the weight
+				Quat4f delta = reference.rotations[track].conjugated() * layerPose.rotations[track];
+				Quat4f scaled = Quat4f::slerp(Quat4f::IDENTITY, delta, w).normalized();
+				pose.rotations[track] = (basePose.rotations[track] * scaled).normalized();
+			}
+		}
+		break;
+	}
+	}
+}
@@ -0,0 +1,103 @@
+#ifndef BLEND_TREE_H
+#define BLEND_TREE_H
+
+#include <vector>
+#include <vecmath.h>
+
+#include "Animation.h"
+#include "Joint.h"
+
+// Combines several animation clips into the pose of one model: clips are
+// cross-faded by weighted blends and layered by additive nodes, and per-joint
+// masks restrict a blend or a layer to part of the skeleton.
+//
+// The tree describes the controls of one model (track 0 is the root
+// translation, then a rotation per joint, like SkeletalModel) and is shared by
+// all the models it animates. Everything that changes per model (the weights
+// and the poses computed on the way) is in an Instance, so instances can be
+// evaluated in parallel, and evaluating one does not allocate memory.
+class BlendTree
+{
+public:
+	// Controls of one model; only the rotations are used for rotation tracks
+	struct Pose
+	{
+		std::vector< float > values;
+		std::vector< Quat4f > rotations;	// per track
+	};
+
+	// Evaluation state of one model
+	class Instance
+	{
+	public:
+		// Weight of every node as an input of its parent (default 1). For a
+		// blend, the inputs are averaged by weight; for an additive layer, it
+		// scales the layer.
+		std::vector< float > weights;
+
+		// Result of the last evaluate()
+		const Pose &pose() const { return m_poses[ m_root ]; }
+
+	private:
+		friend class BlendTree;
+		int m_root;
+		std::vector< Pose > m_poses;	// per node
+	};
+
+	explicit BlendTree( int numControls );
+
+	// Nodes are added after their inputs; the last node added is the root.
+	// Every function returns the index of the new node.
+
+	// A clip (not owned) played at speed times the tree time, looping or holding its last pose
+	int addClip( const AnimationClip *clip, float speed = 1, bool loop = true );
+	// Weighted average of the inputs. With a mask, the inputs after the first
+	// only count on the tracks of the mask, as much as its weight there.
+	int addBlend( const std::vector< int > &inputs, int mask = -1 );
+	// base plus how much the clip of layerClip moved away from its first frame
+	int addAdditive( int base, int layerClip, int mask = -1 );
+
+	// A weight per track, for blends and additive layers
+	int addMask( const std::vector< float > &trackWeights );
+	// Mask of the tracks of a joint and all its descendants
+	int addJointMask( const std::vector< Joint* > &joints, int joint, float weight = 1 );
+
+	int numNodes() const { return m_nodes.size(); }
+	int numControls() const { return m_numControls; }
+	float duration() const;
+
+	// Allocate the state of a model, with all weights 1
+	void initInstance( Instance &instance ) const;
+
+	// Pose of the model at time t (seconds) into instance.pose()
+	void evaluate( float t, Instance &instance ) const;
+
+private:
+	enum NodeType
+	{
+		NODE_CLIP,
+		NODE_BLEND,
+		NODE_ADDITIVE
+	};
+
+	struct Node
+	{
+		NodeType type;
+		const AnimationClip *clip;
+		float speed;
+		bool loop;
+		std::vector< int > inputs;	// blend: all inputs; additive: base and layer
+		int mask;
+		int reference;				// additive: first frame of the layer, in m_references
+	};
+
+	int addNode( const Node &node );
+	void evaluateNode( int node, float t, Instance &instance ) const;
+
+	int m_numControls;
+	std::vector< Node > m_nodes;
+	std::vector< std::vector< float > > m_masks;
+	std::vector< Pose > m_references;
+};
+
+#endif // BLEND_TREE_H
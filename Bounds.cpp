@@ -0,0 +1,76 @@
+#include "Bounds.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace std;
+
+BoundingBox::BoundingBox()
+	: min(FLT_MAX), max(-FLT_MAX)
+{
+}
+
+void BoundingBox::extend(const Vector3f& point)
+{
+	for (int k = 0; k < 3; ++k) {
+		min[k] = std::min(min[k], point[k]);
+		max[k] = std::max(max[k], point[k]);
+	}
+}
+
+void BoundingBox::extend(const BoundingBox& box)
+{
+	if (box.empty())
+		return;
+	extend(box.min);
+	extend(box.max);
+}
+
+BoundingBox BoundingBox::transformed(const Matrix4f& m) const
+{
+	BoundingBox result;
+	if (empty())
+		return result;
+
+	// Transform the center, and grow the half extents by the absolute linear part
+	Vector3f center = 0.5f * (min + max), extents = 0.5f * (max - min), newCenter, newExtents;
+	for (int i = 0; i < 3; ++i) {
+		newCenter[i] = m(i, 3);
+		newExtents[i] = 0;
+		for (int k = 0; k < 3; ++k) {
+			newCenter[i] += m(i, k) * center[k];
+			newExtents[i] += fabs(m(i, k)) * extents[k];
+		}
+	}
+	result.min = newCenter - newExtents;
+	result.max = newCenter + newExtents;
+	return result;
+}
+
+Frustum::Frustum(const Matrix4f& viewProjection)
+{
+	// Gribb & Hartmann: -w <= x, y, z <= w as planes in world space
+	Vector4f rowW = viewProjection.getRow(3);
+	for (int i = 0; i < 3; ++i) {
+		Vector4f row = viewProjection.getRow(i);
+		m_planes[2 * i] = rowW + row;
+		m_planes[2 * i + 1] = rowW - row;
+	}
+}
+
+bool Frustum::intersects(const BoundingBox& box) const
+{
+	if (box.empty())
+		return false;
+
+	for (const Vector4f &plane : m_planes) {
+		// The corner furthest along the plane normal
+		Vector3f corner(plane[0] >= 0 ? box.max[0] : box.min[0],
+			plane[1] >= 0 ? box.max[1] : box.min[1],
+			plane[2] >= 0 ? box.max[2] : box.min[2]);
+		if (Vector3f::dot(plane.xyz(), corner) + plane[3] < 0)
+			return false;
+	}
+	return true;
+}
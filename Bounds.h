@@ -0,0 +1,35 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <vecmath.h>
+
+// Axis-aligned bounding box; empty until a point is added
+struct BoundingBox
+{
+	Vector3f min, max;
+
+	BoundingBox();
+
+	bool empty() const { return min[ 0 ] > max[ 0 ]; }
+
+	void extend( const Vector3f& point );
+	void extend( const BoundingBox& box );
+
+	// Box around the transformed box (conservative, but cheaper than its 8 corners)
+	BoundingBox transformed( const Matrix4f& m ) const;
+};
+
+// The six clip planes of a view-projection matrix, pointing inwards
+class Frustum
+{
+public:
+	explicit Frustum( const Matrix4f& viewProjection );
+
+	// False only if the box is certainly outside
+	bool intersects( const BoundingBox& box ) const;
+
+private:
+	Vector4f m_planes[ 6 ];
+};
+
+#endif // BOUNDS_H
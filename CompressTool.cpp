@@ -0,0 +1,156 @@
+#include "CompressTool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "Animation.h"
+#include "CompressedClip.h"
+
+using namespace std;
+
+static const float DEGREES_PER_RADIAN = 57.2957795f;
+
+static void printUsage(const char *program)
+{
+	cout << "Usage: " << program << " --compress-clip [options] IN.anim OUT.clip [PREFIX1 PREFIX2 ...]" << endl
+		<< "The model prefixes tell which controls are root translations (default: the first 3 only)." << endl
+		<< "Options:" << endl
+		<< "  --fps N                      sampling rate of the keys (default: 30)" << endl
+		<< "  --tolerance DEG              largest joint rotation error (default: 0.5)" << endl
+		<< "  --translation-tolerance D    largest root translation error (default: 0.001)" << endl;
+}
+
+static long fileSize(const string &filename)
+{
+	ifstream file(filename, ios::binary | ios::ate);
+	return file ? (long) file.tellg() : 0;
+}
+
+// Size of an .anim file and of every .pos file it refers to
+static long animTextSize(const string &animFilename)
+{
+	string fileDir;
+	if (animFilename.find('/') != string::npos)
+		fileDir = animFilename.substr(0, animFilename.rfind('/') + 1);
+
+	ifstream file(animFilename);
+	set<string> posFiles;
+	string filename;
+	float secs;
+	if (file >> filename)
+		posFiles.insert(filename);
+	while (file >> secs >> filename)
+		posFiles.insert(filename);
+
+	long size = fileSize(animFilename);
+	for (const string &posFile : posFiles)
+		size += fileSize(fileDir + posFile);
+	return size;
+}
+
+int runCompressClip(int argc, char* argv[])
+{
+	float fps = 30, tolerance = 0.5f, translationTolerance = 0.001f;
+	vector<string> positional;
+
+	// argv[1] is "--compress-clip" itself
+	for (int i = 2; i < argc; ++i) {
+		string arg = argv[i];
+		int remaining = argc - i - 1;
+		if (arg == "--fps" && remaining >= 1)
+			fps = max((float) atof(argv[++i]), 1.f);
+		else if (arg == "--tolerance" && remaining >= 1)
+			tolerance = max((float) atof(argv[++i]), 0.f);
+		else if (arg == "--translation-tolerance" && remaining >= 1)
+			translationTolerance = max((float) atof(argv[++i]), 0.f);
+		else if (arg.compare(0, 2, "--") == 0) {
+			cerr << "Error: unknown or incomplete option " << arg << endl;
+			printUsage(argv[0]);
+			return -1;
+		}
+		else
+			positional.push_back(arg);
+	}
+	if (positional.size() < 2) {
+		printUsage(argv[0]);
+		return -1;
+	}
+	string inFile = positional[0], outFile = positional[1];
+
+	// Lay out the controls like the modeler: per model, the root translation then
+	// a rotation per joint (one joint per line of the .skel file)
+	vector<bool> controlIsTranslation;
+	for (size_t m = 2; m < positional.size(); ++m) {
+		ifstream skel(positional[m] + ".skel");
+		if (!skel) {
+			cerr << "Error: couldn't read skeleton file " << positional[m] << ".skel" << endl;
+			return -1;
+		}
+		int numJoints = 0;
+		string line;
+		while (getline(skel, line))
+			if (line.find_first_not_of(" \t\r") != string::npos)
+				++numJoints;
+		controlIsTranslation.insert(controlIsTranslation.end(), 3, true);
+		controlIsTranslation.insert(controlIsTranslation.end(), 3 * numJoints, false);
+	}
+	if (controlIsTranslation.empty())
+		controlIsTranslation.assign(3, true);
+
+	KeyframeClip source;
+	if (!source.load(inFile.c_str(), controlIsTranslation)) {
+		cerr << "Error: couldn't read animation file " << inFile << endl;
+		return -1;
+	}
+
+	CompressedClip clip;
+	CompressedClip::Error error;
+	float angularTolerance = tolerance / DEGREES_PER_RADIAN;
+	if (!clip.compress(source, fps, angularTolerance, translationTolerance, &error)) {
+		cerr << "Error: " << inFile << " is too long to compress at " << fps << " fps" << endl;
+		return -1;
+	}
+	if (!clip.save(outFile)) {
+		cerr << "Error: couldn't write clip file " << outFile << endl;
+		return -1;
+	}
+
+	// Measure the error between the samples too, against the source
+	vector<float> sourceValues, values;
+	vector<Quat4f> sourceRotations, rotations;
+	float maxAngle = 0, maxTranslation = 0;
+	unsigned numChecks = 4 * clip.numFrames(fps);
+	for (unsigned i = 0; i < numChecks; ++i) {
+		float t = numChecks > 1 ? source.duration() * i / (numChecks - 1) : 0.f;
+		source.sample(t, sourceValues, sourceRotations);
+		clip.sample(t, values, rotations);
+		for (int track = 0, numTracks = source.numControls() / 3; track < numTracks; ++track) {
+			if (source.trackIsRotation(track)) {
+				float dot = fabs(Quat4f::dot(sourceRotations[track], rotations[track]));
+				maxAngle = max(maxAngle, 2 * acos(min(dot, 1.f)));
+			}
+			else {
+				Vector3f d(values[3 * track] - sourceValues[3 * track], values[3 * track + 1] - sourceValues[3 * track + 1],
+					values[3 * track + 2] - sourceValues[3 * track + 2]);
+				maxTranslation = max(maxTranslation, d.abs());
+			}
+		}
+	}
+
+	// Against the text files, and against the same samples stored as floats
+	long textSize = animTextSize(inFile), clipSize = clip.sizeInBytes();
+	long floatSize = (long) clip.numSamples() * source.numControls() * sizeof(float);
+	cout << "Wrote " << outFile << ": " << clip.numKeys() << " keys of " << clip.numSamples() << " samples x "
+		<< source.numControls() / 3 << " tracks" << endl
+		<< "  size: " << clipSize << " bytes; text files " << textSize << " bytes (" << (float) textSize / clipSize
+		<< ":1); float frames " << floatSize << " bytes (" << (float) floatSize / clipSize << ":1)" << endl
+		<< "  max error at the samples: " << error.maxAngle * DEGREES_PER_RADIAN << " deg, " << error.maxTranslation << endl
+		<< "  max error at 4x the rate: " << maxAngle * DEGREES_PER_RADIAN << " deg, " << maxTranslation << endl;
+	return 0;
+}
@@ -0,0 +1,8 @@
+#ifndef COMPRESS_TOOL_H
+#define COMPRESS_TOOL_H
+
+// Entry point of "a3 --compress-clip ...": convert an .anim file (and its .pos
+// files) into a compressed .clip file, and report its size and error.
+int runCompressClip(int argc, char* argv[]);
+
+#endif // COMPRESS_TOOL_H
@@ -0,0 +1,333 @@
+#include "CompressedClip.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+static const char CLIP_MAGIC[4] = { 'S', 'S', 'D', 'C' };
+static const uint32_t CLIP_VERSION = 1;
+static const uint32_t MAX_SAMPLES = 65536;
+
+// Header: magic, version, numControls, fps, duration, numSamples, numTracks, numKeys
+static const size_t HEADER_SIZE = 4 + 7 * 4;
+// Per track: isRotation, numKeys, offset[3], scale[3]
+static const size_t TRACK_SIZE = 8 * 4;
+// Per key: sample index and 3 x 16 bits
+static const size_t KEY_SIZE = 4 * 2;
+
+static const float SQRT_HALF = 0.70710678f;
+
+CompressedClip::CompressedClip()
+	: m_fps(30), m_duration(0), m_numSamples(0)
+{
+}
+
+void CompressedClip::packRotation(const Quat4f &rotation, uint16_t packed[3])
+{
+	Quat4f q = rotation.normalized();
+
+	// Drop the largest component, made positive (q and -q are the same rotation)
+	int largest = 0;
+	for (int i = 1; i < 4; ++i)
+		if (fabs(q[i]) > fabs(q[largest]))
+			largest = i;
+	float sign = q[largest] < 0 ? -1.f : 1.f;
+
+	// The others are within +-1/sqrt(2)
+	uint64_t bits = (uint64_t) largest;
+	for (int i = 0; i < 4; ++i) {
+		if (i == largest)
+			continue;
+		float x = min(max(sign * q[i] / SQRT_HALF, -1.f), 1.f);	// x / (1/sqrt(2)), in [-1, 1]
+		bits = (bits << 15) | (uint64_t) lround((x + 1) * 0.5f * 32767);
+	}
+
+	packed[0] = (uint16_t) (bits >> 32);
+	packed[1] = (uint16_t) (bits >> 16);
+	packed[2] = (uint16_t) bits;
+}
+
+Quat4f CompressedClip::unpackRotation(const uint16_t packed[3])
+{
+	uint64_t bits = ((uint64_t) packed[0] << 32) | ((uint64_t) packed[1] << 16) | packed[2];
+	int largest = (int) (bits >> 45) & 3;
+
+	Quat4f q;
+	float sumSquares = 0;
+	for (int i = 3, shift = 0; i >= 0; --i) {
+		if (i == largest)
+			continue;
+		float x = ((bits >> shift) & 0x7fff) / 32767.f * 2 - 1;
+		q[i] = x * SQRT_HALF;
+		sumSquares += q[i] * q[i];
+		shift += 15;
+	}
+	q[largest] = sqrt(max(1 - sumSquares, 0.f));
+	return q;
+}
+
+// Angle between two rotations
+static float rotationDistance(const Quat4f &a, const Quat4f &b)
+{
+	return 2 * acos(min(fabs(Quat4f::dot(a, b)), 1.f));
+}
+
+float CompressedClip::samplePosition(float t) const
+{
+	if (m_numSamples <= 1)
+		return 0;
+
+	// Every sample is 1 / fps after the previous one, except the last, which is at the end
+	t = min(max(t, 0.f), m_duration);
+	float last = m_numSamples - 2, lastTime = last / m_fps;
+	if (t <= lastTime)
+		return t * m_fps;
+	return last + (m_duration > lastTime ? (t - lastTime) / (m_duration - lastTime) : 1.f);
+}
+
+bool CompressedClip::compress(const AnimationClip &source, float fps, float angularTolerance, float translationTolerance,
+	Error *error)
+{
+	m_fps = fps;
+	m_duration = source.duration();
+	m_numSamples = source.empty() ? 0 : (uint32_t) ceil(m_duration * fps - 1e-3f) + 1;
+	m_numControls = source.numControls();
+	m_tracks.clear();
+	m_keyFrames.clear();
+	m_keyData.clear();
+	m_trackIsRotation.clear();
+	if (m_numSamples > MAX_SAMPLES) {
+		m_numSamples = 0;
+		return false;
+	}
+
+	// Sample the source
+	int numTracks = m_numControls / 3, n = m_numSamples;
+	vector<float> values, sampleValues(n * m_numControls);
+	vector<Quat4f> rotations, sampleRotations(n * numTracks);
+	for (int i = 0; i < n; ++i) {
+		float t = i + 1 < n ? i / fps : m_duration;
+		source.sample(t, values, rotations);
+		copy(values.begin(), values.end(), sampleValues.begin() + i * m_numControls);
+		copy(rotations.begin(), rotations.end(), sampleRotations.begin() + i * numTracks);
+	}
+
+	Error maxError = { 0, 0 };
+	vector<uint16_t> quantized(3 * n);
+	vector<Quat4f> decodedRotations(n), originalRotations(n);
+	vector<Vector3f> decodedTranslations(n), originalTranslations(n);
+	vector<bool> keep(n);
+	vector<pair<int, int>> segments;
+
+	for (int track = 0; track < numTracks; ++track) {
+		bool isRotation = source.trackIsRotation(track);
+		m_trackIsRotation.push_back(isRotation);
+
+		Track record;
+		record.firstKey = m_keyFrames.size();
+		fill(record.offset, record.offset + 3, 0.f);
+		fill(record.scale, record.scale + 3, 0.f);
+		record.numKeys = 0;
+		if (n == 0) {
+			m_tracks.push_back(record);
+			continue;
+		}
+
+		// Quantize every sample, keeping what it decodes to
+		if (isRotation) {
+			for (int i = 0; i < n; ++i) {
+				originalRotations[i] = sampleRotations[i * numTracks + track];
+				packRotation(originalRotations[i], &quantized[3 * i]);
+				decodedRotations[i] = unpackRotation(&quantized[3 * i]);
+			}
+		}
+		else {
+			for (int i = 0; i < n; ++i) {
+				const float *v = &sampleValues[i * m_numControls + 3 * track];
+				originalTranslations[i] = Vector3f(v[0], v[1], v[2]);
+			}
+			for (int k = 0; k < 3; ++k) {
+				float lo = originalTranslations[0][k], hi = lo;
+				for (int i = 1; i < n; ++i) {
+					lo = min(lo, originalTranslations[i][k]);
+					hi = max(hi, originalTranslations[i][k]);
+				}
+				record.offset[k] = lo;
+				record.scale[k] = (hi - lo) / 65535;
+			}
+			for (int i = 0; i < n; ++i)
+				for (int k = 0; k < 3; ++k) {
+					float x = originalTranslations[i][k];
+					quantized[3 * i + k] = record.scale[k] > 0 ? (uint16_t) lround((x - record.offset[k]) / record.scale[k]) : 0;
+					decodedTranslations[i][k] = record.offset[k] + record.scale[k] * quantized[3 * i + k];
+				}
+		}
+
+		// Error at sample i when it is interpolated between the kept samples a and b
+		auto sampleError = [&](int i, int a, int b) {
+			float s = b > a ? (float) (i - a) / (b - a) : 0.f;
+			if (isRotation)
+				return rotationDistance(Quat4f::slerp(decodedRotations[a], decodedRotations[b], s).normalized(), originalRotations[i]);
+			return (decodedTranslations[a] + s * (decodedTranslations[b] - decodedTranslations[a]) - originalTranslations[i]).abs();
+		};
+		float tolerance = isRotation ? angularTolerance : translationTolerance;
+
+		// Keep the ends, then split every segment at its worst sample until all are within tolerance
+		fill(keep.begin(), keep.end(), false);
+		keep[0] = keep[n - 1] = true;
+		segments.assign(1, make_pair(0, n - 1));
+		while (!segments.empty()) {
+			int a = segments.back().first, b = segments.back().second;
+			segments.pop_back();
+			int worst = -1;
+			float worstError = tolerance;
+			for (int i = a + 1; i < b; ++i) {
+				float e = sampleError(i, a, b);
+				if (e > worstError) {
+					worst = i;
+					worstError = e;
+				}
+			}
+			if (worst >= 0) {
+				keep[worst] = true;
+				segments.push_back(make_pair(a, worst));
+				segments.push_back(make_pair(worst, b));
+			}
+		}
+
+		// Store the kept keys and measure the final error
+		float &trackMaxError = isRotation ? maxError.maxAngle : maxError.maxTranslation;
+		for (int a = 0, b; a < n; a = b) {
+			m_keyFrames.push_back((uint16_t) a);
+			m_keyData.insert(m_keyData.end(), &quantized[3 * a], &quantized[3 * a] + 3);
+			trackMaxError = max(trackMaxError, sampleError(a, a, a));
+			for (b = a + 1; b < n && !keep[b]; ++b);
+			for (int i = a + 1; i < b && b < n; ++i)
+				trackMaxError = max(trackMaxError, sampleError(i, a, b));
+		}
+		record.numKeys = m_keyFrames.size() - record.firstKey;
+		m_tracks.push_back(record);
+	}
+
+	if (error)
+		*error = maxError;
+	return true;
+}
+
+bool CompressedClip::save(const string &filename) const
+{
+	FILE *file = fopen(filename.c_str(), "wb");
+	if (!file)
+		return false;
+
+	uint32_t header[] = { CLIP_VERSION, (uint32_t) m_numControls, 0, 0, m_numSamples,
+		(uint32_t) m_tracks.size(), (uint32_t) m_keyFrames.size() };
+	memcpy(&header[2], &m_fps, 4);
+	memcpy(&header[3], &m_duration, 4);
+	fwrite(CLIP_MAGIC, 1, 4, file);
+	fwrite(header, 4, 7, file);
+
+	for (int track = 0, numTracks = m_tracks.size(); track < numTracks; ++track) {
+		uint32_t counts[] = { (uint32_t) m_trackIsRotation[track], m_tracks[track].numKeys };
+		fwrite(counts, 4, 2, file);
+		fwrite(m_tracks[track].offset, 4, 3, file);
+		fwrite(m_tracks[track].scale, 4, 3, file);
+	}
+
+	fwrite(m_keyFrames.data(), 2, m_keyFrames.size(), file);
+	fwrite(m_keyData.data(), 2, m_keyData.size(), file);
+
+	bool ok = !ferror(file);
+	return fclose(file) == 0 && ok;
+}
+
+bool CompressedClip::load(const string &filename)
+{
+	FILE *file = fopen(filename.c_str(), "rb");
+	if (!file)
+		return false;
+
+	char magic[4];
+	uint32_t header[7];
+	bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, CLIP_MAGIC, 4) == 0
+		&& fread(header, 4, 7, file) == 7 && header[0] == CLIP_VERSION
+		&& header[4] <= MAX_SAMPLES && header[1] == 3 * header[5];
+
+	if (ok) {
+		m_numControls = header[1];
+		memcpy(&m_fps, &header[2], 4);
+		memcpy(&m_duration, &header[3], 4);
+		m_numSamples = header[4];
+		m_tracks.resize(header[5]);
+		m_trackIsRotation.resize(header[5]);
+
+		uint32_t firstKey = 0;
+		for (auto &track : m_tracks) {
+			uint32_t counts[2];
+			ok = ok && fread(counts, 4, 2, file) == 2
+				&& fread(track.offset, 4, 3, file) == 3 && fread(track.scale, 4, 3, file) == 3;
+			m_trackIsRotation[&track - &m_tracks[0]] = counts[0] != 0;
+			track.firstKey = firstKey;
+			track.numKeys = counts[1];
+			firstKey += counts[1];
+		}
+		ok = ok && firstKey == header[6];
+
+		m_keyFrames.resize(header[6]);
+		m_keyData.resize(3 * header[6]);
+		ok = ok && fread(m_keyFrames.data(), 2, m_keyFrames.size(), file) == m_keyFrames.size()
+			&& fread(m_keyData.data(), 2, m_keyData.size(), file) == m_keyData.size();
+	}
+	fclose(file);
+
+	if (!ok) {
+		m_numControls = 0;
+		m_numSamples = 0;
+		m_duration = 0;
+		m_tracks.clear();
+		m_trackIsRotation.clear();
+		m_keyFrames.clear();
+		m_keyData.clear();
+	}
+	return ok;
+}
+
+size_t CompressedClip::sizeInBytes() const
+{
+	return HEADER_SIZE + m_tracks.size() * TRACK_SIZE + m_keyFrames.size() * KEY_SIZE;
+}
+
+void CompressedClip::sample(float t, vector<float> &values, vector<Quat4f> &rotations) const
+{
+	values.resize(m_numControls);
+	rotations.resize(m_numControls / 3);
+	if (empty())
+		return;
+
+	float u = samplePosition(t);
+	uint16_t frame = (uint16_t) u;
+
+	for (int track = 0, numTracks = m_tracks.size(); track < numTracks; ++track) {
+		const Track &record = m_tracks[track];
+		if (record.numKeys == 0)
+			continue;
+		const uint16_t *frames = &m_keyFrames[record.firstKey], *data = &m_keyData[3 * record.firstKey];
+
+		// Keys around the sample position
+		int a = upper_bound(frames, frames + record.numKeys, frame) - frames - 1;
+		a = min(max(a, 0), (int) record.numKeys - 1);
+		int b = min(a + 1, (int) record.numKeys - 1);
+		float s = b > a ? min(max((u - frames[a]) / (frames[b] - frames[a]), 0.f), 1.f) : 0.f;
+
+		if (m_trackIsRotation[track])
+			rotations[track] = Quat4f::slerp(unpackRotation(&data[3 * a]), unpackRotation(&data[3 * b]), s).normalized();
+		else
+			for (int k = 0; k < 3; ++k) {
+				float from = data[3 * a + k], to = data[3 * b + k];
+				values[3 * track + k] = record.offset[k] + record.scale[k] * (from + s * (to - from));
+			}
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef COMPRESSED_CLIP_H
+#define COMPRESSED_CLIP_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Animation.h"
+
+// An animation in a compact binary format (.clip), made from any other clip.
+//
+// The source is sampled at a fixed rate, and every track only keeps the
+// samples that cannot be rebuilt within a tolerance by interpolating the kept
+// ones. Every key is 48 bits: a rotation is stored as its "smallest three"
+// quaternion components (2 bits for the index of the dropped largest one,
+// 15 bits for each of the others), a translation as 16 bits per axis within
+// the range of its track. The keys of a track are stored together, so
+// sampling a track only touches a couple of cache lines.
+class CompressedClip : public AnimationClip
+{
+public:
+	CompressedClip();
+
+	// Largest difference to the source at the samples
+	struct Error
+	{
+		float maxAngle;				// radians, over all joints
+		float maxTranslation;		// model units
+	};
+
+	// Compress source sampled at fps. No joint rotation deviates by more than
+	// angularTolerance (radians) and no translation by more than
+	// translationTolerance, except for the quantization of the kept keys.
+	// Returns false if there are too many samples for the format (65536).
+	bool compress(const AnimationClip &source, float fps, float angularTolerance, float translationTolerance,
+		Error *error = NULL);
+
+	bool save(const std::string &filename) const;
+	bool load(const std::string &filename);
+
+	// Size of the .clip file
+	size_t sizeInBytes() const;
+	unsigned numKeys() const { return m_keyFrames.size(); }
+	unsigned numSamples() const { return m_numSamples; }
+
+	bool empty() const { return m_numSamples == 0; }
+	float duration() const { return m_duration; }
+
+	void sample(float t, std::vector<float> &values, std::vector<Quat4f> &rotations) const;
+
+	// Smallest-three quantization of a unit quaternion into 48 bits
+	static void packRotation(const Quat4f &q, uint16_t packed[3]);
+	static Quat4f unpackRotation(const uint16_t packed[3]);
+
+private:
+	struct Track
+	{
+		uint32_t firstKey;			// first key of the track in m_keyFrames
+		uint32_t numKeys;
+		float offset[3], scale[3];	// translation = offset + scale * quantized value
+	};
+
+	// Position of time t in samples, e.g. 2.5 halfway between samples 2 and 3
+	float samplePosition(float t) const;
+
+	float m_fps;
+	float m_duration;
+	uint32_t m_numSamples;
+
+	// One track per control track, with the sample index and the 48-bit
+	// (3 x 16) value of every key, the keys of each track one after the other
+	std::vector<Track> m_tracks;
+	std::vector<uint16_t> m_keyFrames;
+	std::vector<uint16_t> m_keyData;
+};
+
+#endif // COMPRESSED_CLIP_H
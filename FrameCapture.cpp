@@ -0,0 +1,495 @@
+#ifndef WIN32
+#define GL_GLEXT_PROTOTYPES
+#endif
+
+#include "FrameCapture.h"
+#include "bitmap.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifdef WIN32
+#include "FL/png.h"
+#else
+#include <png.h>
+#endif
+
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_READ_ONLY
+#define GL_READ_ONLY 0x88B8
+#endif
+
+using namespace std;
+
+// Frames queued for the writer before capture() starts waiting for it
+static const size_t MAX_QUEUED_FRAMES = 32;
+
+// Buffer object entry points (GL 2.1), which the Windows GL headers do not declare
+static struct
+{
+	void (APIENTRY *genBuffers)(GLsizei n, GLuint *buffers);
+	void (APIENTRY *deleteBuffers)(GLsizei n, const GLuint *buffers);
+	void (APIENTRY *bindBuffer)(GLenum target, GLuint buffer);
+	void (APIENTRY *bufferData)(GLenum target, ptrdiff_t size, const void *data, GLenum usage);
+	void *(APIENTRY *mapBuffer)(GLenum target, GLenum access);
+	GLboolean (APIENTRY *unmapBuffer)(GLenum target);
+} gl;
+
+static bool loadPixelBufferFunctions()
+{
+	// Pixel buffer objects are core since GL 2.1
+	const char *version = (const char *) glGetString(GL_VERSION);
+	int major = 0, minor = 0;
+	if (!version || sscanf(version, "%d.%d", &major, &minor) != 2 || major * 10 + minor < 21)
+		return false;
+
+#ifdef WIN32
+	gl.genBuffers = (decltype(gl.genBuffers)) wglGetProcAddress("glGenBuffers");
+	gl.deleteBuffers = (decltype(gl.deleteBuffers)) wglGetProcAddress("glDeleteBuffers");
+	gl.bindBuffer = (decltype(gl.bindBuffer)) wglGetProcAddress("glBindBuffer");
+	gl.bufferData = (decltype(gl.bufferData)) wglGetProcAddress("glBufferData");
+	gl.mapBuffer = (decltype(gl.mapBuffer)) wglGetProcAddress("glMapBuffer");
+	gl.unmapBuffer = (decltype(gl.unmapBuffer)) wglGetProcAddress("glUnmapBuffer");
+#else
+	gl.genBuffers = glGenBuffers;
+	gl.deleteBuffers = glDeleteBuffers;
+	gl.bindBuffer = glBindBuffer;
+	gl.bufferData = (decltype(gl.bufferData)) glBufferData;
+	gl.mapBuffer = glMapBuffer;
+	gl.unmapBuffer = glUnmapBuffer;
+#endif
+	return gl.genBuffers && gl.deleteBuffers && gl.bindBuffer
+		&& gl.bufferData && gl.mapBuffer && gl.unmapBuffer;
+}
+
+FrameCapture::FrameCapture()
+	: m_active(false), m_format(CAPTURE_BMP), m_fps(30), m_frameIndex(0),
+	m_usePixelBuffers(false), m_bufferW(0), m_bufferH(0), m_nextBuffer(0), m_retiredFrames(0),
+	m_stopWriter(false), m_failedFrames(0), m_stream(NULL), m_streamW(0), m_streamH(0)
+{
+	fill(m_pixelBuffers, m_pixelBuffers + NUM_PIXEL_BUFFERS, 0);
+}
+
+FrameCapture::~FrameCapture()
+{
+	// Without a GL context the frames still in flight are lost, but the queued ones are written
+	if (m_active) {
+		m_inFlight.clear();
+		m_usePixelBuffers = false;
+		stop();
+	}
+}
+
+CaptureFormat FrameCapture::formatFromPath(const string &path)
+{
+	string extension = path.substr(path.rfind('.') + 1);
+	transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	if (extension == "png")
+		return CAPTURE_PNG;
+	if (extension == "ppm")
+		return CAPTURE_PPM;
+	if (extension == "y4m")
+		return CAPTURE_Y4M;
+	return CAPTURE_BMP;
+}
+
+// True if pattern has exactly one printf conversion, an integer one for the frame number
+static bool isFramePattern(const string &pattern)
+{
+	int numConversions = 0;
+	for (size_t i = 0; i < pattern.size(); ++i) {
+		if (pattern[i] != '%')
+			continue;
+		if (++i < pattern.size() && pattern[i] == '%')
+			continue;
+		i = pattern.find_first_not_of("-+ #0", i);
+		i = pattern.find_first_not_of("0123456789", i);
+		if (i < pattern.size() && pattern[i] == '.')
+			i = pattern.find_first_not_of("0123456789", i + 1);
+		if (i >= pattern.size() || !strchr("diu", pattern[i]))
+			return false;
+		++numConversions;
+	}
+	return numConversions == 1;
+}
+
+bool FrameCapture::start(const string &path, CaptureFormat format, unsigned fps)
+{
+	if (m_active)
+		return false;
+
+	if ((format == CAPTURE_BMP || format == CAPTURE_PNG) && !isFramePattern(path)) {
+		cerr << "Error: " << path << " needs exactly one integer conversion for the frame number, e.g. %04d" << endl;
+		return false;
+	}
+	if (format == CAPTURE_PPM || format == CAPTURE_Y4M) {
+		m_stream = fopen(path.c_str(), "wb");
+		if (!m_stream) {
+			cerr << "Error: couldn't open capture file " << path << endl;
+			return false;
+		}
+	}
+
+	m_path = path;
+	m_format = format;
+	m_fps = max(fps, 1u);
+	m_frameIndex = m_retiredFrames = m_failedFrames = 0;
+	m_bufferW = m_bufferH = 0;
+	m_streamW = m_streamH = 0;
+	m_stopWriter = false;
+	m_active = true;
+	m_writer = thread(&FrameCapture::writerLoop, this);
+	return true;
+}
+
+void FrameCapture::allocateBuffers(int w, int h)
+{
+	releaseBuffers();
+	m_bufferW = w;
+	m_bufferH = h;
+
+	m_usePixelBuffers = loadPixelBufferFunctions();
+	if (!m_usePixelBuffers)
+		return;
+
+	gl.genBuffers(NUM_PIXEL_BUFFERS, m_pixelBuffers);
+	for (int i = 0; i < NUM_PIXEL_BUFFERS; ++i) {
+		gl.bindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffers[i]);
+		gl.bufferData(GL_PIXEL_PACK_BUFFER, 3 * w * h, NULL, GL_STREAM_READ);
+	}
+	gl.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	m_nextBuffer = 0;
+}
+
+void FrameCapture::releaseBuffers()
+{
+	if (m_usePixelBuffers && m_pixelBuffers[0] != 0)
+		gl.deleteBuffers(NUM_PIXEL_BUFFERS, m_pixelBuffers);
+	fill(m_pixelBuffers, m_pixelBuffers + NUM_PIXEL_BUFFERS, 0);
+}
+
+void FrameCapture::capture(int w, int h)
+{
+	if (!m_active)
+		return;
+
+	if (w != m_bufferW || h != m_bufferH) {
+		while (!m_inFlight.empty())
+			retireOldest();
+		allocateBuffers(w, h);
+	}
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+	++m_frameIndex;
+
+	if (!m_usePixelBuffers) {
+		// No pixel buffer objects: read back synchronously, but still encode on the writer thread
+		Frame frame;
+		{
+			lock_guard<mutex> lock(m_mutex);
+			if (!m_freePixels.empty()) {
+				frame.pixels.swap(m_freePixels.back());
+				m_freePixels.pop_back();
+			}
+		}
+		frame.pixels.resize(3 * w * h);
+		frame.w = w;
+		frame.h = h;
+		frame.index = m_retiredFrames++;
+		glReadPixels(0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, frame.pixels.data());
+		enqueue(frame);
+		return;
+	}
+
+	// Start an asynchronous transfer into the next buffer of the ring
+	int buffer = m_nextBuffer;
+	m_nextBuffer = (m_nextBuffer + 1) % NUM_PIXEL_BUFFERS;
+	gl.bindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffers[buffer]);
+	glReadPixels(0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, 0);
+	gl.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	m_inFlight.push_back(buffer);
+
+	// Collect the transfer started two frames ago, which has had time to complete
+	if ((int) m_inFlight.size() >= NUM_PIXEL_BUFFERS)
+		retireOldest();
+}
+
+void FrameCapture::submit(const unsigned char *pixels, int w, int h)
+{
+	if (!m_active)
+		return;
+
+	Frame frame;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		if (!m_freePixels.empty()) {
+			frame.pixels.swap(m_freePixels.back());
+			m_freePixels.pop_back();
+		}
+	}
+	frame.pixels.assign(pixels, pixels + 3 * w * h);
+	frame.w = w;
+	frame.h = h;
+	frame.index = m_retiredFrames++;
+	++m_frameIndex;
+	enqueue(frame);
+}
+
+void FrameCapture::retireOldest()
+{
+	int buffer = m_inFlight.front();
+	m_inFlight.pop_front();
+
+	Frame frame;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		if (!m_freePixels.empty()) {
+			frame.pixels.swap(m_freePixels.back());
+			m_freePixels.pop_back();
+		}
+	}
+	frame.pixels.resize(3 * m_bufferW * m_bufferH);
+	frame.w = m_bufferW;
+	frame.h = m_bufferH;
+	frame.index = m_retiredFrames++;
+
+	gl.bindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffers[buffer]);
+	const unsigned char *mapped = (const unsigned char *) gl.mapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+	if (mapped) {
+		copy(mapped, mapped + frame.pixels.size(), frame.pixels.begin());
+		gl.unmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	gl.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	if (mapped)
+		enqueue(frame);
+	else {
+		lock_guard<mutex> lock(m_mutex);
+		++m_failedFrames;
+	}
+}
+
+void FrameCapture::enqueue(Frame &frame)
+{
+	unique_lock<mutex> lock(m_mutex);
+	// Only block the render loop if the writer falls far behind
+	m_queueChanged.wait(lock, [this] { return m_queue.size() < MAX_QUEUED_FRAMES; });
+	m_queue.push_back(Frame());
+	m_queue.back().pixels.swap(frame.pixels);
+	m_queue.back().w = frame.w;
+	m_queue.back().h = frame.h;
+	m_queue.back().index = frame.index;
+	m_queueChanged.notify_all();
+}
+
+bool FrameCapture::stop()
+{
+	if (!m_active)
+		return true;
+
+	while (!m_inFlight.empty())
+		retireOldest();
+	releaseBuffers();
+	m_bufferW = m_bufferH = 0;
+
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_stopWriter = true;
+		m_queueChanged.notify_all();
+	}
+	m_writer.join();
+
+	// Buffered stream data may only fail to write when the file is closed
+	if (m_stream) {
+		if (fclose(m_stream) != 0 && m_failedFrames == 0)
+			m_failedFrames = m_retiredFrames;
+		m_stream = NULL;
+	}
+	m_freePixels.clear();
+	m_active = false;
+	if (m_failedFrames > 0) {
+		cerr << "Error: couldn't write " << m_failedFrames << " of " << m_retiredFrames << " frames to " << m_path << endl;
+		return false;
+	}
+	cout << "Captured " << m_retiredFrames << " frames to " << m_path << endl;
+	return true;
+}
+
+void FrameCapture::writerLoop()
+{
+	unique_lock<mutex> lock(m_mutex);
+	while (true) {
+		m_queueChanged.wait(lock, [this] { return m_stopWriter || !m_queue.empty(); });
+		if (m_queue.empty())
+			break;
+
+		Frame frame;
+		frame.pixels.swap(m_queue.front().pixels);
+		frame.w = m_queue.front().w;
+		frame.h = m_queue.front().h;
+		frame.index = m_queue.front().index;
+		m_queue.pop_front();
+		m_queueChanged.notify_all();
+
+		lock.unlock();
+		bool written = writeFrame(frame);
+		lock.lock();
+		if (!written)
+			++m_failedFrames;
+
+		m_freePixels.push_back(vector<unsigned char>());
+		m_freePixels.back().swap(frame.pixels);
+	}
+}
+
+// The headers are built here rather than in the globals of writeBMP(), which the
+// UI thread uses to save screenshots while a capture runs
+static bool writeBMPFile(const char *filename, int w, int h, const unsigned char *data)
+{
+	FILE *file = fopen(filename, "wb");
+	if (!file) {
+		cerr << "Error: couldn't write " << filename << endl;
+		return false;
+	}
+
+	int rowBytes = (3 * w + 3) & ~3;
+	BMP_BITMAPFILEHEADER bmfh;
+	bmfh.bfType = 0x4d42;	// "BM"
+	bmfh.bfOffBits = 14 + sizeof(BMP_BITMAPINFOHEADER);
+	bmfh.bfSize = bmfh.bfOffBits + rowBytes * h;
+	bmfh.bfReserved1 = bmfh.bfReserved2 = 0;
+
+	BMP_BITMAPINFOHEADER bmih;
+	bmih.biSize = sizeof(BMP_BITMAPINFOHEADER);
+	bmih.biWidth = w;
+	bmih.biHeight = h;
+	bmih.biPlanes = 1;
+	bmih.biBitCount = 24;
+	bmih.biCompression = BMP_BI_RGB;
+	bmih.biSizeImage = 0;
+	bmih.biXPelsPerMeter = bmih.biYPelsPerMeter = (int) (100 / 2.54 * 72);
+	bmih.biClrUsed = bmih.biClrImportant = 0;
+
+	// The file header is packed, unlike the struct
+	bool written = fwrite(&bmfh.bfType, 2, 1, file) == 1 && fwrite(&bmfh.bfSize, 4, 1, file) == 1
+		&& fwrite(&bmfh.bfReserved1, 2, 1, file) == 1 && fwrite(&bmfh.bfReserved2, 2, 1, file) == 1
+		&& fwrite(&bmfh.bfOffBits, 4, 1, file) == 1 && fwrite(&bmih, sizeof(bmih), 1, file) == 1;
+
+	// Both GL and BMP rows are bottom-up; BMP pixels are BGR and rows padded to 4 bytes
+	vector<unsigned char> row(rowBytes, 0);
+	for (int y = 0; y < h && written; ++y) {
+		const unsigned char *pixel = data + 3 * w * y;
+		for (int x = 0; x < w; ++x, pixel += 3) {
+			row[3 * x] = pixel[2];
+			row[3 * x + 1] = pixel[1];
+			row[3 * x + 2] = pixel[0];
+		}
+		written = fwrite(row.data(), rowBytes, 1, file) == 1;
+	}
+
+	if (fclose(file) != 0)
+		written = false;
+	if (!written)
+		cerr << "Error: couldn't write " << filename << endl;
+	return written;
+}
+
+static bool writePNG(const char *filename, int w, int h, const unsigned char *data)
+{
+	FILE *file = fopen(filename, "wb");
+	if (!file) {
+		cerr << "Error: couldn't write " << filename << endl;
+		return false;
+	}
+
+	png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	png_infop info = png ? png_create_info_struct(png) : NULL;
+	if (!info || setjmp(png_jmpbuf(png))) {
+		cerr << "Error: couldn't encode " << filename << endl;
+		png_destroy_write_struct(&png, &info);
+		fclose(file);
+		return false;
+	}
+
+	png_init_io(png, file);
+	png_set_compression_level(png, 1);
+	png_set_IHDR(png, info, w, h, 8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+		PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+	png_write_info(png, info);
+	// GL rows are bottom-up
+	for (int y = h - 1; y >= 0; --y)
+		png_write_row(png, (png_bytep) (data + 3 * w * y));
+	png_write_end(png, info);
+
+	png_destroy_write_struct(&png, &info);
+	if (fclose(file) != 0) {
+		cerr << "Error: couldn't write " << filename << endl;
+		return false;
+	}
+	return true;
+}
+
+bool FrameCapture::writeFrame(const Frame &frame)
+{
+	int w = frame.w, h = frame.h;
+	const unsigned char *data = frame.pixels.data();
+
+	switch (m_format) {
+	case CAPTURE_BMP:
+	case CAPTURE_PNG:
+	{
+		char filename[1024];
+		// start() checked that the pattern takes just the frame number
+		if (snprintf(filename, sizeof(filename), m_path.c_str(), frame.index) >= (int) sizeof(filename)) {
+			cerr << "Error: the name of frame " << frame.index << " is too long" << endl;
+			return false;
+		}
+		if (m_format == CAPTURE_PNG)
+			return writePNG(filename, w, h, data);
+		return writeBMPFile(filename, w, h, data);
+	}
+	case CAPTURE_PPM:
+	{
+		bool written = fprintf(m_stream, "P6\n%d %d\n255\n", w, h) > 0;
+		for (int y = h - 1; y >= 0 && written; --y)
+			written = fwrite(data + 3 * w * y, 3, w, m_stream) == (size_t) w;
+		return written;
+	}
+	case CAPTURE_Y4M:
+	{
+		// The stream header fixes the frame size, so frames of another size fail
+		if (m_streamW == 0) {
+			fprintf(m_stream, "YUV4MPEG2 W%d H%d F%u:1 Ip A1:1 C444\n", w, h, m_fps);
+			m_scratch.resize(3 * w * h);
+			m_streamW = w;
+			m_streamH = h;
+		}
+		if (w != m_streamW || h != m_streamH)
+			return false;
+
+		// BT.601 studio-range RGB -> YCbCr, written as planar Y, Cb, Cr
+		unsigned char *planeY = m_scratch.data(), *planeU = planeY + w * h, *planeV = planeU + w * h;
+		for (int y = 0; y < h; ++y) {
+			const unsigned char *row = data + 3 * w * (h - 1 - y);
+			for (int x = 0; x < w; ++x) {
+				int r = row[3 * x], g = row[3 * x + 1], b = row[3 * x + 2], i = y * w + x;
+				planeY[i] = (unsigned char) (((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+				planeU[i] = (unsigned char) (((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+				planeV[i] = (unsigned char) (((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+			}
+		}
+		return fputs("FRAME\n", m_stream) >= 0
+			&& fwrite(m_scratch.data(), 1, m_scratch.size(), m_stream) == m_scratch.size();
+	}
+	}
+	return false;
+}
@@ -0,0 +1,103 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <GL/gl.h>
+
+enum CaptureFormat
+{
+	CAPTURE_BMP,	// one .bmp file per frame
+	CAPTURE_PNG,	// one .png file per frame
+	CAPTURE_PPM,	// all frames appended to a single binary PPM stream
+	CAPTURE_Y4M		// all frames appended to a single YUV4MPEG2 (4:4:4) stream
+};
+
+// Captures rendered frames without stalling the render loop.
+// Pixels are read back asynchronously into a ring of pixel buffer objects
+// and only mapped a couple of frames later, when the transfer is done.
+// A background thread then encodes and writes the frames.
+class FrameCapture
+{
+public:
+	FrameCapture();
+	~FrameCapture();
+
+	// Start a capture. For BMP and PNG, path is a printf-style pattern taking
+	// the frame number (e.g. "frame%04d.png"), and any other conversion is
+	// rejected; otherwise it names the stream file.
+	bool start(const std::string &path, CaptureFormat format, unsigned fps);
+
+	// Queue a readback of the w x h framebuffer that has just been drawn.
+	// The GL context must be current.
+	void capture(int w, int h);
+
+	// Queue a frame rendered on the CPU (bottom-up RGB rows); no GL context needed
+	void submit(const unsigned char *pixels, int w, int h);
+
+	// Finish the pending readbacks, wait for the writer and close the capture.
+	// The GL context must be current. Returns false, after reporting how many,
+	// if some frames couldn't be written.
+	bool stop();
+
+	bool active() const { return m_active; }
+	unsigned numFrames() const { return m_frameIndex; }
+
+	// Guess the format from the file extension (BMP if unknown)
+	static CaptureFormat formatFromPath(const std::string &path);
+
+private:
+	struct Frame
+	{
+		std::vector< unsigned char > pixels;	// bottom-up RGB rows
+		int w, h;
+		unsigned index;
+	};
+
+	void allocateBuffers(int w, int h);
+	void releaseBuffers();
+	void retireOldest();
+	void enqueue(Frame &frame);
+	void writerLoop();
+	bool writeFrame(const Frame &frame);
+
+	bool m_active;
+	CaptureFormat m_format;
+	std::string m_path;
+	unsigned m_fps;
+	unsigned m_frameIndex;
+
+	// Pixel buffer objects in flight, oldest first
+	static const int NUM_PIXEL_BUFFERS = 3;
+	GLuint m_pixelBuffers[NUM_PIXEL_BUFFERS];
+	bool m_usePixelBuffers;
+	int m_bufferW, m_bufferH;
+	int m_nextBuffer;
+	std::deque< int > m_inFlight;
+	unsigned m_retiredFrames;
+
+	// Frames waiting for the writer thread, and recycled pixel storage
+	std::thread m_writer;
+	std::mutex m_mutex;
+	std::condition_variable m_queueChanged;
+	std::deque< Frame > m_queue;
+	std::vector< std::vector< unsigned char > > m_freePixels;
+	bool m_stopWriter;
+	unsigned m_failedFrames;	// guarded by m_mutex until the writer has stopped
+
+	// Output of the PPM and Y4M streams (written by the writer thread only)
+	FILE *m_stream;
+	int m_streamW, m_streamH;
+	std::vector< unsigned char > m_scratch;
+};
+
+#endif // FRAME_CAPTURE_H
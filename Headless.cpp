@@ -0,0 +1,432 @@
+#include "Headless.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Animation.h"
+#include "BlendTree.h"
+#include "FrameCapture.h"
+#include "MemoryReport.h"
+#include "OffscreenContext.h"
+#include "PcaVertexAnimation.h"
+#include "SceneRenderer.h"
+#include "SkeletalModel.h"
+#include "SoftwareRenderer.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include "ViewState.h"
+
+using namespace std;
+
+static void printUsage(const char *program)
+{
+	cout << "Usage: " << program << " --headless [options] PREFIX1 PREFIX2 ..." << endl
+		<< "Options:" << endl
+		<< "  --anim FILE         render every frame of an .anim or .clip file (default: the bind pose only)" << endl
+		<< "  --blend FILE W      cross-fade the clips of all --blend options by weight W, applied to every" << endl
+		<< "                      model (the controls of one model, instead of --anim)" << endl
+		<< "  --layer FILE W J    add the motion of a clip from its first frame, scaled by W, to joint J" << endl
+		<< "                      of the first model and its descendants (-1: all joints)" << endl
+		<< "  --fps N             frames per second sampled from the animation (default: 30)" << endl
+		<< "  --loops N           play the animation N times (default: 1)" << endl
+		<< "  --vertex-cache MB   cache the skinned meshes of every frame for later loops, within MB megabytes" << endl
+		<< "  --vertex-cache-file FILE  keep the vertex cache in a memory-mapped FILE instead of memory" << endl
+		<< "  --bake              fill the vertex cache before rendering, instead of during the first loop" << endl
+		<< "  --pipeline          skin the next frame of the --anim animation while the current one renders" << endl
+		<< "  --pca K             play the --anim animation from its skinned meshes compressed to at most K" << endl
+		<< "                      principal components per model, instead of skinning" << endl
+		<< "  --pca-error E       use only as many components as needed for an RMS vertex error of E" << endl
+		<< "  --out PATTERN       printf-style name of the .bmp or .png frame files (default: frame%04d.bmp)," << endl
+		<< "                      or the name of a single .ppm or .y4m stream" << endl
+		<< "  --size W H          image size in pixels (default: 800 800)" << endl
+		<< "  --camera D X Y Z    camera distance and center (default: 2 0.5 0.5 0.5)" << endl
+		<< "  --skeleton          draw the skeleton instead of the mesh" << endl
+		<< "  --color             color the mesh by joint bindings" << endl
+		<< "  --no-axes           do not draw the axes" << endl
+		<< "  --software          rasterize on the CPU instead of through OpenGL" << endl
+		<< "  --threads N         threads of the software rasterizer (default: one per core)" << endl
+		<< "  --trace FILE        write a Chrome trace-event timeline of loading, skinning and drawing to FILE" << endl
+		<< "  --memory            print the bytes held by every model and cache, and the peak resident size" << endl;
+}
+
+// Skin every frame of the animation live and compress the meshes of each model,
+// reporting the memory saved and the error against the live meshes
+static void compressSkinnedFrames(vector<SkeletalModel> &models, unsigned numFrames,
+	const function<void(unsigned)> &poseFrame, int maxComponents, float maxRmsError, ThreadPool &pool,
+	vector<PcaVertexAnimation> &pcaMeshes)
+{
+	vector<Vector3f> frames, vertices;
+	for (int m = 0, numModels = models.size(); m < numModels; ++m) {
+		const Mesh &mesh = models[m].getMesh();
+		int numVertices = mesh.bindVertices.size();
+		frames.resize((size_t) numFrames * numVertices);
+		for (unsigned f = 0; f < numFrames; ++f) {
+			poseFrame(f);
+			models[m].updateMesh();
+			copy(mesh.currentVertices.begin(), mesh.currentVertices.end(), frames.begin() + (size_t) f * numVertices);
+		}
+
+		auto buildStart = chrono::steady_clock::now();
+		pcaMeshes[m].build(frames, numFrames, numVertices, maxComponents, maxRmsError);
+		double buildSecs = chrono::duration<double>(chrono::steady_clock::now() - buildStart).count();
+
+		// Error of the rebuilt frames, per vertex
+		double squaredError = 0, maxError = 0;
+		auto rebuildStart = chrono::steady_clock::now();
+		for (unsigned f = 0; f < numFrames; ++f) {
+			pcaMeshes[m].reconstruct(f, vertices, &pool);
+			for (int v = 0; v < numVertices; ++v) {
+				double error = (vertices[v] - frames[(size_t) f * numVertices + v]).absSquared();
+				squaredError += error;
+				maxError = max(maxError, error);
+			}
+		}
+		double rebuildSecs = chrono::duration<double>(chrono::steady_clock::now() - rebuildStart).count();
+
+		size_t bakedBytes = (size_t) numFrames * numVertices * sizeof(Vector3f);
+		size_t cachedBytes = bakedBytes + (size_t) numFrames * mesh.faces.size() * sizeof(Vector3f);
+		size_t pcaBytes = pcaMeshes[m].sizeInBytes();
+		cout << "Model " << m << ": " << pcaMeshes[m].numComponents() << " components, " << pcaBytes / 1024
+			<< " KB (" << (double) bakedBytes / pcaBytes << ":1 vs baked positions, "
+			<< (double) cachedBytes / pcaBytes << ":1 vs the vertex cache), built in " << buildSecs << " s" << endl
+			<< "  error vs updateMesh: RMS " << sqrt(squaredError / ((double) numFrames * numVertices))
+			<< " (" << pcaMeshes[m].rmsError() << " when built), max " << sqrt(maxError)
+			<< "; rebuilt in " << rebuildSecs * 1e3 / numFrames << " ms/frame" << endl;
+	}
+}
+
+int runHeadless(int argc, char* argv[])
+{
+	string animFile, outPattern = "frame%04d.bmp";
+	unsigned fps = 30;
+	int w = 800, h = 800;
+	float distance = 2;
+	Vector3f center(0.5, 0.5, 0.5);
+	bool drawSkeleton = false, drawColor = false, drawAxes = true, software = false;
+	int numThreads = 0;
+	unsigned numLoops = 1;
+	size_t cacheBudget = 0;
+	string cacheFile;
+	bool bake = false, pipelining = false;
+	int pcaComponents = 0;
+	float pcaError = 0;
+	string traceFile;
+	bool memoryReport = false;
+	vector<string> prefixes;
+
+	// Clips of the blend tree, with their weight (and the joint of the mask for layers)
+	struct BlendInput
+	{
+		string filename;
+		float weight;
+		int joint;
+		bool additive;
+	};
+	vector<BlendInput> blendInputs;
+
+	// argv[1] is "--headless" itself
+	for (int i = 2; i < argc; ++i) {
+		string arg = argv[i];
+		int remaining = argc - i - 1;
+		if (arg == "--anim" && remaining >= 1)
+			animFile = argv[++i];
+		else if (arg == "--blend" && remaining >= 2) {
+			BlendInput input = { argv[i + 1], (float) atof(argv[i + 2]), -1, false };
+			blendInputs.push_back(input);
+			i += 2;
+		}
+		else if (arg == "--layer" && remaining >= 3) {
+			BlendInput input = { argv[i + 1], (float) atof(argv[i + 2]), atoi(argv[i + 3]), true };
+			blendInputs.push_back(input);
+			i += 3;
+		}
+		else if (arg == "--fps" && remaining >= 1)
+			fps = max(atoi(argv[++i]), 1);
+		else if (arg == "--loops" && remaining >= 1)
+			numLoops = max(atoi(argv[++i]), 1);
+		else if (arg == "--vertex-cache" && remaining >= 1)
+			cacheBudget = (size_t) (max(atof(argv[++i]), 0.0) * (1 << 20));
+		else if (arg == "--vertex-cache-file" && remaining >= 1)
+			cacheFile = argv[++i];
+		else if (arg == "--bake")
+			bake = true;
+		else if (arg == "--pipeline")
+			pipelining = true;
+		else if (arg == "--pca" && remaining >= 1)
+			pcaComponents = max(atoi(argv[++i]), 1);
+		else if (arg == "--pca-error" && remaining >= 1)
+			pcaError = (float) max(atof(argv[++i]), 0.0);
+		else if (arg == "--out" && remaining >= 1)
+			outPattern = argv[++i];
+		else if (arg == "--size" && remaining >= 2) {
+			w = atoi(argv[++i]);
+			h = atoi(argv[++i]);
+		}
+		else if (arg == "--camera" && remaining >= 4) {
+			distance = (float) atof(argv[++i]);
+			for (int k = 0; k < 3; ++k)
+				center[k] = (float) atof(argv[++i]);
+		}
+		else if (arg == "--skeleton")
+			drawSkeleton = true;
+		else if (arg == "--color")
+			drawColor = true;
+		else if (arg == "--no-axes")
+			drawAxes = false;
+		else if (arg == "--software")
+			software = true;
+		else if (arg == "--threads" && remaining >= 1)
+			numThreads = max(atoi(argv[++i]), 1);
+		else if (arg == "--trace" && remaining >= 1)
+			traceFile = argv[++i];
+		else if (arg == "--memory")
+			memoryReport = true;
+		else if (arg.compare(0, 2, "--") == 0) {
+			cerr << "Error: unknown or incomplete option " << arg << endl;
+			printUsage(argv[0]);
+			return -1;
+		}
+		else
+			prefixes.push_back(arg);
+	}
+	bool blending = !blendInputs.empty();
+	if (prefixes.empty() || w <= 0 || h <= 0 || (blending && (!animFile.empty() || blendInputs[0].additive))) {
+		printUsage(argv[0]);
+		return -1;
+	}
+	if (!traceFile.empty())
+		Trace::start(traceFile);
+
+	// The models, camera, vertex cache and skinning pipeline, updated the same way
+	// as by the model window. The models are loaded and their controls laid out
+	// the same way as in the modeler UI.
+	ViewState view(numThreads);
+	vector<SkeletalModel> &models = view.models;
+	models.resize(prefixes.size());
+	vector<int> controlOffsets;
+	vector<bool> controlIsTranslation;
+	for (int m = 0, numModels = models.size(); m < numModels; ++m) {
+		models[m].load(prefixes[m]);
+		cout << "Read joints: " << models[m].getJoints().size() << endl;
+		controlOffsets.push_back(controlIsTranslation.size());
+		for (int c = 0, numControls = models[m].getNumControls(); c < numControls; ++c)
+			controlIsTranslation.push_back(c < 3);
+	}
+
+	// Without an animation, the bind pose is rendered once
+	unique_ptr<AnimationClip> clip;
+	if (!animFile.empty()) {
+		clip.reset(loadAnimationClip(animFile, controlIsTranslation));
+		if (!clip) {
+			cerr << "Error: couldn't read animation file " << animFile << endl;
+			return -1;
+		}
+	}
+	unsigned numFrames = !clip || clip->empty() ? 1 : clip->numFrames(fps);
+
+	// The blend tree animates every model with the same clips (in the layout of one
+	// model), each model with its own instance
+	int maxControls = 0;
+	for (SkeletalModel &model : models)
+		maxControls = max(maxControls, model.getNumControls());
+	BlendTree tree(maxControls);
+	vector<unique_ptr<AnimationClip>> blendClips;
+	vector<BlendTree::Instance> instances(models.size());
+	if (blending) {
+		vector<int> crossFade;
+		vector<float> weights;
+		int root = -1;
+		for (const BlendInput &input : blendInputs) {
+			blendClips.emplace_back(loadAnimationClip(input.filename, vector<bool>(3, true)));
+			if (!blendClips.back()) {
+				cerr << "Error: couldn't read animation file " << input.filename << endl;
+				return -1;
+			}
+			int node = tree.addClip(blendClips.back().get());
+			weights.resize(tree.numNodes(), 1.f);
+			weights[node] = input.weight;
+			if (!input.additive) {
+				crossFade.push_back(node);
+				continue;
+			}
+			if (root < 0)
+				root = crossFade.size() == 1 ? crossFade[0] : tree.addBlend(crossFade);
+			int mask = input.joint >= 0 && input.joint < (int) models[0].getJoints().size()
+				? tree.addJointMask(models[0].getJoints(), input.joint) : -1;
+			root = tree.addAdditive(root, node, mask);
+		}
+		if (root < 0 && crossFade.size() > 1)
+			tree.addBlend(crossFade);
+		weights.resize(tree.numNodes(), 1.f);
+
+		for (BlendTree::Instance &instance : instances) {
+			tree.initInstance(instance);
+			instance.weights = weights;
+		}
+		numFrames = (unsigned) floor(tree.duration() * fps + 1e-3f) + 1;
+	}
+	vector<float> controls;
+	vector<Quat4f> rotations;
+
+	Camera &camera = view.camera;
+	camera.SetDistance(distance);
+	camera.SetCenter(center);
+	view.drawSkeleton = drawSkeleton;
+
+	// The software renderer needs no GL context at all
+	OffscreenContext context;
+	SceneRenderer scene;
+	SoftwareRenderer softwareScene(numThreads);
+	if (software)
+		softwareScene.setup(camera, w, h);
+	else {
+		if (!context.create(w, h))
+			return -1;
+		scene.setup(camera, w, h);
+		if (drawColor && !drawSkeleton)
+			glEnable(GL_COLOR_MATERIAL);
+	}
+
+	// Frames are read back and written asynchronously
+	FrameCapture capture;
+	if (!capture.start(outPattern, FrameCapture::formatFromPath(outPattern), fps))
+		return -1;
+
+	// Models are posed in parallel, by a task made once so that frames do not allocate
+	ThreadPool posePool(blending ? numThreads : 1);
+	float frameTime = 0;
+	function<void(int)> poseModel = [&](int m) {
+		tree.evaluate(frameTime, instances[m]);
+		const BlendTree::Pose &pose = instances[m].pose();
+		models[m].setControlValues(pose.values.data(), pose.rotations.data());
+		models[m].updateCurrentJointToWorldTransforms();
+	};
+
+	auto poseFrame = [&](unsigned f) {
+		if (blending) {
+			frameTime = (float) f / fps;
+			posePool.parallelFor(models.size(), poseModel);
+			return;
+		}
+
+		// Controls beyond the clip stay in the bind pose
+		if (clip)
+			clip->sample((float) f / fps, controls, rotations);
+		controls.resize(controlIsTranslation.size(), 0.f);
+		rotations.resize(controlIsTranslation.size() / 3, Quat4f::IDENTITY);
+
+		// Pose every model; the renderer skins the visible ones
+		for (int m = 0, numModels = models.size(); m < numModels; ++m) {
+			models[m].setControlValues(&controls[controlOffsets[m]], &rotations[controlOffsets[m] / 3]);
+			models[m].updateCurrentJointToWorldTransforms();
+		}
+	};
+
+	// The skinned meshes of the animation are compressed up front and rebuilt
+	// from their principal components, instead of the cache and the pipeline
+	bool pca = pcaComponents > 0 && clip && !blending;
+	vector<PcaVertexAnimation> pcaMeshes(pca ? models.size() : 0);
+	vector<vector<Vector3f>> pcaVertices(pcaMeshes.size()), pcaNormals(pcaMeshes.size());
+	ThreadPool pcaPool(numThreads);
+	if (pca) {
+		cacheBudget = 0;
+		pipelining = false;
+		compressSkinnedFrames(models, numFrames, poseFrame, pcaComponents, pcaError, pcaPool, pcaMeshes);
+	}
+
+	// Skinned meshes are cached across loops, if they fit in the budget
+	VertexCache &cache = view.vertexCache;
+	if (cacheBudget > 0) {
+		if (cache.create(models, numFrames, cacheBudget, cacheFile)) {
+			cout << "Caching skinned frames: " << cache.sizeInBytes() / (1 << 20) << " MB" << endl;
+			if (!cacheFile.empty() && !cache.mapped())
+				cerr << "Warning: memory-mapped vertex caches are not supported on this platform; using memory" << endl;
+		}
+		else if (VertexCache::requiredBytes(models, numFrames) <= cacheBudget) {
+			cerr << "Error: couldn't map vertex cache file " << cacheFile << endl;
+			return -1;
+		}
+		else
+			cout << "Not caching skinned frames: they need " << VertexCache::requiredBytes(models, numFrames) / (1 << 20)
+				<< " MB, over the budget" << endl;
+	}
+	if (bake && cache.enabled()) {
+		auto bakeStart = chrono::steady_clock::now();
+		for (unsigned f = 0; f < numFrames; ++f) {
+			poseFrame(f);
+			for (int m = 0, numModels = models.size(); m < numModels; ++m) {
+				models[m].updateMesh();
+				cache.store(f, m, models[m].getMesh());
+			}
+		}
+		cout << "Baked " << numFrames << " frames in "
+			<< chrono::duration<double>(chrono::steady_clock::now() - bakeStart).count() << " s" << endl;
+	}
+
+	// The next frame is skinned on the pipeline's threads while the renderer draws,
+	// unless it is cached already
+	vector<float> nextControls;
+	vector<Quat4f> nextRotations;
+	pipelining = pipelining && clip && !blending;
+	int clipControls = clip ? min((int) clip->numControls(), (int) controlIsTranslation.size()) : 0;
+
+	auto startTime = chrono::steady_clock::now();
+	unsigned numRendered = numFrames * numLoops;
+	for (unsigned n = 0; n < numRendered; ++n) {
+		unsigned f = n % numFrames;
+		TraceSpan span("frame", "frame", n);
+		if (!pipelining || !view.presentFrame(f)) {
+			poseFrame(f);
+			for (int m = 0, numModels = pcaMeshes.size(); m < numModels; ++m) {
+				pcaMeshes[m].reconstruct(f, pcaVertices[m], &pcaPool);
+				models[m].getMesh().computeNormals(pcaVertices[m], pcaNormals[m]);
+				models[m].swapSkinnedMesh(pcaVertices[m], pcaNormals[m]);
+			}
+			if (!pca)
+				view.updateFrame(f);
+		}
+
+		if (pipelining && n + 1 < numRendered) {
+			unsigned next = (n + 1) % numFrames;
+			clip->sample((float) next / fps, nextControls, nextRotations);
+			view.skinFrameAhead(next, nextControls.data(), nextRotations.data(), clipControls);
+		}
+
+		if (software) {
+			softwareScene.draw(camera, models, drawAxes, drawSkeleton, drawColor);
+			capture.submit(softwareScene.pixels(), w, h);
+		}
+		else {
+			scene.draw(camera, models, drawAxes, drawSkeleton);
+			capture.capture(w, h);
+		}
+	}
+	bool captured = capture.stop();
+	double elapsedSecs = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+	cout << "Rendered " << numRendered << " frames in " << elapsedSecs << " s ("
+		<< numRendered / elapsedSecs << " frames/s)" << endl;
+	if (cache.enabled())
+		cout << view.numCacheLoads() << " meshes streamed from the vertex cache" << endl;
+
+	if (memoryReport) {
+		MemoryReport report;
+		view.reportMemory(report, prefixes);
+		for (int m = 0, numModels = pcaMeshes.size(); m < numModels; ++m) {
+			report.begin("PCA vertex animation of model " + to_string(m));
+			pcaMeshes[m].reportMemory(report);
+			report.add("rebuilt meshes", pcaVertices[m]);
+			report.add("rebuilt meshes", pcaNormals[m]);
+		}
+		cout << "Memory:" << endl;
+		report.print(cout);
+	}
+	return captured ? 0 : -1;
+}
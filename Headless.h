@@ -0,0 +1,9 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+// Entry point of "a3 --headless ...": render the models (optionally through an
+// animation) into an offscreen framebuffer and write the frames to disk,
+// without creating any window.
+int runHeadless(int argc, char* argv[]);
+
+#endif // HEADLESS_H
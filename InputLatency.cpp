@@ -0,0 +1,156 @@
+#include "InputLatency.h"
+
+#include <algorithm>
+#include <fstream>
+
+using namespace std;
+
+// Events kept; the older half is dropped when there are more, so memory stays bounded in long sessions
+static const size_t MAX_SAMPLES = 1 << 20;
+
+static float milliseconds(chrono::steady_clock::duration duration)
+{
+	return chrono::duration<float, milli>(duration).count();
+}
+
+InputLatency::InputLatency()
+	: m_numDrawn(0), m_numFrames(0), m_numPresented(0), m_numCoalesced(0), m_numDropped(0), m_maxPerFrame(0)
+{
+}
+
+const char *InputLatency::name(Stage stage)
+{
+	static const char *names[NUM_STAGES] = {
+		"update",
+		"wait",
+		"draw",
+		"swap"
+	};
+	return names[stage];
+}
+
+void InputLatency::eventReceived(int source)
+{
+	Clock::time_point now = Clock::now();
+	PendingEvent event = { source, now, now };
+	m_pending.push_back(event);
+}
+
+void InputLatency::updated()
+{
+	Clock::time_point now = Clock::now();
+	for (size_t i = m_numDrawn; i < m_pending.size(); ++i)
+		if (m_pending[i].source >= 0)
+			m_pending[i].updated = now;
+}
+
+void InputLatency::drawStarted()
+{
+	m_numDrawn = m_pending.size();
+	m_drawStart = Clock::now();
+}
+
+void InputLatency::drawSubmitted()
+{
+	m_drawEnd = Clock::now();
+}
+
+void InputLatency::presented()
+{
+	if (m_numDrawn == 0)
+		return;
+	Clock::time_point now = Clock::now();
+
+	if (m_samples.size() + m_numDrawn > MAX_SAMPLES)
+		m_samples.erase(m_samples.begin(), m_samples.begin() + MAX_SAMPLES / 2);
+
+	size_t numShown = 0;
+	for (size_t i = 0; i < m_numDrawn; ++i) {
+		const PendingEvent &event = m_pending[i];
+		bool dropped = false;
+		for (size_t j = i + 1; j < m_numDrawn && !dropped; ++j)
+			dropped = m_pending[j].source == event.source;
+
+		Sample sample = { m_numFrames, event.source, dropped, {
+			milliseconds(event.updated - event.received),
+			milliseconds(m_drawStart - event.updated),
+			milliseconds(m_drawEnd - m_drawStart),
+			milliseconds(now - m_drawEnd) } };
+		m_samples.push_back(sample);
+		numShown += !dropped;
+		m_numDropped += dropped;
+	}
+	m_numPresented += numShown;
+	m_numCoalesced += numShown - 1;
+	m_maxPerFrame = max(m_maxPerFrame, m_numDrawn);
+	++m_numFrames;
+
+	// Events that came in while drawing wait for the next frame
+	m_pending.erase(m_pending.begin(), m_pending.begin() + m_numDrawn);
+	m_numDrawn = 0;
+}
+
+PhaseTimings::Summary InputLatency::summarize(size_t lastEvents) const
+{
+	vector<float> totals;
+	for (size_t i = m_samples.size(); i-- > 0 && (lastEvents == 0 || totals.size() < lastEvents); ) {
+		const Sample &sample = m_samples[i];
+		if (!sample.dropped)
+			totals.push_back(sample.ms[UPDATE] + sample.ms[WAIT] + sample.ms[DRAW] + sample.ms[SWAP]);
+	}
+	return PhaseTimings::summarize(totals);
+}
+
+PhaseTimings::Summary InputLatency::summarize(Stage stage) const
+{
+	vector<float> times;
+	for (const Sample &sample : m_samples)
+		if (!sample.dropped)
+			times.push_back(sample.ms[stage]);
+	return PhaseTimings::summarize(times);
+}
+
+void InputLatency::printReport(ostream &out) const
+{
+	PhaseTimings::Summary total = summarize();
+	out << "Input to present latency over " << m_numPresented << " events in " << m_numFrames << " frames (ms):" << endl
+		<< "  total  mean " << total.mean << ", p50 " << total.p50 << ", p95 " << total.p95 << ", p99 " << total.p99
+		<< ", max " << total.max << endl;
+	for (int stage = 0; stage < NUM_STAGES; ++stage) {
+		PhaseTimings::Summary s = summarize((Stage) stage);
+		out << "  " << name((Stage) stage) << "  mean " << s.mean << ", p95 " << s.p95 << ", max " << s.max << endl;
+	}
+	double perFrame = m_numFrames ? 1.0 / m_numFrames : 0;
+	out << "  coalesced: " << m_numCoalesced << " events (" << m_numCoalesced * perFrame << " per frame)" << endl
+		<< "  dropped:   " << m_numDropped << " events superseded before being shown (" << m_numDropped * perFrame
+		<< " per frame)" << endl
+		<< "  at most " << m_maxPerFrame << " events in one frame" << endl;
+}
+
+void InputLatency::reportMemory(MemoryReport &report) const
+{
+	report.add("input latency", m_pending);
+	report.add("input latency", m_samples);
+}
+
+bool InputLatency::writeCsv(const string &filename) const
+{
+	ofstream file(filename);
+	file << "frame,source,dropped,update_ms,wait_ms,draw_ms,swap_ms,total_ms" << endl;
+	for (const Sample &sample : m_samples) {
+		const char *source = sample.source == CAMERA ? "camera" : sample.source == KEY ? "key" : NULL;
+		file << sample.frame << ",";
+		if (source)
+			file << source;
+		else
+			file << "slider " << sample.source;
+		file << "," << sample.dropped;
+		float total = 0;
+		for (int stage = 0; stage < NUM_STAGES; ++stage) {
+			file << "," << sample.ms[stage];
+			total += sample.ms[stage];
+		}
+		file << "," << total << endl;
+	}
+	return file.good();
+}
@@ -0,0 +1,84 @@
+#ifndef INPUT_LATENCY_H
+#define INPUT_LATENCY_H
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "PhaseTimings.h"
+
+// Latency from input events of the model window (slider moves, mouse and key
+// events) until the frame that shows them is presented, split into the stages
+// in between. Events that arrive before the same frame are coalesced into it;
+// an event followed by another of the same source before that frame is never
+// shown, and counts as dropped instead.
+class InputLatency
+{
+public:
+	// Sources of events other than sliders, which are numbered from 0 by control
+	enum Source { CAMERA = -1, KEY = -2 };
+
+	enum Stage
+	{
+		UPDATE,		// posing and skinning for a slider; 0 for other events
+		WAIT,		// until the window redraws
+		DRAW,		// draw submission
+		SWAP,		// the buffer swap, until it returns
+		NUM_STAGES
+	};
+
+	InputLatency();
+
+	static const char *name( Stage stage );
+
+	void eventReceived( int source );
+	// The pose of the pending slider events has been applied
+	void updated();
+	void drawStarted();
+	void drawSubmitted();
+	// The buffers have been swapped: the events pending when drawing started are on screen
+	void presented();
+
+	// Time from each event to its frame, over the last events presented (0: all of them)
+	PhaseTimings::Summary summarize( size_t lastEvents = 0 ) const;
+	PhaseTimings::Summary summarize( Stage stage ) const;
+
+	size_t numEvents() const { return m_numPresented + m_numDropped; }
+
+	void reportMemory( MemoryReport& report ) const;
+
+	// Latency distribution, per stage, and events per frame
+	void printReport( std::ostream& out ) const;
+
+	// One line per event; false if the file cannot be written
+	bool writeCsv( const std::string& filename ) const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct PendingEvent
+	{
+		int source;
+		Clock::time_point received, updated;
+	};
+
+	struct Sample
+	{
+		unsigned frame;
+		int source;
+		bool dropped;
+		float ms[ NUM_STAGES ];
+	};
+
+	std::vector< PendingEvent > m_pending;
+	size_t m_numDrawn;		// pending events the frame being drawn shows
+	Clock::time_point m_drawStart, m_drawEnd;
+
+	std::vector< Sample > m_samples;
+	unsigned m_numFrames;	// frames that showed input
+	size_t m_numPresented, m_numCoalesced, m_numDropped;
+	size_t m_maxPerFrame;
+};
+
+#endif // INPUT_LATENCY_H
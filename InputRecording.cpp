@@ -0,0 +1,324 @@
+#include "InputRecording.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+using namespace std;
+
+static const char MAGIC[4] = { 'A', '3', 'I', 'R' };
+static const uint8_t VERSION = 1;
+
+// Events are written out in blocks of about this many bytes
+static const size_t FLUSH_BYTES = 64 * 1024;
+
+static int64_t nowMicros()
+{
+	return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Reads the encoding of InputRecording from a buffer, failing past its end
+class RecordingReader
+{
+public:
+	RecordingReader(const vector<uint8_t> &data) : m_data(data), m_pos(0), m_ok(true) {}
+
+	bool ok() const { return m_ok; }
+	bool atEnd() const { return m_pos >= m_data.size(); }
+
+	uint8_t readByte()
+	{
+		if (m_pos >= m_data.size()) {
+			m_ok = false;
+			return 0;
+		}
+		return m_data[m_pos++];
+	}
+
+	// Zigzag-encoded LEB128
+	int64_t readVarint()
+	{
+		uint64_t bits = 0;
+		for (int shift = 0; shift < 64 && m_ok; shift += 7) {
+			uint8_t byte = readByte();
+			bits |= (uint64_t) (byte & 0x7f) << shift;
+			if (!(byte & 0x80))
+				break;
+		}
+		return (int64_t) (bits >> 1) ^ -(int64_t) (bits & 1);
+	}
+
+	float readFloat()
+	{
+		uint8_t bytes[4];
+		for (uint8_t &byte : bytes)
+			byte = readByte();
+		float value;
+		memcpy(&value, bytes, sizeof(value));
+		return value;
+	}
+
+	string readText()
+	{
+		size_t length = (size_t) readVarint();
+		if (!m_ok || length > m_data.size() - m_pos) {
+			m_ok = false;
+			return "";
+		}
+		string text(m_data.begin() + m_pos, m_data.begin() + m_pos + length);
+		m_pos += length;
+		return text;
+	}
+
+private:
+	const vector<uint8_t> &m_data;
+	size_t m_pos;
+	bool m_ok;
+};
+
+InputRecording::InputRecording()
+	: m_file(NULL), m_startMicros(0), m_lastMicros(0), m_width(0), m_height(0)
+{
+}
+
+InputRecording::~InputRecording()
+{
+	stopRecording();
+}
+
+const char *InputRecording::name(EventType type)
+{
+	static const char *names[NUM_EVENT_TYPES] = {
+		"slider",
+		"mouse push",
+		"mouse drag",
+		"mouse release",
+		"key",
+		"resize",
+		"positions",
+		"load animation",
+		"play",
+		"animation frame",
+		"cache",
+		"pipeline",
+		"present"
+	};
+	return names[type];
+}
+
+bool InputRecording::startRecording(const string &filename, const vector<string> &prefixes, int width, int height)
+{
+	stopRecording();
+	m_file = fopen(filename.c_str(), "wb");
+	if (!m_file) {
+		cerr << "Error: couldn't write input recording " << filename << endl;
+		return false;
+	}
+
+	m_buffer.assign(MAGIC, MAGIC + sizeof(MAGIC));
+	m_buffer.push_back(VERSION);
+	writeVarint(prefixes.size());
+	for (const string &prefix : prefixes)
+		writeText(prefix);
+	writeVarint(width);
+	writeVarint(height);
+
+	m_startMicros = m_lastMicros = nowMicros();
+	return true;
+}
+
+void InputRecording::beginEvent(EventType type)
+{
+	int64_t now = nowMicros();
+	m_buffer.push_back((uint8_t) type);
+	writeVarint(now - m_lastMicros);
+	m_lastMicros = now;
+}
+
+void InputRecording::record(EventType type, int a, int b, int c, float value)
+{
+	if (!m_file)
+		return;
+
+	beginEvent(type);
+	switch (type) {
+	case SLIDER:
+		writeVarint(a);
+		writeFloat(value);
+		break;
+	case MOUSE_PUSH:
+		writeVarint(a);
+		writeVarint(b);
+		writeVarint(c);
+		break;
+	case MOUSE_DRAG:
+	case MOUSE_RELEASE:
+		writeVarint(b);
+		writeVarint(c);
+		break;
+	case RESIZE:
+		writeVarint(a);
+		writeVarint(b);
+		break;
+	case KEY:
+	case PLAY:
+	case ANIMATION_FRAME:
+	case CACHE:
+	case PIPELINE:
+		writeVarint(a);
+		break;
+	default:
+		break;
+	}
+	if (m_buffer.size() >= FLUSH_BYTES)
+		flush();
+}
+
+void InputRecording::recordText(EventType type, const string &text)
+{
+	if (!m_file)
+		return;
+
+	beginEvent(type);
+	writeText(text);
+	flush();
+}
+
+void InputRecording::recordPositions(const vector<int> &controls, const vector<float> &values)
+{
+	if (!m_file)
+		return;
+
+	beginEvent(POSITIONS);
+	writeVarint(controls.size());
+	for (size_t i = 0; i < controls.size(); ++i) {
+		writeVarint(controls[i]);
+		writeFloat(values[i]);
+	}
+	flush();
+}
+
+void InputRecording::stopRecording()
+{
+	if (!m_file)
+		return;
+	flush();
+	fclose(m_file);
+	m_file = NULL;
+}
+
+void InputRecording::writeVarint(int64_t value)
+{
+	uint64_t bits = ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+	do {
+		uint8_t byte = bits & 0x7f;
+		bits >>= 7;
+		m_buffer.push_back(byte | (bits ? 0x80 : 0));
+	} while (bits);
+}
+
+void InputRecording::writeFloat(float value)
+{
+	uint8_t bytes[4];
+	memcpy(bytes, &value, sizeof(value));
+	m_buffer.insert(m_buffer.end(), bytes, bytes + 4);
+}
+
+void InputRecording::writeText(const string &text)
+{
+	writeVarint(text.size());
+	m_buffer.insert(m_buffer.end(), text.begin(), text.end());
+}
+
+void InputRecording::flush()
+{
+	if (m_file && !m_buffer.empty()) {
+		fwrite(m_buffer.data(), 1, m_buffer.size(), m_file);
+		fflush(m_file);
+	}
+	m_buffer.clear();
+}
+
+bool InputRecording::load(const string &filename)
+{
+	ifstream file(filename, ios::binary);
+	vector<uint8_t> data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+	m_prefixes.clear();
+	m_events.clear();
+	if (data.size() < sizeof(MAGIC) + 1 || memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0
+		|| data[sizeof(MAGIC)] != VERSION) {
+		cerr << "Error: " << filename << " is not an input recording" << endl;
+		return false;
+	}
+
+	RecordingReader reader(data);
+	for (size_t i = 0; i <= sizeof(MAGIC); ++i)
+		reader.readByte();
+	int64_t numPrefixes = reader.readVarint();
+	for (int64_t i = 0; i < numPrefixes && reader.ok(); ++i)
+		m_prefixes.push_back(reader.readText());
+	m_width = (int) reader.readVarint();
+	m_height = (int) reader.readVarint();
+	if (!reader.ok()) {
+		cerr << "Error: the header of " << filename << " is truncated" << endl;
+		return false;
+	}
+
+	// A session cut short (e.g. by a crash) keeps the events before the cut
+	double time = 0;
+	while (!reader.atEnd()) {
+		Event event;
+		uint8_t type = reader.readByte();
+		if (type >= NUM_EVENT_TYPES) {
+			cerr << "Warning: unknown event in " << filename << "; ignoring the rest" << endl;
+			break;
+		}
+		event.type = (EventType) type;
+		time += reader.readVarint() * 1e-6;
+		event.time = time;
+
+		switch (event.type) {
+		case SLIDER:
+			event.a = (int) reader.readVarint();
+			event.value = reader.readFloat();
+			break;
+		case MOUSE_PUSH:
+			event.a = (int) reader.readVarint();
+			event.b = (int) reader.readVarint();
+			event.c = (int) reader.readVarint();
+			break;
+		case MOUSE_DRAG:
+		case MOUSE_RELEASE:
+			event.b = (int) reader.readVarint();
+			event.c = (int) reader.readVarint();
+			break;
+		case RESIZE:
+			event.a = (int) reader.readVarint();
+			event.b = (int) reader.readVarint();
+			break;
+		case POSITIONS:
+			for (int64_t i = 0, count = reader.readVarint(); i < count && reader.ok(); ++i) {
+				event.controls.push_back((int) reader.readVarint());
+				event.values.push_back(reader.readFloat());
+			}
+			break;
+		case LOAD_ANIMATION:
+			event.text = reader.readText();
+			break;
+		case PRESENT:
+			break;
+		default:
+			event.a = (int) reader.readVarint();
+			break;
+		}
+
+		if (!reader.ok()) {
+			cerr << "Warning: " << filename << " is truncated after " << m_events.size() << " events" << endl;
+			break;
+		}
+		m_events.push_back(event);
+	}
+	return true;
+}
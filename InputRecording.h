@@ -0,0 +1,86 @@
+#ifndef INPUT_RECORDING_H
+#define INPUT_RECORDING_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// A session of input to the modeler UI, as a compact binary log, so that the
+// same interaction can be replayed headless (see Replay.h) and timed across
+// builds. The log starts with the model prefixes and the window size; then
+// every event holds the microseconds since the previous one, its type and its
+// values as variable-length integers.
+class InputRecording
+{
+public:
+	enum EventType
+	{
+		SLIDER,				// a = control, value
+		MOUSE_PUSH,			// a = Camera::Button, b, c = x, y
+		MOUSE_DRAG,			// b, c = x, y
+		MOUSE_RELEASE,		// b, c = x, y
+		KEY,				// a = key (on release)
+		RESIZE,				// a, b = width, height
+		POSITIONS,			// controls and values of a position file
+		LOAD_ANIMATION,		// text = .anim or .clip file
+		PLAY,				// a = STOP, PLAY_ONCE or PLAY_REPEAT
+		ANIMATION_FRAME,	// a = frame of the animation posed
+		CACHE,				// a = whether skinned frames are cached
+		PIPELINE,			// a = whether the next frame is skinned ahead
+		PRESENT,			// the window drew and swapped a frame
+		NUM_EVENT_TYPES
+	};
+
+	enum { STOP, PLAY_ONCE, PLAY_REPEAT };
+
+	struct Event
+	{
+		double time = 0;	// seconds since the start of the session
+		EventType type = SLIDER;
+		int a = 0, b = 0, c = 0;
+		float value = 0;
+		std::string text;
+		std::vector< int > controls;
+		std::vector< float > values;
+	};
+
+	InputRecording();
+	~InputRecording();
+
+	// Recording: events are appended to filename until stopRecording()
+	bool startRecording( const std::string& filename, const std::vector< std::string >& prefixes, int width,
+		int height );
+	bool recording() const { return m_file != NULL; }
+	void record( EventType type, int a = 0, int b = 0, int c = 0, float value = 0 );
+	void recordText( EventType type, const std::string& text );
+	void recordPositions( const std::vector< int >& controls, const std::vector< float >& values );
+	void stopRecording();
+
+	// Replay: read a whole session; false if it is not a valid recording
+	bool load( const std::string& filename );
+	const std::vector< std::string >& prefixes() const { return m_prefixes; }
+	int width() const { return m_width; }
+	int height() const { return m_height; }
+	const std::vector< Event >& events() const { return m_events; }
+
+	static const char *name( EventType type );
+
+private:
+	// Appends the type and the time of an event to m_buffer
+	void beginEvent( EventType type );
+	void writeVarint( int64_t value );
+	void writeFloat( float value );
+	void writeText( const std::string& text );
+	void flush();
+
+	FILE *m_file;
+	std::vector< uint8_t > m_buffer;
+	int64_t m_startMicros, m_lastMicros;
+
+	std::vector< std::string > m_prefixes;
+	int m_width, m_height;
+	std::vector< Event > m_events;
+};
+
+#endif // INPUT_RECORDING_H
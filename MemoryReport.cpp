@@ -0,0 +1,109 @@
+#include "MemoryReport.h"
+
+#include <cstdio>
+#include <iomanip>
+
+#ifdef WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Bytes as B, KB or MB
+static string formatBytes(size_t bytes)
+{
+	char text[32];
+	if (bytes < 10 * 1024)
+		snprintf(text, sizeof(text), "%zu B", bytes);
+	else if (bytes < 10 * 1024 * 1024)
+		snprintf(text, sizeof(text), "%.1f KB", bytes / 1024.0);
+	else
+		snprintf(text, sizeof(text), "%.1f MB", bytes / (1024.0 * 1024.0));
+	return text;
+}
+
+void MemoryReport::begin(const string &owner)
+{
+	m_owner = owner;
+}
+
+void MemoryReport::add(const string &buffer, size_t bytes, size_t allocations)
+{
+	for (Row &row : m_rows)
+		if (row.owner == m_owner && row.buffer == buffer) {
+			row.bytes += bytes;
+			row.allocations += allocations;
+			return;
+		}
+	Row row = { m_owner, buffer, bytes, allocations };
+	m_rows.push_back(row);
+}
+
+size_t MemoryReport::totalBytes() const
+{
+	size_t total = 0;
+	for (const Row &row : m_rows)
+		total += row.bytes;
+	return total;
+}
+
+void MemoryReport::print(ostream &out) const
+{
+	out << left << setw(32) << "Buffer" << right << setw(12) << "Bytes" << setw(14) << "Allocations" << endl;
+	size_t totalAllocations = 0;
+	for (size_t i = 0; i < m_rows.size(); ) {
+		const string &owner = m_rows[i].owner;
+		out << owner << endl;
+		size_t bytes = 0, allocations = 0;
+		for (; i < m_rows.size() && m_rows[i].owner == owner; ++i) {
+			const Row &row = m_rows[i];
+			out << "  " << left << setw(30) << row.buffer << right << setw(12) << formatBytes(row.bytes)
+				<< setw(14) << row.allocations << endl;
+			bytes += row.bytes;
+			allocations += row.allocations;
+		}
+		out << "  " << left << setw(30) << "total" << right << setw(12) << formatBytes(bytes) << setw(14)
+			<< allocations << endl;
+		totalAllocations += allocations;
+	}
+	out << left << setw(32) << "All" << right << setw(12) << formatBytes(totalBytes()) << setw(14)
+		<< totalAllocations << endl;
+
+	size_t resident = residentBytes(), peak = peakResidentBytes();
+	if (resident > 0 || peak > 0)
+		out << "Process resident: " << formatBytes(resident) << ", peak " << formatBytes(peak) << endl;
+}
+
+size_t MemoryReport::residentBytes()
+{
+#ifdef WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.WorkingSetSize : 0;
+#else
+	// The second field of statm is the resident size in pages
+	size_t pages = 0, residentPages = 0;
+	FILE *statm = fopen("/proc/self/statm", "r");
+	if (!statm)
+		return 0;
+	int read = fscanf(statm, "%zu %zu", &pages, &residentPages);
+	fclose(statm);
+	return read == 2 ? residentPages * (size_t) sysconf(_SC_PAGESIZE) : 0;
+#endif
+}
+
+size_t MemoryReport::peakResidentBytes()
+{
+#ifdef WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.PeakWorkingSetSize : 0;
+#else
+	// Kilobytes on Linux
+	struct rusage usage;
+	return getrusage(RUSAGE_SELF, &usage) == 0 ? (size_t) usage.ru_maxrss * 1024 : 0;
+#endif
+}
@@ -0,0 +1,62 @@
+#ifndef MEMORY_REPORT_H
+#define MEMORY_REPORT_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Bytes held in memory by owner (a model or a subsystem such as a cache) and
+// by buffer, with the number of heap allocations behind them, e.g. one per
+// vertex for the rows of Mesh::attachments. Owners add their buffers; the
+// report prints them with the resident and peak resident size of the process.
+class MemoryReport
+{
+public:
+	// The buffers added from now on belong to owner
+	void begin( const std::string& owner );
+
+	// Buffers of the same name are summed
+	void add( const std::string& buffer, size_t bytes, size_t allocations );
+
+	template< typename T >
+	void add( const std::string& buffer, const std::vector< T >& v )
+	{
+		add( buffer, v.capacity() * sizeof( T ), v.capacity() > 0 );
+	}
+
+	// A vector of vectors: the outer array and every row
+	template< typename T >
+	void add( const std::string& buffer, const std::vector< std::vector< T > >& rows )
+	{
+		add( buffer, rows.capacity() * sizeof( std::vector< T > ), rows.capacity() > 0 );
+		for( const std::vector< T >& row : rows )
+			add( buffer, row );
+	}
+
+	// Bits, not bools
+	void add( const std::string& buffer, const std::vector< bool >& v )
+	{
+		add( buffer, ( v.capacity() + 7 ) / 8, v.capacity() > 0 );
+	}
+
+	size_t totalBytes() const;
+
+	// One line per buffer, a total per owner, then the totals of the process
+	void print( std::ostream& out ) const;
+
+	// Resident set size of the process, now and at its peak; 0 where unknown
+	static size_t residentBytes();
+	static size_t peakResidentBytes();
+
+private:
+	struct Row
+	{
+		std::string owner, buffer;
+		size_t bytes, allocations;
+	};
+	std::vector< Row > m_rows;
+	std::string m_owner;
+};
+
+#endif // MEMORY_REPORT_H
@@ -1,4 +1,5 @@
 #include "Mesh.h"
+#include "Trace.h"
 
 using namespace std;
 
@@ -28,6 +29,7 @@ static const Vector3f jointColorMapping[] = {
 void Mesh::load( const char* filename )
 {
 	// 2.1.1. load() should populate bindVertices, currentVertices, and faces
+	TraceSpan span("load mesh", filename);
 
 	ifstream file(filename);
 	string action, value;
@@ -56,12 +58,44 @@ void Mesh::load( const char* filename )
 
 	// Make a copy of the bind vertices as the current vertices
 	currentVertices = bindVertices;
+	updateNormals();
+}
+
+void Mesh::updateNormals()
+{
+	computeNormals(currentVertices, currentNormals);
+}
+
+void Mesh::computeNormals(const vector<Vector3f> &vertices, vector<Vector3f> &normals) const
+{
+	normals.resize(faces.size());
+	if (!faces.empty())
+		computeNormals(vertices[0], sizeof(Vector3f), normals[0], sizeof(Vector3f));
+}
+
+void Mesh::computeNormals(const float *vertices, size_t vertexStride, float *normals, size_t normalStride) const
+{
+	auto vertex = [&](unsigned index) {
+		const float *v = (const float *) ((const char *) vertices + (index - 1) * vertexStride);
+		return Vector3f(v[0], v[1], v[2]);
+	};
+	for (int i = 0, numFaces = faces.size(); i < numFaces; ++i) {
+		Vector3f vx = vertex(faces[i][0]),
+			vy = vertex(faces[i][1]),
+			vz = vertex(faces[i][2]);
+		Vector3f normal = Vector3f::cross(vy - vx, vz - vx).normalized();
+		float *out = (float *) ((char *) normals + i * normalStride);
+		out[0] = normal[0];
+		out[1] = normal[1];
+		out[2] = normal[2];
+	}
 }
 
 void Mesh::loadAttachments( const char* filename, int numJoints )
 {
 	// 2.2. Implement this method to load the per-vertex attachment weights
 	// this method should update m_mesh.attachments
+	TraceSpan span("load attachments", filename);
 
 	ifstream file(filename);
 	float weight;
@@ -114,36 +148,12 @@ void Mesh::loadAttachments( const char* filename, int numJoints )
 	}
 }
 
-void Mesh::draw()
+void Mesh::reportMemory( MemoryReport& report ) const
 {
-	// Since these meshes don't have normals
-	// be sure to generate a normal per triangle.
-	// Notice that since we have per-triangle normals
-	// rather than the analytical normals from
-	// assignment 1, the appearance is "faceted".
-	glColorMaterial(GL_FRONT_AND_BACK, GL_DIFFUSE);
-
-	glBegin(GL_TRIANGLES);
-	for (int i = 0, numFaces = faces.size(); i < numFaces; ++i) {
-		int ix = faces[i][0] - 1,
-			iy = faces[i][1] - 1,
-			iz = faces[i][2] - 1;
-		Vector3f vx = currentVertices[ix],
-			vy = currentVertices[iy],
-			vz = currentVertices[iz],
-			cx = vertexColors[ix],
-			cy = vertexColors[iy],
-			cz = vertexColors[iz];
-
-		Vector3f normal = Vector3f::cross(vy - vx, vz - vx).normalized();
-
-		glNormal3f(normal[0], normal[1], normal[2]);
-		glColor3f(cx[0], cx[1], cx[2]);
-		glVertex3f(vx[0], vx[1], vx[2]);
-		glColor3f(cy[0], cy[1], cy[2]);
-		glVertex3f(vy[0], vy[1], vy[2]);
-		glColor3f(cz[0], cz[1], cz[2]);
-		glVertex3f(vz[0], vz[1], vz[2]);
-	}
-	glEnd();
+	report.add( "bindVertices", bindVertices );
+	report.add( "currentVertices", currentVertices );
+	report.add( "currentNormals", currentNormals );
+	report.add( "faces", faces );
+	report.add( "attachments", attachments );
+	report.add( "vertexColors", vertexColors );
 }
@@ -7,12 +7,8 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
-#ifdef WIN32
-#include "GL/freeglut.h"
-#else
-#include <GL/glut.h>
-#endif
 #include "tuple.h"
+#include "MemoryReport.h"
 
 typedef tuple< unsigned, 3 > Tuple3u;
 
@@ -29,6 +25,9 @@ struct Mesh
 	// current vertex positions after animation
 	std::vector< Vector3f > currentVertices;
 
+	// Extra: unit normal of every face of the current vertices
+	std::vector< Vector3f > currentNormals;
+
 	// list of vertex to joint attachments
 	// each element of attachments is a vector< float > containing
 	// one attachment weight per joint
@@ -40,12 +39,19 @@ struct Mesh
 	// 2.1.1. load() should populate bindVertices, currentVertices, and faces
 	void load(const char *filename);
 
-	// 2.1.2. draw the current mesh.
-	void draw();
+	// Extra: recompute currentNormals after currentVertices changed
+	void updateNormals();
+	// Extra: the face normals of any vertex positions of this mesh
+	void computeNormals( const std::vector< Vector3f >& vertices, std::vector< Vector3f >& normals ) const;
+	// Extra: the same from and into caller buffers of 3 floats per element, stride bytes apart
+	void computeNormals( const float* vertices, size_t vertexStride, float* normals, size_t normalStride ) const;
 
 	// 2.2. Implement this method to load the per-vertex attachment weights
 	// this method should update m_mesh.attachments
 	void loadAttachments( const char* filename, int numJoints );
+
+	// Extra: add the bytes of every buffer to report
+	void reportMemory( MemoryReport& report ) const;
 };
 
 #endif
@@ -1,24 +1,34 @@
 #include "ModelerView.h"
 #include "camera.h"
 #include "modelerapp.h"
+#include "Trace.h"
 
 #include <FL/Fl.H>
 #include <FL/Fl_Gl_Window.H>
 #include <FL/gl.h>
 #include <GL/glu.h>
+#ifdef WIN32
+#include "GL/freeglut.h"
+#else
+#include <GL/glut.h>
+#endif
 #include <cstdio>
 
 ModelerView::ModelerView(int x, int y, int w, int h,
              const char *label):Fl_Gl_Window(x, y, w, h, label)
 {
-    m_camera = new Camera();
-
-    m_camera->SetDimensions( w, h );
-    m_camera->SetDistance( 2 );
-    m_camera->SetCenter( Vector3f( 0.5, 0.5, 0.5 ) );
+    Camera &camera = m_state.camera;
+    camera.SetDimensions( w, h );
+    // Same as SceneRenderer::setup(), so that update() can cull before the first draw()
+    camera.SetViewport( 0, 0, w, h );
+    camera.SetPerspective( 50.0f );
+    camera.SetDistance( 2 );
+    camera.SetCenter( Vector3f( 0.5, 0.5, 0.5 ) );
 
     m_drawAxes = true;
-    m_drawSkeleton = false;
+    m_drawTimings = false;
+
+    m_scene.setTimings( &m_state.timings );
 }
 
 // If you want to load files, etc, do that here.
@@ -28,28 +38,25 @@ void ModelerView::loadModels(int argc, char* argv[])
 
     // Load models based on the command-line arguments
     for (int i = 1; i < argc; ++i) {
-        string prefix = argv[i];
-        string skeletonFile = prefix + ".skel";
-        string meshFile = prefix + ".obj";
-        string attachmentsFile = prefix + ".attach";
-
         SkeletalModel model = SkeletalModel();
-        model.load(skeletonFile.c_str(), meshFile.c_str(), attachmentsFile.c_str());
-        models.push_back(model);
+        model.load(argv[i]);
+        cout << "Read joints: " << model.getJoints().size() << endl;
+        m_state.models.push_back(model);
+        m_modelNames.push_back(argv[i]);
     }
+    printMemoryReport();
 }
 
-vector<vector<Joint*>> ModelerView::getJointsPerModel()
-{
-    auto nums = vector<vector<Joint*>>();
-    for (auto &model : models)
-        nums.push_back(model.getJoints());
-    return nums;
-}
-
-ModelerView::~ModelerView()
+void ModelerView::printMemoryReport()
 {
-    delete m_camera;
+    MemoryReport report;
+    m_state.reportMemory(report, m_modelNames);
+    report.begin("Instrumentation");
+    m_state.timings.reportMemory(report);
+    m_latency.reportMemory(report);
+
+    cout << "Memory:" << endl;
+    report.print(cout);
 }
 
 int ModelerView::handle( int event )
@@ -59,6 +66,27 @@ int ModelerView::handle( int event )
     unsigned eventButton = Fl::event_button();
     unsigned eventState  = Fl::event_state();
 
+    // Input that changes the view, timed until the frame that shows it
+    if( event == FL_PUSH || event == FL_DRAG || event == FL_RELEASE )
+        m_latency.eventReceived( InputLatency::CAMERA );
+    else if( event == FL_KEYUP )
+        m_latency.eventReceived( InputLatency::KEY );
+
+    // The camera sees the same events when replayed
+    if( event == FL_PUSH )
+    {
+        Camera::Button button = eventButton == FL_LEFT_MOUSE ? Camera::LEFT : eventButton == FL_MIDDLE_MOUSE
+            ? Camera::MIDDLE : eventButton == FL_RIGHT_MOUSE ? Camera::RIGHT : Camera::NONE;
+        if( button != Camera::NONE )
+            m_recording.record( InputRecording::MOUSE_PUSH, button, eventCoordX, eventCoordY );
+    }
+    else if( event == FL_DRAG )
+        m_recording.record( InputRecording::MOUSE_DRAG, 0, eventCoordX, eventCoordY );
+    else if( event == FL_RELEASE )
+        m_recording.record( InputRecording::MOUSE_RELEASE, 0, eventCoordX, eventCoordY );
+    else if( event == FL_KEYUP )
+        m_recording.record( InputRecording::KEY, Fl::event_key() );
+
     switch( event )
     {
     case FL_PUSH:
@@ -66,15 +94,15 @@ int ModelerView::handle( int event )
             switch (eventButton)
             {
                 case FL_LEFT_MOUSE:
-                    m_camera->MouseClick( Camera::LEFT, eventCoordX, eventCoordY );
+                    m_state.camera.MouseClick( Camera::LEFT, eventCoordX, eventCoordY );
                     break;
 
                 case FL_MIDDLE_MOUSE:
-                    m_camera->MouseClick( Camera::MIDDLE, eventCoordX, eventCoordY );
+                    m_state.camera.MouseClick( Camera::MIDDLE, eventCoordX, eventCoordY );
                     break;
 
                 case FL_RIGHT_MOUSE:
-                    m_camera->MouseClick( Camera::RIGHT, eventCoordX, eventCoordY );
+                    m_state.camera.MouseClick( Camera::RIGHT, eventCoordX, eventCoordY );
                     break;
             }
         }
@@ -82,13 +110,13 @@ int ModelerView::handle( int event )
 
     case FL_DRAG:
         {
-            m_camera->MouseDrag(eventCoordX, eventCoordY);
+            m_state.camera.MouseDrag(eventCoordX, eventCoordY);
         }
         break;
 
     case FL_RELEASE:
         {
-            m_camera->MouseRelease(eventCoordX, eventCoordY);
+            m_state.camera.MouseRelease(eventCoordX, eventCoordY);
         }
         break;
 
@@ -104,7 +132,7 @@ int ModelerView::handle( int event )
             // added the color trigger
             else if (key == 'c')
             {
-                if (m_drawSkeleton == 0) {
+                if (m_state.drawSkeleton == 0) {
                     m_drawColor = !m_drawColor;
                     if (m_drawColor) {
                         glEnable(GL_COLOR_MATERIAL);
@@ -117,11 +145,24 @@ int ModelerView::handle( int event )
                     glDisable(GL_COLOR_MATERIAL);
                 }
             }
+            else if (key == 't')
+            {
+                m_drawTimings = !m_drawTimings;
+                cout << "drawTimings is now: " << m_drawTimings << endl;
+            }
+            else if (key == 'l')
+            {
+                m_latency.printReport(cout);
+            }
+            else if (key == 'm')
+            {
+                printMemoryReport();
+            }
             else if (key == 's')
             {
-                m_drawSkeleton = !m_drawSkeleton;
-                cout << "drawSkeleton is now: " << m_drawSkeleton << endl;
-                if (m_drawSkeleton == 0) {
+                m_state.drawSkeleton = !m_state.drawSkeleton;
+                cout << "drawSkeleton is now: " << m_state.drawSkeleton << endl;
+                if (m_state.drawSkeleton == 0) {
                     if (m_drawColor) {
                         glEnable(GL_COLOR_MATERIAL);
                     }
@@ -147,36 +188,14 @@ int ModelerView::handle( int event )
 
 void ModelerView::update()
 {
-    // update the skeleton from sliders
-    updateJoints();
-
-    for (auto &model : models) {
-        // Update the bone to world transforms for SSD.
-        model.updateCurrentJointToWorldTransforms();
-
-        // update the mesh given the new skeleton
-        model.updateMesh();
-    }
+    m_state.update();
+    m_latency.updated();
 }
 
-void ModelerView::updateJoints()
+void ModelerView::updateFrame(unsigned frame)
 {
-    auto app = ModelerApplication::Instance();
-
-    // Iterate each model
-    for (int modelIndex = 0, numModels = models.size(); modelIndex < numModels; ++modelIndex) {
-        auto &model = models[modelIndex];
-        // Set translation of root joint
-        Vector3f ret = app->getJointToControlValues(modelIndex, 0, true);
-        model.setRootTranslation(ret[0], ret[1], ret[2]);
-
-        // Set transform (currently rotation only) of all joints
-        for (int jointIndex = 0, numJoints = model.getJoints().size(); jointIndex < numJoints; jointIndex++)
-        {
-            ret = app->getJointToControlValues(modelIndex, jointIndex, false);
-            model.setJointTransform(jointIndex, ret[0], ret[1], ret[2]);
-        }
-    }
+    m_state.updateFrame(frame);
+    m_latency.updated();
 }
 
 // Call the draw function of the parent.  This sets up the
@@ -184,77 +203,154 @@ void ModelerView::updateJoints()
 // default lighting parameters.
 void ModelerView::draw()
 {
+    // Submission only: the buffers are swapped after draw() returns
+    TraceSpan span("draw");
+
+    // Display lists do not survive a new GL context
+    if( !context_valid() )
+    {
+        m_scene.invalidate();
+    }
+
     // Window is !valid() upon resize
     // FLTK convention has you initializing rendering here.
     if( !valid() )
     {
-        // Setup opengl
-        glShadeModel( GL_SMOOTH );
-        glEnable( GL_DEPTH_TEST );
-        glEnable( GL_LIGHTING );
-        glEnable( GL_LIGHT0 );
-        glEnable( GL_NORMALIZE );
-
-        m_camera->SetDimensions(w(),h());
-        m_camera->SetViewport(0,0,w(),h());
-        m_camera->ApplyViewport();
-
-        glMatrixMode( GL_PROJECTION );
-        glLoadIdentity();
-        m_camera->SetPerspective( 50.0f );
-        glLoadMatrixf( m_camera->projectionMatrix() );
+        m_scene.setup( m_state.camera, w(), h() );
     }
 
-    glMatrixMode( GL_MODELVIEW );
-    glLoadIdentity();
+    {
+        ScopedPhaseTimer timer( &m_state.timings, PhaseTimings::DRAW );
+        m_latency.drawStarted();
+        m_scene.draw( m_state.camera, m_state.models, m_drawAxes, m_state.drawSkeleton );
+    }
+
+    // Queue the frame for capture before it gets swapped to the front buffer
+    if( m_capture.active() )
+    {
+        glReadBuffer( GL_BACK );
+        m_capture.capture( w(), h() );
+    }
 
-    glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+    // The overlay is not captured, and shows the frames before this one
+    if( m_drawTimings )
+        drawTimings();
+    m_state.timings.endFrame();
+    m_latency.drawSubmitted();
+}
 
-    // Note that the lighting is applied *before* applying the camera
-    // transform.  This is so the light appeared fixed on the camera.
-    GLfloat Lt0diff[] = {1.0,1.0,1.0,1.0};
-    GLfloat Lt0pos[] = {3.0,3.0,5.0,1.0};
-    glLightfv(GL_LIGHT0, GL_DIFFUSE, Lt0diff);
-    glLightfv(GL_LIGHT0, GL_POSITION, Lt0pos);
+void ModelerView::flush()
+{
+    Fl_Gl_Window::flush();
+    m_latency.presented();
+    m_recording.record( InputRecording::PRESENT );
+}
 
-    // These are just some default material colors
-    GLfloat diffColor[] = {0.4f, 0.4f, 0.4f, 1.f};
-    GLfloat specColor[] = {0.6f, 0.6f, 0.6f, 1.f};
-    GLfloat shininess[] = {50.0f};
+void ModelerView::resize(int x, int y, int w, int h)
+{
+    Fl_Gl_Window::resize( x, y, w, h );
+    m_recording.record( InputRecording::RESIZE, w, h );
+}
 
-    glMaterialfv( GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE, diffColor );
-    glMaterialfv( GL_FRONT_AND_BACK, GL_SPECULAR, specColor );
-    glMaterialfv( GL_FRONT_AND_BACK, GL_SHININESS, shininess );
+bool ModelerView::startRecording(const string &filename)
+{
+    if( !m_recording.startRecording( filename, m_modelNames, w(), h() ) )
+        return false;
+    cout << "Recording input to " << filename << endl;
+    return true;
+}
 
-    // Load the camera view matrix
-    glLoadMatrixf( m_camera->viewMatrix() );
+void ModelerView::drawTimings()
+{
+    // Statistics of about the last 4 seconds at 60 frames per second
+    const size_t numFrames = 240;
+    const int lineHeight = 14;
 
-    if(m_drawAxes)
+    // Text in window pixels, over the scene
+    glPushAttrib( GL_ENABLE_BIT | GL_CURRENT_BIT );
+    glDisable( GL_LIGHTING );
+    glDisable( GL_DEPTH_TEST );
+    glMatrixMode( GL_PROJECTION );
+    glPushMatrix();
+    glLoadIdentity();
+    gluOrtho2D( 0, w(), 0, h() );
+    glMatrixMode( GL_MODELVIEW );
+    glPushMatrix();
+    glLoadIdentity();
+
+    gl_font( FL_COURIER, 12 );
+    glColor3f( 1, 1, 0 );
+    char line[128];
+    int y = h() - lineHeight;
+    snprintf( line, sizeof( line ), "%-18s %7s %7s %7s %7s  (ms, %u frames)", "phase", "avg", "p50", "p95", "p99",
+        (unsigned) min( numFrames, m_state.timings.numFrames() ) );
+    gl_draw( line, 8, y );
+    for( int phase = 0; phase < PhaseTimings::NUM_PHASES; ++phase )
+    {
+        PhaseTimings::Summary s = m_state.timings.summarize( (PhaseTimings::Phase) phase, numFrames );
+        snprintf( line, sizeof( line ), "%-18s %7.2f %7.2f %7.2f %7.2f", PhaseTimings::name( (PhaseTimings::Phase) phase ),
+            s.mean, s.p50, s.p95, s.p99 );
+        y -= lineHeight;
+        gl_draw( line, 8, y );
+    }
+    PhaseTimings::Summary latency = m_latency.summarize( numFrames );
+    if( latency.frames > 0 )
     {
-        drawAxes();
+        snprintf( line, sizeof( line ), "%-18s %7.2f %7.2f %7.2f %7.2f  (%u events)", "input to present",
+            latency.mean, latency.p50, latency.p95, latency.p99, (unsigned) latency.frames );
+        y -= lineHeight;
+        gl_draw( line, 8, y );
     }
 
-    for (auto &model : models)
-        model.draw( m_camera->viewMatrix(), m_drawSkeleton );
+    glPopMatrix();
+    glMatrixMode( GL_PROJECTION );
+    glPopMatrix();
+    glMatrixMode( GL_MODELVIEW );
+    glPopAttrib();
 }
 
-void ModelerView::drawAxes()
+void ModelerView::saveOnExit()
 {
-    glDisable( GL_LIGHTING );
-    glBegin( GL_LINES );
+    stopCapture();
+    saveTimings();
+    saveLatency();
+    m_recording.stopRecording();
+}
 
-    glColor3f( 1, 0, 0 );
-    glVertex3f( 0, 0, 0 );
-    glVertex3f( 1, 0, 0 );
+void ModelerView::saveTimings()
+{
+    if( m_timingsFile.empty() || m_state.timings.numFrames() == 0 )
+        return;
 
-    glColor3f( 0, 1, 0 );
-    glVertex3f( 0, 0, 0 );
-    glVertex3f( 0, 1, 0 );
+    if( m_state.timings.writeCsv( m_timingsFile ) )
+        cout << "Wrote the phase timings of " << m_state.timings.numFrames() << " frames to " << m_timingsFile << endl;
+    else
+        cerr << "Error: couldn't write " << m_timingsFile << endl;
+}
 
-    glColor3f( 0, 0, 1 );
-    glVertex3f( 0, 0, 0 );
-    glVertex3f( 0, 0, 1 );
+void ModelerView::saveLatency()
+{
+    if( m_latencyFile.empty() || m_latency.numEvents() == 0 )
+        return;
+
+    m_latency.printReport( cout );
+    if( m_latency.writeCsv( m_latencyFile ) )
+        cout << "Wrote the latency of " << m_latency.numEvents() << " input events to " << m_latencyFile << endl;
+    else
+        cerr << "Error: couldn't write " << m_latencyFile << endl;
+}
+
+bool ModelerView::startCapture(const string &path, unsigned fps)
+{
+    return m_capture.start( path, FrameCapture::formatFromPath( path ), fps );
+}
+
+void ModelerView::stopCapture()
+{
+    if( !m_capture.active() )
+        return;
 
-    glEnd();
-    glEnable( GL_LIGHTING );
+    // The frames still being read back need the GL context
+    make_current();
+    m_capture.stop();
 }
@@ -14,10 +14,14 @@
 #include <FL/Fl_Gl_Window.H>
 #include <GL/gl.h>
 
-class Camera;
 class ModelerView;
 
 #include "SkeletalModel.h"
+#include "SceneRenderer.h"
+#include "FrameCapture.h"
+#include "ViewState.h"
+#include "InputLatency.h"
+#include "InputRecording.h"
 
 using namespace std;
 
@@ -28,24 +32,67 @@ public:
     ModelerView(int x, int y, int w, int h, const char *label = 0);
 
     void loadModels(int argc, char* argv[]);
-    vector<vector<Joint*>> getJointsPerModel();
 
-    virtual ~ModelerView ();
+    // Print the bytes held by every model and cache, and the peak resident size
+    void printMemoryReport();
 
     virtual int handle(int event);
+    // ViewState::update() and updateFrame(), which end the update of the pending input (see InputLatency)
     virtual void update();
+    void updateFrame(unsigned frame);
     virtual void draw();
+    // Swaps the buffers after draw(), which presents the input drawn
+    virtual void flush();
+    virtual void resize(int x, int y, int w, int h);
 
-    void updateJoints();
-    void drawAxes();
+    // The models, the camera, the vertex cache and the skinning pipeline,
+    // updated the same way by replay and headless rendering
+    ViewState &state() { return m_state; }
 
-    Camera *m_camera;
-    vector<SkeletalModel> models;
+    // Capture every frame drawn from now on (see FrameCapture)
+    bool startCapture(const string &path, unsigned fps);
+    void stopCapture();
+
+    // Write the statistics of the phase timings to filename on exit
+    void setTimingsFile(const string &filename) { m_timingsFile = filename; }
+    void saveTimings();
+
+    // Latency of input to the window and its sliders, written to filename on exit
+    InputLatency &latency() { return m_latency; }
+    void setLatencyFile(const string &filename) { m_latencyFile = filename; }
+    void saveLatency();
+
+    // Input to the window and the controls, recorded for replay (see Replay.h)
+    InputRecording &recording() { return m_recording; }
+    bool startRecording(const string &filename);
+
+    // On exit: finish the capture and the recording, and write the timings and latency files
+    void saveOnExit();
+
+    vector<string> m_modelNames;
 
     bool m_drawAxes;
-    bool m_drawSkeleton;		// if false, the mesh is drawn instead.
 
     bool m_drawColor;   // coloring Joints
+
+    bool m_drawTimings;     // the phase timings overlay
+
+private:
+    // Its timings hold the time per frame of updating and drawing, shown by drawTimings()
+    ViewState m_state;
+
+    // GL drawing of the models, shared with the headless renderer
+    SceneRenderer m_scene;
+
+    FrameCapture m_capture;
+
+    string m_timingsFile;
+    void drawTimings();
+
+    InputLatency m_latency;
+    string m_latencyFile;
+
+    InputRecording m_recording;
 };
 
 
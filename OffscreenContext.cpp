@@ -0,0 +1,111 @@
+#include "OffscreenContext.h"
+
+#include <iostream>
+
+#ifndef WIN32
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+using namespace std;
+
+OffscreenContext::OffscreenContext()
+	: m_display(NULL), m_surface(NULL), m_context(NULL)
+{
+}
+
+OffscreenContext::~OffscreenContext()
+{
+	destroy();
+}
+
+#ifdef WIN32
+
+bool OffscreenContext::create(int w, int h)
+{
+	cerr << "Error: offscreen rendering requires EGL, which is not available on this platform" << endl;
+	return false;
+}
+
+void OffscreenContext::destroy()
+{
+}
+
+#else
+
+static EGLDisplay openDisplay()
+{
+	// Prefer the default display, fall back to a surfaceless one (no X server)
+	EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL))
+		return display;
+
+	auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay) {
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+		if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL))
+			return display;
+	}
+	return EGL_NO_DISPLAY;
+}
+
+bool OffscreenContext::create(int w, int h)
+{
+	destroy();
+
+	EGLDisplay display = openDisplay();
+	if (display == EGL_NO_DISPLAY) {
+		cerr << "Error: couldn't open an EGL display" << endl;
+		return false;
+	}
+	m_display = display;
+
+	const EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_DEPTH_SIZE, 24,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint numConfigs = 0;
+	if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0) {
+		cerr << "Error: no EGL config supports desktop GL pbuffers" << endl;
+		destroy();
+		return false;
+	}
+
+	const EGLint surfaceAttribs[] = { EGL_WIDTH, w, EGL_HEIGHT, h, EGL_NONE };
+	m_surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+
+	// The drawing code uses the fixed-function pipeline, so ask for a compatibility context
+	eglBindAPI(EGL_OPENGL_API);
+	m_context = eglCreateContext(display, config, EGL_NO_CONTEXT, NULL);
+
+	if (m_surface == EGL_NO_SURFACE || m_context == EGL_NO_CONTEXT
+		|| !eglMakeCurrent(display, m_surface, m_surface, m_context)) {
+		cerr << "Error: couldn't create an offscreen GL context (EGL error 0x" << hex << eglGetError() << dec << ")" << endl;
+		destroy();
+		return false;
+	}
+	return true;
+}
+
+void OffscreenContext::destroy()
+{
+	if (!m_display)
+		return;
+
+	eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (m_context && m_context != EGL_NO_CONTEXT)
+		eglDestroyContext(m_display, m_context);
+	if (m_surface && m_surface != EGL_NO_SURFACE)
+		eglDestroySurface(m_display, m_surface);
+	eglTerminate(m_display);
+
+	m_display = m_surface = m_context = NULL;
+}
+
+#endif
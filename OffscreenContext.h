@@ -0,0 +1,23 @@
+#ifndef OFFSCREEN_CONTEXT_H
+#define OFFSCREEN_CONTEXT_H
+
+// A GL context rendering into an offscreen EGL pbuffer, without any window
+// or display server. Used by the headless renderer.
+class OffscreenContext
+{
+public:
+	OffscreenContext();
+	~OffscreenContext();
+
+	// Create a w x h RGB framebuffer with a depth buffer and make it current.
+	// Returns false (and prints the reason) if no offscreen context is available.
+	bool create(int w, int h);
+	void destroy();
+
+private:
+	void *m_display;
+	void *m_surface;
+	void *m_context;
+};
+
+#endif // OFFSCREEN_CONTEXT_H
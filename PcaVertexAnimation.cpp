@@ -0,0 +1,333 @@
+#include "PcaVertexAnimation.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PCA_VERTEX_ANIMATION_SSE
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// Rows are copied to and from the vertices as packed floats
+static_assert(sizeof(Vector3f) == 3 * sizeof(float), "Vector3f must be 3 packed floats");
+
+// Floats rebuilt per task, small enough to stay in the L1 cache across all basis rows
+static const size_t FLOATS_PER_CHUNK = 4096;
+
+// Subspace iterations of the basis, and the extra components that speed them up
+static const int SUBSPACE_ITERATIONS = 16;
+static const int OVERSAMPLING = 8;
+
+// Eigenvalues (descending) and eigenvectors (columns of vectors) of the n x n
+// symmetric matrix a, by cyclic Jacobi rotations
+static void symmetricEigen(vector<double> a, int n, vector<double> &values, vector<double> &vectors)
+{
+	vectors.assign(n * n, 0.0);
+	for (int i = 0; i < n; ++i)
+		vectors[i * n + i] = 1;
+
+	for (int sweep = 0; sweep < 64; ++sweep) {
+		double offDiagonal = 0;
+		for (int p = 0; p < n; ++p)
+			for (int q = p + 1; q < n; ++q)
+				offDiagonal += a[p * n + q] * a[p * n + q];
+		if (offDiagonal < 1e-22)
+			break;
+
+		for (int p = 0; p < n; ++p)
+			for (int q = p + 1; q < n; ++q) {
+				double apq = a[p * n + q];
+				if (fabs(apq) < 1e-300)
+					continue;
+				double theta = (a[q * n + q] - a[p * n + p]) / (2 * apq);
+				double t = (theta >= 0 ? 1 : -1) / (fabs(theta) + sqrt(theta * theta + 1));
+				double c = 1 / sqrt(t * t + 1), s = t * c;
+				for (int k = 0; k < n; ++k) {
+					double akp = a[k * n + p], akq = a[k * n + q];
+					a[k * n + p] = c * akp - s * akq;
+					a[k * n + q] = s * akp + c * akq;
+				}
+				for (int k = 0; k < n; ++k) {
+					double apk = a[p * n + k], aqk = a[q * n + k];
+					a[p * n + k] = c * apk - s * aqk;
+					a[q * n + k] = s * apk + c * aqk;
+				}
+				for (int k = 0; k < n; ++k) {
+					double vkp = vectors[k * n + p], vkq = vectors[k * n + q];
+					vectors[k * n + p] = c * vkp - s * vkq;
+					vectors[k * n + q] = s * vkp + c * vkq;
+				}
+			}
+	}
+
+	// Sort by decreasing eigenvalue
+	vector<int> order(n);
+	for (int i = 0; i < n; ++i)
+		order[i] = i;
+	sort(order.begin(), order.end(), [&](int i, int j) { return a[i * n + i] > a[j * n + j]; });
+	vector<double> sorted(n * n);
+	values.resize(n);
+	for (int i = 0; i < n; ++i) {
+		values[i] = a[order[i] * n + order[i]];
+		for (int k = 0; k < n; ++k)
+			sorted[k * n + i] = vectors[k * n + order[i]];
+	}
+	vectors.swap(sorted);
+}
+
+// Make the rows of a (numRows x length) orthonormal, by modified Gram-Schmidt.
+// The rows are nearly parallel after an iteration, so every row is projected
+// out twice to stay orthogonal.
+static void orthonormalizeRows(vector<double> &a, int numRows, size_t length)
+{
+	for (int i = 0; i < numRows; ++i) {
+		double *row = &a[i * length];
+		double before = 0;
+		for (size_t d = 0; d < length; ++d)
+			before += row[d] * row[d];
+		for (int pass = 0; pass < 2; ++pass)
+			for (int j = 0; j < i; ++j) {
+				const double *other = &a[j * length];
+				double dot = 0;
+				for (size_t d = 0; d < length; ++d)
+					dot += row[d] * other[d];
+				for (size_t d = 0; d < length; ++d)
+					row[d] -= dot * other[d];
+			}
+		double norm = 0;
+		for (size_t d = 0; d < length; ++d)
+			norm += row[d] * row[d];
+		// A row in the span of the others (the frames have fewer dimensions) keeps
+		// only rounding noise, relative to its length before projection, and stays 0
+		double scale = norm > before * 1e-24 ? 1 / sqrt(norm) : 0.0;
+		for (size_t d = 0; d < length; ++d)
+			row[d] *= scale;
+	}
+}
+
+// c (rows x cols) = a (rows x length) minus the mean row, times the transpose of
+// b (cols x length). The frames are centered on the fly, so that they are not copied.
+static void multiplyCenteredTransposed(const float *a, const float *mean, const vector<double> &b, int rows, int cols,
+	size_t length, vector<double> &c, ThreadPool *pool)
+{
+	c.assign(rows * cols, 0.0);
+	auto task = [&](int i) {
+		for (int j = 0; j < cols; ++j) {
+			const float *x = &a[i * length];
+			const double *y = &b[j * length];
+			double dot = 0;
+			for (size_t d = 0; d < length; ++d)
+				dot += (double) (x[d] - mean[d]) * y[d];
+			c[i * cols + j] = dot;
+		}
+	};
+	if (pool)
+		pool->parallelFor(rows, task);
+	else
+		for (int i = 0; i < rows; ++i)
+			task(i);
+}
+
+PcaVertexAnimation::PcaVertexAnimation()
+	: m_numFrames(0), m_numVertices(0), m_numComponents(0), m_rmsError(0)
+{
+}
+
+void PcaVertexAnimation::build(const vector<Vector3f> &frames, int numFrames, int numVertices, int maxComponents,
+	float maxRmsError)
+{
+	size_t length = 3 * (size_t) numVertices;
+	m_numFrames = numFrames;
+	m_numVertices = numVertices;
+	m_numComponents = 0;
+	m_rmsError = 0;
+	m_mean.assign(length, 0.f);
+	m_basis.clear();
+	m_weights.clear();
+	if (numFrames == 0 || numVertices == 0)
+		return;
+
+	// The mean frame, which every pass below subtracts from the frames as it reads them
+	const float *data = reinterpret_cast<const float *>(frames.data());
+	vector<double> mean(length, 0.0);
+	for (int f = 0; f < numFrames; ++f)
+		for (size_t d = 0; d < length; ++d)
+			mean[d] += data[f * length + d];
+	for (size_t d = 0; d < length; ++d)
+		m_mean[d] = (float) (mean[d] / numFrames);
+
+	double energy = 0;
+	for (int f = 0; f < numFrames; ++f)
+		for (size_t d = 0; d < length; ++d) {
+			float x = data[f * length + d] - m_mean[d];
+			energy += (double) x * x;
+		}
+
+	// The main components span the frames, so that the work only grows with their number.
+	// Subspace iteration on the covariance, starting from a fixed pseudo-random subspace.
+	// Every iteration squares the ratios of the variances along the rows, so they
+	// are kept in double: in float, the components below 1e-7 of the largest one
+	// (which still matter for small errors) would be lost.
+	int rank = (int) min((size_t) min(maxComponents + OVERSAMPLING, numFrames), length);
+	vector<double> subspace(rank * length);
+	unsigned seed = 12345;
+	for (double &x : subspace) {
+		seed = seed * 1664525u + 1013904223u;
+		x = (seed >> 8) / 8388608.f - 1;
+	}
+
+	ThreadPool pool;
+	vector<double> projections;
+	for (int iteration = 0; iteration < SUBSPACE_ITERATIONS; ++iteration) {
+		orthonormalizeRows(subspace, rank, length);
+		multiplyCenteredTransposed(data, m_mean.data(), subspace, numFrames, rank, length, projections, &pool);
+
+		// subspace = projections^T * centered frames
+		pool.parallelFor(rank, [&](int k) {
+			double *row = &subspace[k * length];
+			fill(row, row + length, 0.0);
+			for (int f = 0; f < numFrames; ++f) {
+				double w = projections[f * rank + k];
+				const float *x = &data[f * length];
+				for (size_t d = 0; d < length; ++d)
+					row[d] += w * (x[d] - m_mean[d]);
+			}
+		});
+	}
+	orthonormalizeRows(subspace, rank, length);
+
+	// Rayleigh-Ritz: the principal directions within the subspace, by decreasing variance
+	multiplyCenteredTransposed(data, m_mean.data(), subspace, numFrames, rank, length, projections, &pool);
+	vector<double> gram(rank * rank, 0.0), variances, rotation;
+	for (int i = 0; i < rank; ++i)
+		for (int j = 0; j < rank; ++j)
+			for (int f = 0; f < numFrames; ++f)
+				gram[i * rank + j] += projections[f * rank + i] * projections[f * rank + j];
+	symmetricEigen(gram, rank, variances, rotation);
+
+	// At most maxComponents, without the components of rounding noise only (all
+	// of them, for a still mesh)
+	int limit = min(maxComponents, rank);
+	while (limit > 0 && variances[limit - 1] <= energy * 1e-12)
+		--limit;
+
+	m_basis.resize(limit * length);
+	pool.parallelFor(limit, [&](int k) {
+		float *basis = &m_basis[k * length];
+		for (size_t d = 0; d < length; ++d) {
+			double x = 0;
+			for (int j = 0; j < rank; ++j)
+				x += rotation[j * rank + k] * subspace[j * length + d];
+			basis[d] = (float) x;
+		}
+	});
+
+	vector<float> weights(numFrames * limit);
+	for (int f = 0; f < numFrames; ++f)
+		for (int k = 0; k < limit; ++k) {
+			double w = 0;
+			for (int j = 0; j < rank; ++j)
+				w += projections[f * rank + j] * rotation[j * rank + k];
+			weights[f * limit + k] = (float) w;
+		}
+
+	// The squared error of every frame rebuilt from its first k components, for
+	// every k, measured by taking the components out of the frame one by one (the
+	// variances left over are too imprecise for small errors). The frames are
+	// split into one range per thread, each with its own residual frame.
+	int numRanges = min(pool.size(), numFrames);
+	vector<vector<double>> rangeErrors(numRanges, vector<double>(limit + 1, 0.0));
+	pool.parallelFor(numRanges, [&](int r) {
+		vector<float> residual(length);
+		vector<double> &errors = rangeErrors[r];
+		for (int f = numFrames * r / numRanges, end = numFrames * (r + 1) / numRanges; f < end; ++f) {
+			const float *x = &data[f * length];
+			double error = 0;
+			for (size_t d = 0; d < length; ++d) {
+				residual[d] = x[d] - m_mean[d];
+				error += (double) residual[d] * residual[d];
+			}
+			errors[0] += error;
+			for (int k = 0; k < limit; ++k) {
+				const float *basis = &m_basis[k * length];
+				float w = weights[f * limit + k];
+				error = 0;
+				for (size_t d = 0; d < length; ++d) {
+					residual[d] -= w * basis[d];
+					error += (double) residual[d] * residual[d];
+				}
+				errors[k + 1] += error;
+			}
+		}
+	});
+
+	// Keep the fewest components within the error
+	double numSamples = (double) numFrames * numVertices;
+	for (m_numComponents = 0;; ++m_numComponents) {
+		double error = 0;
+		for (const vector<double> &errors : rangeErrors)
+			error += errors[m_numComponents];
+		m_rmsError = (float) sqrt(error / numSamples);
+		if (m_numComponents == limit || (maxRmsError > 0 && m_rmsError <= maxRmsError))
+			break;
+	}
+
+	int numComponents = m_numComponents;
+	m_basis.resize(numComponents * length);
+	m_weights.resize(numFrames * numComponents);
+	for (int f = 0; f < numFrames; ++f)
+		for (int k = 0; k < numComponents; ++k)
+			m_weights[f * numComponents + k] = weights[f * limit + k];
+}
+
+size_t PcaVertexAnimation::sizeInBytes() const
+{
+	return (m_mean.size() + m_basis.size() + m_weights.size()) * sizeof(float);
+}
+
+void PcaVertexAnimation::reportMemory(MemoryReport &report) const
+{
+	report.add("mean", m_mean);
+	report.add("basis", m_basis);
+	report.add("weights", m_weights);
+}
+
+void PcaVertexAnimation::reconstructRange(const float *weights, size_t begin, size_t end, float *out) const
+{
+	size_t length = 3 * (size_t) m_numVertices;
+	copy(m_mean.begin() + begin, m_mean.begin() + end, out + begin);
+
+	for (int k = 0; k < m_numComponents; ++k) {
+		const float *basis = &m_basis[k * length];
+		float w = weights[k];
+		size_t i = begin;
+#ifdef PCA_VERTEX_ANIMATION_SSE
+		__m128 w4 = _mm_set1_ps(w);
+		for (; i + 4 <= end; i += 4)
+			_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(w4, _mm_loadu_ps(basis + i))));
+#endif
+		for (; i < end; ++i)
+			out[i] += w * basis[i];
+	}
+}
+
+void PcaVertexAnimation::reconstruct(int frame, vector<Vector3f> &vertices, ThreadPool *pool) const
+{
+	vertices.resize(m_numVertices);
+	if (empty())
+		return;
+
+	const float *weights = m_weights.data() + (size_t) frame * m_numComponents;
+	float *out = reinterpret_cast<float *>(vertices.data());
+	size_t length = 3 * (size_t) m_numVertices;
+	int numChunks = (int) ((length + FLOATS_PER_CHUNK - 1) / FLOATS_PER_CHUNK);
+	if (pool && numChunks > 1)
+		pool->parallelFor(numChunks, [&](int chunk) {
+			size_t begin = (size_t) chunk * FLOATS_PER_CHUNK;
+			reconstructRange(weights, begin, min(begin + FLOATS_PER_CHUNK, length), out);
+		});
+	else
+		reconstructRange(weights, 0, length, out);
+}
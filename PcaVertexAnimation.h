@@ -0,0 +1,58 @@
+#ifndef PCA_VERTEX_ANIMATION_H
+#define PCA_VERTEX_ANIMATION_H
+
+#include <cstddef>
+#include <vector>
+#include <vecmath.h>
+
+#include "MemoryReport.h"
+#include "ThreadPool.h"
+
+// The skinned vertices of every frame of an animation of one mesh, compressed
+// by principal component analysis: a frame is the mean frame plus a weighted
+// sum of a few basis frames, with a handful of weights per frame. Playback
+// rebuilds a frame with one small matrix product (SSE where available,
+// optionally split over threads) instead of skinning, from far less memory
+// than the baked frames.
+class PcaVertexAnimation
+{
+public:
+	PcaVertexAnimation();
+
+	// Compress numFrames frames of numVertices positions (frame after frame).
+	// Keeps at most maxComponents basis frames, and if maxRmsError > 0, only as
+	// many as needed to rebuild the frames within that RMS error per vertex.
+	void build( const std::vector< Vector3f >& frames, int numFrames, int numVertices, int maxComponents,
+		float maxRmsError = 0 );
+
+	bool empty() const { return m_numFrames == 0; }
+	int numFrames() const { return m_numFrames; }
+	int numVertices() const { return m_numVertices; }
+	int numComponents() const { return m_numComponents; }
+
+	// Size of the mean, the basis and the weights
+	size_t sizeInBytes() const;
+
+	void reportMemory( MemoryReport& report ) const;
+
+	// RMS error per vertex over all frames, measured when building
+	float rmsError() const { return m_rmsError; }
+
+	// Rebuild the positions of a frame; resizes vertices to numVertices() the first time only
+	void reconstruct( int frame, std::vector< Vector3f >& vertices, ThreadPool* pool = NULL ) const;
+
+private:
+	// out[i] = mean[i] + sum of weights[k] * basis[k][i], for i in [begin, end)
+	void reconstructRange( const float* weights, size_t begin, size_t end, float* out ) const;
+
+	int m_numFrames;
+	int m_numVertices;
+	int m_numComponents;
+	float m_rmsError;
+
+	std::vector< float > m_mean;		// 3 * numVertices
+	std::vector< float > m_basis;		// numComponents rows of 3 * numVertices
+	std::vector< float > m_weights;		// numFrames rows of numComponents
+};
+
+#endif // PCA_VERTEX_ANIMATION_H
@@ -0,0 +1,86 @@
+#include "PhaseTimings.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+using namespace std;
+
+// Frames kept; the older half is dropped when there are more, so memory stays bounded in long sessions
+static const size_t MAX_FRAMES = 1 << 20;
+
+PhaseTimings::PhaseTimings()
+{
+	fill(m_current, m_current + NUM_PHASES, 0.0);
+}
+
+const char *PhaseTimings::name(Phase phase)
+{
+	static const char *names[NUM_PHASES] = {
+		"update",
+		"joint transforms",
+		"skinning",
+		"cache load",
+		"draw",
+		"mesh draw"
+	};
+	return names[phase];
+}
+
+void PhaseTimings::endFrame()
+{
+	for (int phase = 0; phase < NUM_PHASES; ++phase) {
+		vector<float> &samples = m_samples[phase];
+		if (samples.size() >= MAX_FRAMES)
+			samples.erase(samples.begin(), samples.begin() + MAX_FRAMES / 2);
+		samples.push_back((float) (m_current[phase] * 1e3));
+		m_current[phase] = 0;
+	}
+}
+
+PhaseTimings::Summary PhaseTimings::summarize(Phase phase, size_t lastFrames) const
+{
+	const vector<float> &samples = m_samples[phase];
+	size_t count = lastFrames > 0 ? min(lastFrames, samples.size()) : samples.size();
+	return summarize(vector<float>(samples.end() - count, samples.end()));
+}
+
+PhaseTimings::Summary PhaseTimings::summarize(vector<float> sorted)
+{
+	size_t count = sorted.size();
+	Summary summary = { count, 0, 0, 0, 0, 0 };
+	if (count == 0)
+		return summary;
+
+	sort(sorted.begin(), sorted.end());
+	double total = 0;
+	for (float ms : sorted)
+		total += ms;
+
+	// Nearest-rank percentiles
+	auto percentile = [&](double p) { return sorted[min((size_t) max(ceil(p * count) - 1, 0.0), count - 1)]; };
+	summary.mean = total / count;
+	summary.p50 = percentile(0.5);
+	summary.p95 = percentile(0.95);
+	summary.p99 = percentile(0.99);
+	summary.max = sorted.back();
+	return summary;
+}
+
+void PhaseTimings::reportMemory(MemoryReport &report) const
+{
+	for (const vector<float> &samples : m_samples)
+		report.add("phase timings", samples);
+}
+
+bool PhaseTimings::writeCsv(const string &filename) const
+{
+	ofstream file(filename);
+	file << "phase,frames,mean_ms,p50_ms,p95_ms,p99_ms,max_ms" << endl;
+	for (int phase = 0; phase < NUM_PHASES; ++phase) {
+		Summary s = summarize((Phase) phase);
+		file << name((Phase) phase) << "," << s.frames << "," << s.mean << "," << s.p50 << "," << s.p95 << ","
+			<< s.p99 << "," << s.max << endl;
+	}
+	return file.good();
+}
@@ -0,0 +1,86 @@
+#ifndef PHASE_TIMINGS_H
+#define PHASE_TIMINGS_H
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "MemoryReport.h"
+
+// Time spent per frame in each phase of updating and drawing the models, for
+// the timings overlay of the model window and a CSV summary on exit. Phases
+// are timed by ScopedPhaseTimer, summed over a frame, and recorded as one
+// sample per phase at endFrame().
+class PhaseTimings
+{
+public:
+	// Indented phases run inside the one above them
+	enum Phase
+	{
+		UPDATE,				// posing the models and skinning the visible ones
+		JOINT_TRANSFORMS,	//   updateCurrentJointToWorldTransforms(), including applying the pose
+		SKINNING,			//   updateMesh(), in update or in draw
+		CACHE_LOAD,			//   meshes loaded from the vertex cache
+		DRAW,				// drawing the scene
+		MESH_DRAW,			//   drawing the meshes of the visible models
+		NUM_PHASES
+	};
+
+	struct Summary
+	{
+		size_t frames;
+		double mean, p50, p95, p99, max;	// milliseconds
+	};
+
+	PhaseTimings();
+
+	static const char *name( Phase phase );
+
+	void add( Phase phase, double secs ) { m_current[ phase ] += secs; }
+
+	// Record the time of every phase in the frame, and start the next one
+	void endFrame();
+
+	// Statistics of the last frames (0: every frame recorded)
+	Summary summarize( Phase phase, size_t lastFrames = 0 ) const;
+
+	// Statistics of any samples, in milliseconds
+	static Summary summarize( std::vector< float > samples );
+
+	size_t numFrames() const { return m_samples[ 0 ].size(); }
+
+	void reportMemory( MemoryReport& report ) const;
+
+	// One line per phase with the statistics of every frame; false if the file cannot be written
+	bool writeCsv( const std::string& filename ) const;
+
+private:
+	double m_current[ NUM_PHASES ];
+	std::vector< float > m_samples[ NUM_PHASES ];	// milliseconds per frame
+};
+
+// Adds the time until it goes out of scope to a phase; does nothing without timings
+class ScopedPhaseTimer
+{
+public:
+	ScopedPhaseTimer( PhaseTimings *timings, PhaseTimings::Phase phase )
+		: m_timings( timings ), m_phase( phase )
+	{
+		if( m_timings )
+			m_start = std::chrono::steady_clock::now();
+	}
+
+	~ScopedPhaseTimer()
+	{
+		if( m_timings )
+			m_timings->add( m_phase, std::chrono::duration< double >( std::chrono::steady_clock::now() - m_start ).count() );
+	}
+
+private:
+	PhaseTimings *m_timings;
+	PhaseTimings::Phase m_phase;
+	std::chrono::steady_clock::time_point m_start;
+};
+
+#endif // PHASE_TIMINGS_H
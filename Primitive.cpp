@@ -0,0 +1,63 @@
+#include "Primitive.h"
+
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979f
+#endif
+
+using namespace std;
+
+void buildSphere(float radius, int slices, int stacks, Primitive& out)
+{
+	out.positions.clear();
+	out.normals.clear();
+
+	// Unit sphere point at the given stack (from +z to -z) and slice (around z)
+	auto point = [=](int stack, int slice) {
+		float theta = M_PI * stack / stacks,
+			phi = 2 * M_PI * slice / slices;
+		return Vector3f(sin(theta) * cos(phi), sin(theta) * sin(phi), cos(theta));
+	};
+
+	for (int i = 0; i < stacks; ++i)
+		for (int j = 0; j < slices; ++j) {
+			Vector3f a = point(i, j), b = point(i + 1, j),
+				c = point(i + 1, j + 1), d = point(i, j + 1);
+			// The first and last stack degenerate into fans around the poles
+			Vector3f quad[2][3] = { { a, b, c }, { a, c, d } };
+			for (int t = 0; t < 2; ++t) {
+				if ((t == 0 && i == stacks - 1) || (t == 1 && i == 0))
+					continue;
+				for (int k = 0; k < 3; ++k) {
+					out.normals.push_back(quad[t][k]);
+					out.positions.push_back(radius * quad[t][k]);
+				}
+			}
+		}
+}
+
+void buildCube(float size, Primitive& out)
+{
+	out.positions.clear();
+	out.normals.clear();
+
+	float h = size / 2;
+	for (int axis = 0; axis < 3; ++axis)
+		for (int sign = -1; sign <= 1; sign += 2) {
+			// Face normal, and two tangents completing a right-handed frame
+			Vector3f n(0), u(0), v(0);
+			n[axis] = (float) sign;
+			u[(axis + 1) % 3] = 1;
+			v = Vector3f::cross(n, u);
+
+			Vector3f corners[4] = {
+				h * (n - u - v), h * (n + u - v), h * (n + u + v), h * (n - u + v)
+			};
+			int order[6] = { 0, 1, 2, 0, 2, 3 };
+			for (int k = 0; k < 6; ++k) {
+				out.normals.push_back(n);
+				out.positions.push_back(corners[order[k]]);
+			}
+		}
+}
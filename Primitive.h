@@ -0,0 +1,20 @@
+#ifndef PRIMITIVE_H
+#define PRIMITIVE_H
+
+#include <vector>
+#include <vecmath.h>
+
+// Triangle soup with one normal per vertex
+struct Primitive
+{
+	std::vector< Vector3f > positions;
+	std::vector< Vector3f > normals;
+};
+
+// Same tessellation as glutSolidSphere( radius, slices, stacks )
+void buildSphere( float radius, int slices, int stacks, Primitive& out );
+
+// Same geometry as glutSolidCube( size )
+void buildCube( float size, Primitive& out );
+
+#endif // PRIMITIVE_H
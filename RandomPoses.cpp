@@ -0,0 +1,18 @@
+#include "RandomPoses.h"
+
+#include "SkeletalModel.h"
+
+const float RandomPoses::TRANSLATION_RANGE = 1.f;
+const float RandomPoses::ROTATION_RANGE = 3.14159265f;
+
+RandomPoses::RandomPoses(unsigned seed)
+	: m_random(seed), m_unit(-1.f, 1.f)
+{
+}
+
+void RandomPoses::next(const SkeletalModel &model, float *values)
+{
+	// The first 3 controls translate the root, the others rotate the joints
+	for (int c = 0, numControls = model.getNumControls(); c < numControls; ++c)
+		values[c] = m_unit(m_random) * (c < 3 ? TRANSLATION_RANGE : ROTATION_RANGE);
+}
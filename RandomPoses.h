@@ -0,0 +1,27 @@
+#ifndef RANDOM_POSES_H
+#define RANDOM_POSES_H
+
+#include <random>
+
+class SkeletalModel;
+
+// Seeded random poses within the slider ranges of the modeler UI, so that the
+// benchmark and the skinning check draw the same poses from the same seed
+class RandomPoses
+{
+public:
+	static const float TRANSLATION_RANGE;	// root translation in [-1, 1]
+	static const float ROTATION_RANGE;		// Euler angles in [-pi, pi]
+
+	explicit RandomPoses( unsigned seed );
+
+	// Write model.getNumControls() control values, in the layout of
+	// SkeletalModel::setControlValues()
+	void next( const SkeletalModel& model, float* values );
+
+private:
+	std::mt19937 m_random;
+	std::uniform_real_distribution<float> m_unit;
+};
+
+#endif // RANDOM_POSES_H
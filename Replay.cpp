@@ -0,0 +1,301 @@
+#include "Replay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Animation.h"
+#include "FrameCapture.h"
+#include "InputRecording.h"
+#include "OffscreenContext.h"
+#include "SceneRenderer.h"
+#include "SoftwareRenderer.h"
+#include "Trace.h"
+#include "ViewState.h"
+
+using namespace std;
+
+static void printUsage(const char *program)
+{
+	cout << "Usage: " << program << " --replay FILE [options] [PREFIX1 PREFIX2 ...]" << endl
+		<< "Without models, loads the models the session was recorded with." << endl
+		<< "Options:" << endl
+		<< "  --realtime          replay the events at the times they were recorded (default: as fast as possible)" << endl
+		<< "  --fps N             frames per second animations were played at (default: 30, as the modeler UI)" << endl
+		<< "  --vertex-cache MB   budget of the vertex cache, if the session enabled it (default: 512)" << endl
+		<< "  --out PATTERN       also write the frames, as for --headless" << endl
+		<< "  --software          rasterize on the CPU instead of through OpenGL" << endl
+		<< "  --threads N         threads of the software rasterizer and the pipeline (default: one per core)" << endl
+		<< "  --timings-csv FILE  write the phase timings of every frame, as the model window does" << endl
+		<< "  --trace FILE        write a Chrome trace-event timeline of the replay" << endl;
+}
+
+int runReplay(int argc, char* argv[])
+{
+	if (argc < 3) {
+		printUsage(argv[0]);
+		return -1;
+	}
+	string recordingFile = argv[2], outPattern, timingsFile, traceFile;
+	bool realtime = false, software = false;
+	unsigned fps = 30;
+	size_t cacheBudget = (size_t) 512 << 20;
+	int numThreads = 0;
+	vector<string> prefixes;
+
+	// argv[1] is "--replay" itself, argv[2] the recording
+	for (int i = 3; i < argc; ++i) {
+		string arg = argv[i];
+		int remaining = argc - i - 1;
+		if (arg == "--realtime")
+			realtime = true;
+		else if (arg == "--fps" && remaining >= 1)
+			fps = max(atoi(argv[++i]), 1);
+		else if (arg == "--vertex-cache" && remaining >= 1)
+			cacheBudget = (size_t) (max(atof(argv[++i]), 0.0) * (1 << 20));
+		else if (arg == "--out" && remaining >= 1)
+			outPattern = argv[++i];
+		else if (arg == "--software")
+			software = true;
+		else if (arg == "--threads" && remaining >= 1)
+			numThreads = max(atoi(argv[++i]), 1);
+		else if (arg == "--timings-csv" && remaining >= 1)
+			timingsFile = argv[++i];
+		else if (arg == "--trace" && remaining >= 1)
+			traceFile = argv[++i];
+		else if (arg.compare(0, 2, "--") == 0) {
+			cerr << "Error: unknown or incomplete option " << arg << endl;
+			printUsage(argv[0]);
+			return -1;
+		}
+		else
+			prefixes.push_back(arg);
+	}
+
+	InputRecording recording;
+	if (!recording.load(recordingFile))
+		return -1;
+	if (prefixes.empty())
+		prefixes = recording.prefixes();
+	if (prefixes.empty() || recording.width() <= 0 || recording.height() <= 0) {
+		cerr << "Error: no models or no window size in " << recordingFile << endl;
+		return -1;
+	}
+	if (!traceFile.empty())
+		Trace::start(traceFile);
+
+	// The state of the model window, updated the same way as by ModelerView. The
+	// models are loaded and their controls laid out the same way as in the modeler UI.
+	ViewState view(numThreads);
+	view.models.resize(prefixes.size());
+	vector<int> controlOffsets;
+	vector<bool> controlIsTranslation;
+	for (int m = 0, numModels = view.models.size(); m < numModels; ++m) {
+		view.models[m].load(prefixes[m]);
+		cout << "Read joints: " << view.models[m].getJoints().size() << endl;
+		controlOffsets.push_back(controlIsTranslation.size());
+		for (int c = 0, numControls = view.models[m].getNumControls(); c < numControls; ++c)
+			controlIsTranslation.push_back(c < 3);
+	}
+	int numControls = controlIsTranslation.size();
+	bool drawAxes = true, drawColor = false;
+
+	// Write a slider's control into the pose buffer of its model
+	auto setControl = [&](int controlNumber, float value) {
+		for (int m = view.models.size() - 1; m >= 0; --m)
+			if (controlNumber >= controlOffsets[m]) {
+				int modelControl = controlNumber - controlOffsets[m];
+				if (modelControl < view.models[m].getNumControls()) {
+					view.models[m].setControlValue(modelControl, value);
+					view.controlChanged(m);
+				}
+				return;
+			}
+	};
+
+	// The framebuffer fits the largest size the window had
+	int w = recording.width(), h = recording.height(), maxW = w, maxH = h;
+	for (const InputRecording::Event &event : recording.events())
+		if (event.type == InputRecording::RESIZE) {
+			maxW = max(maxW, event.a);
+			maxH = max(maxH, event.b);
+		}
+
+	// The camera of a new model window
+	view.camera.SetDistance(2);
+	view.camera.SetCenter(Vector3f(0.5, 0.5, 0.5));
+	OffscreenContext context;
+	SceneRenderer scene;
+	SoftwareRenderer softwareScene(numThreads);
+	scene.setTimings(&view.timings);
+	auto setup = [&]() {
+		if (software)
+			softwareScene.setup(view.camera, w, h);
+		else {
+			scene.setup(view.camera, w, h);
+			if (drawColor && !view.drawSkeleton)
+				glEnable(GL_COLOR_MATERIAL);
+			else
+				glDisable(GL_COLOR_MATERIAL);
+		}
+	};
+	if (!software && !context.create(maxW, maxH))
+		return -1;
+	setup();
+
+	FrameCapture capture;
+	if (!outPattern.empty() && !capture.start(outPattern, FrameCapture::formatFromPath(outPattern), fps))
+		return -1;
+
+	unique_ptr<AnimationClip> clip;
+	unsigned numFrames = 0;
+	bool cacheOn = false, pipelineOn = false, repeat = false;
+	vector<float> controls;
+	vector<Quat4f> rotations;
+	auto setupCache = [&]() {
+		view.vertexCache.destroy();
+		if (cacheOn && numFrames > 0 && !view.vertexCache.create(view.models, numFrames, cacheBudget))
+			cout << "Not caching skinned frames: they need "
+				<< VertexCache::requiredBytes(view.models, numFrames) / (1 << 20) << " MB, over the budget" << endl;
+	};
+
+	// Time spent replaying (not waiting for recorded times) from one frame to the next
+	vector<float> frameTimes;
+	double frameSecs = 0, busySecs = 0;
+	size_t numApplied = 0;
+	auto startTime = chrono::steady_clock::now();
+
+	for (const InputRecording::Event &event : recording.events()) {
+		if (realtime)
+			this_thread::sleep_until(startTime + chrono::duration_cast<chrono::steady_clock::duration>(
+				chrono::duration<double>(event.time)));
+		auto eventStart = chrono::steady_clock::now();
+		++numApplied;
+
+		switch (event.type) {
+		case InputRecording::SLIDER:
+			setControl(event.a, event.value);
+			view.update();
+			break;
+		case InputRecording::MOUSE_PUSH:
+			view.camera.MouseClick((Camera::Button) event.a, event.b, event.c);
+			break;
+		case InputRecording::MOUSE_DRAG:
+			view.camera.MouseDrag(event.b, event.c);
+			break;
+		case InputRecording::MOUSE_RELEASE:
+			view.camera.MouseRelease(event.b, event.c);
+			break;
+		case InputRecording::KEY:
+			// The keys of ModelerView::handle() that change the picture
+			if (event.a == 'a')
+				drawAxes = !drawAxes;
+			else if (event.a == 'c' && !view.drawSkeleton)
+				drawColor = !drawColor;
+			else if (event.a == 's')
+				view.drawSkeleton = !view.drawSkeleton;
+			if (!software)
+				setup();
+			break;
+		case InputRecording::RESIZE:
+			w = event.a;
+			h = event.b;
+			setup();
+			break;
+		case InputRecording::POSITIONS:
+			for (size_t i = 0; i < event.controls.size(); ++i)
+				setControl(event.controls[i], event.values[i]);
+			view.update();
+			break;
+		case InputRecording::LOAD_ANIMATION:
+			clip.reset(loadAnimationClip(event.text, controlIsTranslation));
+			if (!clip)
+				cerr << "Warning: couldn't read animation file " << event.text << "; its frames are skipped" << endl;
+			numFrames = clip ? clip->numFrames(fps) : 0;
+			view.cancelFrameAhead();
+			setupCache();
+			break;
+		case InputRecording::PLAY:
+			repeat = event.a == InputRecording::PLAY_REPEAT;
+			break;
+		case InputRecording::ANIMATION_FRAME: {
+			if (!clip || numFrames == 0)
+				break;
+			unsigned frame = event.a;
+			int count = min((int) clip->numControls(), numControls);
+			if (!view.presentFrame(frame)) {
+				clip->sample((float) frame / fps, controls, rotations);
+				view.setControlValues(controls.data(), rotations.data(), count);
+				view.updateFrame(frame);
+			}
+			bool last = !repeat && frame + 1 >= numFrames;
+			if (pipelineOn && !last) {
+				unsigned next = (frame + 1) % numFrames;
+				clip->sample((float) next / fps, controls, rotations);
+				view.skinFrameAhead(next, controls.data(), rotations.data(), count);
+			}
+			break;
+		}
+		case InputRecording::CACHE:
+			cacheOn = event.a != 0;
+			setupCache();
+			break;
+		case InputRecording::PIPELINE:
+			pipelineOn = event.a != 0;
+			if (!pipelineOn)
+				view.cancelFrameAhead();
+			break;
+		case InputRecording::PRESENT: {
+			ScopedPhaseTimer timer(&view.timings, PhaseTimings::DRAW);
+			if (software) {
+				softwareScene.draw(view.camera, view.models, drawAxes, view.drawSkeleton, drawColor);
+				if (capture.active())
+					capture.submit(softwareScene.pixels(), w, h);
+			}
+			else {
+				scene.draw(view.camera, view.models, drawAxes, view.drawSkeleton);
+				if (capture.active())
+					capture.capture(w, h);
+				else
+					glFinish();
+			}
+			break;
+		}
+		default:
+			break;
+		}
+
+		double secs = chrono::duration<double>(chrono::steady_clock::now() - eventStart).count();
+		frameSecs += secs;
+		busySecs += secs;
+		if (event.type == InputRecording::PRESENT) {
+			view.timings.endFrame();
+			frameTimes.push_back((float) (frameSecs * 1e3));
+			frameSecs = 0;
+		}
+	}
+	bool captured = capture.stop();
+	double elapsedSecs = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+	double recordedSecs = recording.events().empty() ? 0 : recording.events().back().time;
+	cout << "Replayed " << numApplied << " events and " << frameTimes.size() << " frames recorded over "
+		<< recordedSecs << " s in " << elapsedSecs << " s (" << busySecs << " s busy)" << endl;
+	PhaseTimings::Summary frame = PhaseTimings::summarize(frameTimes);
+	cout << "Per frame (ms): mean " << frame.mean << ", p50 " << frame.p50 << ", p95 " << frame.p95 << ", p99 "
+		<< frame.p99 << ", max " << frame.max << endl;
+	for (int phase = 0; phase < PhaseTimings::NUM_PHASES; ++phase) {
+		PhaseTimings::Summary s = view.timings.summarize((PhaseTimings::Phase) phase);
+		cout << "  " << PhaseTimings::name((PhaseTimings::Phase) phase) << ": mean " << s.mean << ", p95 " << s.p95
+			<< ", max " << s.max << endl;
+	}
+	if (!timingsFile.empty() && !view.timings.writeCsv(timingsFile)) {
+		cerr << "Error: couldn't write " << timingsFile << endl;
+		return -1;
+	}
+	return captured ? 0 : -1;
+}
@@ -0,0 +1,9 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+// Entry point of "a3 --replay FILE ...": replay a session recorded with
+// --record (see InputRecording) without any window, as fast as possible or in
+// real time, and report the time spent per frame and per phase.
+int runReplay(int argc, char* argv[]);
+
+#endif // REPLAY_H
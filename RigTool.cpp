@@ -0,0 +1,74 @@
+#include "RigTool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "SyntheticRig.h"
+
+using namespace std;
+
+static void printUsage(const char *program)
+{
+	cout << "Usage: " << program << " --generate-rig [options] OUT_PREFIX" << endl
+		<< "Writes OUT_PREFIX.skel, OUT_PREFIX.obj and OUT_PREFIX.attach." << endl
+		<< "Options:" << endl
+		<< "  --vertices N        vertex count, rounded to whole rings (default: 10000)" << endl
+		<< "  --joints N          joint count, the root included (default: 18)" << endl
+		<< "  --depth N           joints per chain below the root (default: all in one chain)" << endl
+		<< "  --influences N      joints per vertex (default: 2)" << endl
+		<< "  --subdivide PREFIX LEVELS  instead, split every triangle of an existing model" << endl
+		<< "                      into 4, LEVELS times; --influences then keeps only the" << endl
+		<< "                      largest weights of every vertex (default: all of them)" << endl;
+}
+
+int runGenerateRig(int argc, char* argv[])
+{
+	SyntheticRig rig;
+	string sourcePrefix;
+	int levels = 0, influences = 0;
+	vector<string> positional;
+
+	// argv[1] is "--generate-rig" itself
+	for (int i = 2; i < argc; ++i) {
+		string arg = argv[i];
+		int remaining = argc - i - 1;
+		if (arg == "--vertices" && remaining >= 1)
+			rig.numVertices = max(atoi(argv[++i]), 1);
+		else if (arg == "--joints" && remaining >= 1)
+			rig.numJoints = max(atoi(argv[++i]), 2);
+		else if (arg == "--depth" && remaining >= 1)
+			rig.depth = max(atoi(argv[++i]), 0);
+		else if (arg == "--influences" && remaining >= 1)
+			rig.influences = influences = max(atoi(argv[++i]), 1);
+		else if (arg == "--subdivide" && remaining >= 2) {
+			sourcePrefix = argv[++i];
+			levels = max(atoi(argv[++i]), 0);
+		}
+		else if (arg.compare(0, 2, "--") == 0) {
+			cerr << "Error: unknown or incomplete option " << arg << endl;
+			printUsage(argv[0]);
+			return -1;
+		}
+		else
+			positional.push_back(arg);
+	}
+	if (positional.size() != 1) {
+		printUsage(argv[0]);
+		return -1;
+	}
+
+	auto start = chrono::steady_clock::now();
+	bool written = sourcePrefix.empty() ? rig.write(positional[0])
+		: SyntheticRig::writeSubdivided(sourcePrefix, levels, influences, positional[0]);
+	if (!written) {
+		cerr << "Error: couldn't write " << positional[0] << (sourcePrefix.empty() ? "" : " from " + sourcePrefix) << endl;
+		return -1;
+	}
+	cout << "Wrote " << positional[0] << ".skel, .obj and .attach in "
+		<< chrono::duration<double>(chrono::steady_clock::now() - start).count() << " s" << endl;
+	return 0;
+}
@@ -0,0 +1,8 @@
+#ifndef RIG_TOOL_H
+#define RIG_TOOL_H
+
+// Entry point of "a3 --generate-rig ...": write a synthetic model, or a
+// subdivided copy of an existing one, for scaling tests.
+int runGenerateRig(int argc, char* argv[]);
+
+#endif // RIG_TOOL_H
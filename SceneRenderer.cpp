@@ -0,0 +1,153 @@
+#include "SceneRenderer.h"
+#include "camera.h"
+#include "Trace.h"
+
+using namespace std;
+
+void SceneRenderer::invalidate()
+{
+	m_skeletonRenderer.invalidate();
+}
+
+void SceneRenderer::setup(Camera& camera, int w, int h)
+{
+	// Setup opengl
+	glShadeModel( GL_SMOOTH );
+	glEnable( GL_DEPTH_TEST );
+	glEnable( GL_LIGHTING );
+	glEnable( GL_LIGHT0 );
+	glEnable( GL_NORMALIZE );
+
+	camera.SetDimensions( w, h );
+	camera.SetViewport( 0, 0, w, h );
+	camera.ApplyViewport();
+
+	glMatrixMode( GL_PROJECTION );
+	glLoadIdentity();
+	camera.SetPerspective( 50.0f );
+	glLoadMatrixf( camera.projectionMatrix() );
+}
+
+void SceneRenderer::draw(Camera& camera, vector<SkeletalModel>& models, bool drawAxes, bool drawSkeleton)
+{
+	TraceSpan span( "draw scene" );
+	glMatrixMode( GL_MODELVIEW );
+	glLoadIdentity();
+
+	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+
+	// Note that the lighting is applied *before* applying the camera
+	// transform.  This is so the light appeared fixed on the camera.
+	GLfloat Lt0diff[] = {1.0,1.0,1.0,1.0};
+	GLfloat Lt0pos[] = {3.0,3.0,5.0,1.0};
+	glLightfv(GL_LIGHT0, GL_DIFFUSE, Lt0diff);
+	glLightfv(GL_LIGHT0, GL_POSITION, Lt0pos);
+
+	// These are just some default material colors
+	GLfloat diffColor[] = {0.4f, 0.4f, 0.4f, 1.f};
+	GLfloat specColor[] = {0.6f, 0.6f, 0.6f, 1.f};
+	GLfloat shininess[] = {50.0f};
+
+	glMaterialfv( GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE, diffColor );
+	glMaterialfv( GL_FRONT_AND_BACK, GL_SPECULAR, specColor );
+	glMaterialfv( GL_FRONT_AND_BACK, GL_SHININESS, shininess );
+
+	// Load the camera view matrix
+	Matrix4f viewMatrix = camera.viewMatrix();
+	glLoadMatrixf( viewMatrix );
+
+	if( drawAxes )
+	{
+		this->drawAxes();
+	}
+
+	// Models outside the view are neither skinned nor drawn
+	Frustum frustum( camera.projectionMatrix() * viewMatrix );
+
+	if( drawSkeleton )
+	{
+		// Gather the joints and bones of all models, then draw them in one batch
+		m_jointInstances.clear();
+		m_boneInstances.clear();
+		for (auto &model : models)
+			if( frustum.intersects( model.getBounds() ) )
+				model.getSkeletonInstances( m_jointInstances, m_boneInstances );
+		TraceSpan span( "draw skeletons", "joints", m_jointInstances.size() );
+		m_skeletonRenderer.draw( viewMatrix, m_jointInstances, m_boneInstances );
+	}
+	else
+	{
+		for (int m = 0, numModels = models.size(); m < numModels; ++m)
+		{
+			SkeletalModel &model = models[m];
+			if( !frustum.intersects( model.getBounds() ) )
+				continue;
+			// Skinning was skipped while the model was out of view
+			if( model.isMeshStale() )
+			{
+				ScopedPhaseTimer timer( m_timings, PhaseTimings::SKINNING );
+				model.updateMesh();
+			}
+			ScopedPhaseTimer timer( m_timings, PhaseTimings::MESH_DRAW );
+			TraceSpan span( "draw model", "model", m );
+			drawMesh( viewMatrix, model.getMesh() );
+		}
+	}
+}
+
+void SceneRenderer::drawMesh(const Matrix4f& viewMatrix, const Mesh& mesh)
+{
+	glLoadMatrixf( viewMatrix );
+
+	// Since these meshes don't have normals
+	// a normal is generated per triangle (by updateNormals()).
+	// Notice that since we have per-triangle normals
+	// rather than the analytical normals from
+	// assignment 1, the appearance is "faceted".
+	glColorMaterial( GL_FRONT_AND_BACK, GL_DIFFUSE );
+
+	glBegin( GL_TRIANGLES );
+	for (int i = 0, numFaces = mesh.faces.size(); i < numFaces; ++i) {
+		int ix = mesh.faces[i][0] - 1,
+			iy = mesh.faces[i][1] - 1,
+			iz = mesh.faces[i][2] - 1;
+		const Vector3f &vx = mesh.currentVertices[ix],
+			&vy = mesh.currentVertices[iy],
+			&vz = mesh.currentVertices[iz],
+			&cx = mesh.vertexColors[ix],
+			&cy = mesh.vertexColors[iy],
+			&cz = mesh.vertexColors[iz];
+
+		const Vector3f &normal = mesh.currentNormals[i];
+
+		glNormal3f( normal[0], normal[1], normal[2] );
+		glColor3f( cx[0], cx[1], cx[2] );
+		glVertex3f( vx[0], vx[1], vx[2] );
+		glColor3f( cy[0], cy[1], cy[2] );
+		glVertex3f( vy[0], vy[1], vy[2] );
+		glColor3f( cz[0], cz[1], cz[2] );
+		glVertex3f( vz[0], vz[1], vz[2] );
+	}
+	glEnd();
+}
+
+void SceneRenderer::drawAxes()
+{
+	glDisable( GL_LIGHTING );
+	glBegin( GL_LINES );
+
+	glColor3f( 1, 0, 0 );
+	glVertex3f( 0, 0, 0 );
+	glVertex3f( 1, 0, 0 );
+
+	glColor3f( 0, 1, 0 );
+	glVertex3f( 0, 0, 0 );
+	glVertex3f( 0, 1, 0 );
+
+	glColor3f( 0, 0, 1 );
+	glVertex3f( 0, 0, 0 );
+	glVertex3f( 0, 0, 1 );
+
+	glEnd();
+	glEnable( GL_LIGHTING );
+}
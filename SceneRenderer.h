@@ -0,0 +1,51 @@
+#ifndef SCENE_RENDERER_H
+#define SCENE_RENDERER_H
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include <vector>
+#include <GL/gl.h>
+
+#include "SkeletalModel.h"
+#include "SkeletonRenderer.h"
+#include "PhaseTimings.h"
+
+class Camera;
+
+// Draws the loaded models into the current GL context.
+// It does not depend on FLTK, so the modeler window and the
+// headless renderer share the same drawing code.
+class SceneRenderer
+{
+public:
+	// Forget GL objects, e.g. when the GL context has been recreated
+	void invalidate();
+
+	// Set up GL state, viewport and projection for a w x h framebuffer
+	void setup( Camera& camera, int w, int h );
+
+	// Draw the models (or their skeletons) as seen from the camera.
+	// Models outside the view frustum are skipped, and stale meshes of
+	// visible models are skinned first.
+	void draw( Camera& camera, std::vector< SkeletalModel >& models, bool drawAxes, bool drawSkeleton );
+
+	void drawAxes();
+
+	// Time skinning and mesh drawing into timings, if not NULL
+	void setTimings( PhaseTimings* timings ) { m_timings = timings; }
+
+private:
+	// Draw the current (skinned) vertices of a mesh, with a normal per face
+	void drawMesh( const Matrix4f& viewMatrix, const Mesh& mesh );
+
+	PhaseTimings* m_timings = NULL;
+
+	// Batched drawing of the skeletons of all models
+	SkeletonRenderer m_skeletonRenderer;
+	std::vector< Matrix4f > m_jointInstances;
+	std::vector< Matrix4f > m_boneInstances;
+};
+
+#endif // SCENE_RENDERER_H
@@ -1,6 +1,8 @@
 #include "SkeletalModel.h"
+#include "Trace.h"
 
-#include <FL/Fl.H>
+#include <algorithm>
+#include <cmath>
 
 using namespace std;
 
@@ -13,47 +15,60 @@ static inline void trim_string(string &s) {
 	}).base(), s.end());
 }
 
-vector<Joint*> SkeletalModel::getJoints()
-{
-	return m_joints;
-}
-
 void SkeletalModel::load(const char *skeletonFile, const char *meshFile, const char *attachmentsFile)
 {
+	TraceSpan span("load model", meshFile);
 	loadSkeleton(skeletonFile);
 
 	m_mesh.load(meshFile);
 	m_mesh.loadAttachments(attachmentsFile, m_joints.size());
 
 	computeBindWorldToJointTransforms();
+	computeJointBounds();
+
+	// Start in the bind pose
+	m_pose.assign(getNumControls(), 0.f);
+	m_poseRotations.assign(m_joints.size(), Quat4f::IDENTITY);
+	m_poseIsQuaternion.assign(m_joints.size(), false);
+	m_poseChanged = true;
 	updateCurrentJointToWorldTransforms();
 }
 
-void SkeletalModel::draw(Matrix4f cameraMatrix, bool skeletonVisible)
+void SkeletalModel::load(const string &prefix)
 {
-	// draw() gets called whenever a redraw is required
-	// (after an update() occurs, when the camera moves, the window is resized, etc)
+	string skeletonFile = prefix + ".skel";
+	string meshFile = prefix + ".obj";
+	string attachmentsFile = prefix + ".attach";
 
-	m_matrixStack.clear();
-	m_matrixStack.push(cameraMatrix);
+	load(skeletonFile.c_str(), meshFile.c_str(), attachmentsFile.c_str());
+}
 
-	if( skeletonVisible )
-	{
-		drawJoints();
-		drawSkeleton();
-	}
-	else
-	{
-		// Clear out any weird matrix we may have been using for drawing the bones and revert to the camera matrix.
-		glLoadMatrixf(m_matrixStack.top());
+const Vector3f RND(0, 0, 1);
 
-		// Tell the mesh to draw itself.
-		m_mesh.draw();
-	}
+// Transform of the box primitive (a unit cube) drawn for the bone from a parent joint
+// to a child joint at the given offset, relative to the frame of the parent joint.
+static Matrix4f boneFrame(const Vector3f &offset)
+{
+	// Compute the length
+	float length = offset.abs();
+
+	// Assemble the transformation for direction
+	Vector3f directionZ = offset.normalized(),
+		directionY = Vector3f::cross(directionZ, RND).normalized(),
+		directionX = Vector3f::cross(directionY, directionZ).normalized();
+	Matrix4f directionTransform = Matrix4f::identity();
+	directionTransform.setSubmatrix3x3(0, 0, Matrix3f(directionX, directionY, directionZ, true));
+
+	// Apply transformations for the cube primitive
+	return directionTransform
+		* Matrix4f::scaling(0.05, 0.05, length)
+		* Matrix4f::translation(0, 0, 0.5);
 }
 
 void SkeletalModel::loadSkeleton( const char* filename )
 {
+	TraceSpan span("load skeleton", filename);
+
 	// Load the skeleton from file here.
 	ifstream stream(filename);
 	float x, y, z;
@@ -65,120 +80,120 @@ void SkeletalModel::loadSkeleton( const char* filename )
 		m_joints.push_back(joint);
 		// joint->children = vector<Joint*>();
 		joint->transform = Matrix4f::translation(x, y, z);
+		m_jointParents.push_back(parent);
+		m_jointOffsets.push_back(Vector3f(x, y, z));
 		if (parent == -1) {
 			m_rootJoint = joint;
 			m_rootTranslation = Vector3f(x, y, z);
 		}
-		else
+		else {
 			m_joints[parent]->children.push_back(joint);
+			m_boneParents.push_back(parent);
+			m_boneFrames.push_back(boneFrame(Vector3f(x, y, z)));
+		}
 
 		// Read joint name. If not specified, then the name is empty
 		getline(stream, joint->name);
 		trim_string(joint->name);
 	}
 	stream.close();
-	cout << "Read joints: " << m_joints.size() << endl;
 }
 
-void recursiveDrawJoints(Joint *joint, MatrixStack &stack)
+void SkeletalModel::getSkeletonInstances(vector<Matrix4f>& jointInstances, vector<Matrix4f>& boneInstances)
 {
-	// Push current joint transformation into stack
-	stack.push(joint->transform);
-
-	// Draw current joint
-	glLoadMatrixf(stack.top());
-	glutSolidSphere(0.025f, 12, 12);
-
-	// Iterate children joints recursively
-	for (auto childJoint : joint->children)
-		recursiveDrawJoints(childJoint, stack);
-
-	// Pop out current joint
-	stack.pop();
+	// Both lists are refreshed whenever the pose changes, see updateCurrentJointToWorldTransforms()
+	jointInstances.insert(jointInstances.end(), m_jointInstances.begin(), m_jointInstances.end());
+	boneInstances.insert(boneInstances.end(), m_boneInstances.begin(), m_boneInstances.end());
 }
 
-void SkeletalModel::drawJoints( )
+void SkeletalModel::setJointTransform(int jointIndex, float rX, float rY, float rZ)
 {
-	// If no joint is loaded, then does nothing
-	if (m_joints.size() == 0) return;
-
+	// Set the rotation part of the joint's transformation matrix based on the passed in Euler angles.
+	Matrix4f rotateX = Matrix4f::rotateX(rX),
+		rotateY = Matrix4f::rotateY(rY),
+		rotateZ = Matrix4f::rotateZ(rZ),
+		rotate = rotateX * rotateY * rotateZ;
 
-	// Draw a sphere at each joint. You will need to add a recursive helper function to traverse the joint hierarchy.
-	//
-	// We recommend using glutSolidSphere( 0.025f, 12, 12 )
-	// to draw a sphere of reasonable size.
-	//
-	// You are *not* permitted to use the OpenGL matrix stack commands
-	// (glPushMatrix, glPopMatrix, glMultMatrix).
-	// You should use your MatrixStack class
-	// and use glLoadMatrix() before your drawing call.
+	m_joints[jointIndex]->transform.setSubmatrix3x3(0, 0, rotate.getSubmatrix3x3(0, 0));
+}
 
-	recursiveDrawJoints(m_rootJoint, m_matrixStack);
+void SkeletalModel::setRootTranslation(float dX, float dY, float dZ)
+{
+	Vector3f updatedTranslation = m_rootTranslation + Vector3f(dX, dY, dZ);
+	m_rootJoint->transform.setCol(3, Vector4f(updatedTranslation, 1));
 }
 
-const Vector3f RND(0, 0, 1);
+int SkeletalModel::getNumControls() const
+{
+	return (m_joints.size() + 1) * 3;
+}
 
-void recursiveDrawSkeletons(Joint* joint, MatrixStack& stack, bool hasParent)
+const float *SkeletalModel::getPose() const
 {
-	// Draw the skeleton from parent joint to current joint
-	if (hasParent) {
-		// Compute the length
-		float length = joint->transform.getCol(3).xyz().abs();
-
-		// Assemble the transformation for direction
-		Vector3f directionZ = joint->transform.getCol(3).xyz().normalized(),
-			directionY = Vector3f::cross(directionZ, RND).normalized(),
-			directionX = Vector3f::cross(directionY, directionZ).normalized();
-		Matrix4f directionTransform = Matrix4f::identity();
-		directionTransform.setSubmatrix3x3(0, 0, Matrix3f(directionX, directionY, directionZ, true));
-
-		// Apply transformations for the cube primitive
-		Matrix4f cubeTransform =
-			directionTransform
-			* Matrix4f::scaling(0.05, 0.05, length)
-			* Matrix4f::translation(0, 0, 0.5);
-
-		// Draw the cube
-		stack.push(cubeTransform);
-		glLoadMatrixf(stack.top());
-		glutSolidCube(1.0f);
-		stack.pop();
+	if (m_poseAnglesStale) {
+		// Euler angles of the quaternion joints, as composed by setJointTransform(): Rx * Ry * Rz
+		for (int j = 0, numJoints = m_joints.size(); j < numJoints; ++j) {
+			if (!m_poseIsQuaternion[j])
+				continue;
+			Matrix3f r = Matrix3f::rotation(m_poseRotations[j]);
+			float *angles = &m_pose[3 + j * 3];
+			angles[0] = atan2(-r(1, 2), r(2, 2));
+			angles[1] = asin(min(max(r(0, 2), -1.f), 1.f));
+			angles[2] = atan2(-r(0, 1), r(0, 0));
+		}
+		m_poseAnglesStale = false;
 	}
-
-	// Push current joint transformation into stack
-	stack.push(joint->transform);
-
-	// Draw skeletons between current joint and its every child
-	for (auto childJoint : joint->children)
-		recursiveDrawSkeletons(childJoint, stack, true);
-
-	// Pop out current joint
-	stack.pop();
+	return m_pose.data();
 }
 
-void SkeletalModel::drawSkeleton()
+void SkeletalModel::setControlValues(const float *values, const Quat4f *rotations)
 {
-	// If no joint is loaded, then does nothing
-	if (m_joints.size() == 0) return;
-	// Draw boxes between the joints. You will need to add a recursive helper function to traverse the joint hierarchy.
-	recursiveDrawSkeletons(m_rootJoint, m_matrixStack, false);
+	if (rotations) {
+		copy(values, values + 3, m_pose.begin());
+		copy(rotations + 1, rotations + 1 + m_joints.size(), m_poseRotations.begin());
+		fill(m_poseIsQuaternion.begin(), m_poseIsQuaternion.end(), true);
+		m_poseAnglesStale = true;
+	}
+	else {
+		copy(values, values + m_pose.size(), m_pose.begin());
+		fill(m_poseIsQuaternion.begin(), m_poseIsQuaternion.end(), false);
+		m_poseAnglesStale = false;
+	}
+	m_poseChanged = true;
+	++m_poseVersion;
 }
 
-void SkeletalModel::setJointTransform(int jointIndex, float rX, float rY, float rZ)
+void SkeletalModel::setControlValue(int control, float value)
 {
-	// Set the rotation part of the joint's transformation matrix based on the passed in Euler angles.
-	Matrix4f rotateX = Matrix4f::rotateX(rX),
-		rotateY = Matrix4f::rotateY(rY),
-		rotateZ = Matrix4f::rotateZ(rZ),
-		rotate = rotateX * rotateY * rotateZ;
+	if (control >= 3) {
+		// The other two angles of the joint keep the values of its quaternion
+		getPose();
+		m_poseIsQuaternion[control / 3 - 1] = false;
+	}
+	m_pose[control] = value;
+	m_poseChanged = true;
+	++m_poseVersion;
+}
 
-	m_joints[jointIndex]->transform.setSubmatrix3x3(0, 0, rotate.getSubmatrix3x3(0, 0));
+void SkeletalModel::setJointRotation(int jointIndex, const Quat4f &rotation)
+{
+	m_poseRotations[jointIndex] = rotation;
+	m_poseIsQuaternion[jointIndex] = true;
+	m_poseAnglesStale = true;
+	m_poseChanged = true;
+	++m_poseVersion;
 }
 
-void SkeletalModel::setRootTranslation(float dX, float dY, float dZ)
+void SkeletalModel::applyPose()
 {
-	Vector3f updatedTranslation = m_rootTranslation + Vector3f(dX, dY, dZ);
-	m_rootJoint->transform.setCol(3, Vector4f(updatedTranslation, 1));
+	setRootTranslation(m_pose[0], m_pose[1], m_pose[2]);
+	for (int j = 0, numJoints = m_joints.size(); j < numJoints; ++j) {
+		if (m_poseIsQuaternion[j])
+			m_joints[j]->transform.setSubmatrix3x3(0, 0, Matrix3f::rotation(m_poseRotations[j]));
+		else
+			setJointTransform(j, m_pose[3 + j * 3], m_pose[4 + j * 3], m_pose[5 + j * 3]);
+	}
+	m_poseChanged = false;
 }
 
 void recursiveComputeBindWorldToJointTransforms(Joint* joint, MatrixStack& stack)
@@ -208,7 +223,32 @@ void SkeletalModel::computeBindWorldToJointTransforms()
 	// This method should update each joint's bindWorldToJointTransform.
 	// You will need to add a recursive helper function to traverse the joint hierarchy.
 
-	recursiveComputeBindWorldToJointTransforms(m_rootJoint, MatrixStack());
+	MatrixStack stack;
+	recursiveComputeBindWorldToJointTransforms(m_rootJoint, stack);
+}
+
+void SkeletalModel::computeJointBounds()
+{
+	int numJoints = m_joints.size();
+	m_jointBounds.assign(numJoints, BoundingBox());
+
+	// Skinned vertices are blends of the vertex carried rigidly by each influencing joint
+	for (int i = 0, numVertices = m_mesh.bindVertices.size(); i < numVertices; ++i)
+		for (int j = 0; j < numJoints; ++j)
+			if (m_mesh.attachments[i][j] > 0)
+				m_jointBounds[j].extend((m_joints[j]->bindWorldToJointTransform * Vector4f(m_mesh.bindVertices[i], 1.f)).xyz());
+
+	// The skeleton view: a sphere at every joint and a box along every bone
+	const float radius = 0.025f;
+	for (int j = 0; j < numJoints; ++j) {
+		m_jointBounds[j].extend(Vector3f(-radius));
+		m_jointBounds[j].extend(Vector3f(radius));
+	}
+	BoundingBox unitCube;
+	unitCube.extend(Vector3f(-0.5f));
+	unitCube.extend(Vector3f(0.5f));
+	for (int b = 0, numBones = m_boneFrames.size(); b < numBones; ++b)
+		m_jointBounds[m_boneParents[b]].extend(unitCube.transformed(m_boneFrames[b]));
 }
 
 void recursiveUpdateCurrentJointToWorldTransforms(Joint* joint, MatrixStack& stack)
@@ -227,6 +267,7 @@ void SkeletalModel::updateCurrentJointToWorldTransforms()
 {
 	// If no joint is loaded, then does nothing
 	if (m_joints.size() == 0) return;
+	TraceSpan span("joint transforms", "joints", m_joints.size());
 
 
 	// 2.3.2. Implement this method to compute a per-joint transform from
@@ -238,7 +279,27 @@ void SkeletalModel::updateCurrentJointToWorldTransforms()
 	// This method should update each joint's bindWorldToJointTransform.
 	// You will need to add a recursive helper function to traverse the joint hierarchy.
 
-	recursiveUpdateCurrentJointToWorldTransforms(m_rootJoint, MatrixStack());
+	// Bring the joint transforms up to date with the pose buffer
+	if (m_poseChanged)
+		applyPose();
+
+	MatrixStack stack;
+	recursiveUpdateCurrentJointToWorldTransforms(m_rootJoint, stack);
+
+	// Place the joint spheres and bone boxes of the skeleton view in the new pose
+	m_jointInstances.resize(m_joints.size());
+	for (int j = 0, numJoints = m_joints.size(); j < numJoints; ++j)
+		m_jointInstances[j] = m_joints[j]->currentJointToWorldTransform;
+
+	m_boneInstances.resize(m_boneFrames.size());
+	for (int b = 0, numBones = m_boneFrames.size(); b < numBones; ++b)
+		m_boneInstances[b] = m_joints[m_boneParents[b]]->currentJointToWorldTransform * m_boneFrames[b];
+
+	// Refit the bounds to the new pose; the mesh is skinned later, if it is visible
+	m_bounds = BoundingBox();
+	for (int j = 0, numJoints = m_joints.size(); j < numJoints; ++j)
+		m_bounds.extend(m_jointBounds[j].transformed(m_joints[j]->currentJointToWorldTransform));
+	m_meshStale = true;
 }
 
 void SkeletalModel::updateMesh()
@@ -249,18 +310,135 @@ void SkeletalModel::updateMesh()
 	// You will need both the bind pose world --> joint transforms.
 	// and the current joint --> world transforms.
 
-	m_mesh.currentVertices.clear();
+	TraceSpan span("updateMesh", "vertices", m_mesh.bindVertices.size());
+	m_meshStale = false;
+	updateSkinningTransforms();
+	skinVertices(m_skinningTransforms, m_mesh.currentVertices);
+	m_mesh.updateNormals();
+}
+
+void SkeletalModel::skinMesh(float *vertices, size_t vertexStride, float *normals, size_t normalStride)
+{
+	TraceSpan span("skinMesh", "vertices", m_mesh.bindVertices.size());
+	updateSkinningTransforms();
+	skinVertices(m_skinningTransforms, vertices, vertexStride);
+	if (normals)
+		m_mesh.computeNormals(vertices, vertexStride, normals, normalStride);
+}
+
+void SkeletalModel::updateSkinningTransforms()
+{
+	// The transform from bind to current pose of every joint, once per joint instead of per vertex
 	int numJoints = m_joints.size();
+	m_skinningTransforms.resize(numJoints);
+	for (int j = 0; j < numJoints; ++j)
+		m_skinningTransforms[j] = m_joints[j]->currentJointToWorldTransform * m_joints[j]->bindWorldToJointTransform;
+}
 
-	for (int i = 0, numVertices = m_mesh.bindVertices.size(); i < numVertices; ++i) {
+void SkeletalModel::skinVertices(const vector<Matrix4f> &skinningTransforms, vector<Vector3f> &vertices) const
+{
+	vertices.resize(m_mesh.bindVertices.size());
+	if (!vertices.empty())
+		skinVertices(skinningTransforms, vertices[0], sizeof(Vector3f));
+}
+
+void SkeletalModel::skinVertices(const vector<Matrix4f> &skinningTransforms, float *vertices, size_t stride) const
+{
+	int numJoints = m_joints.size(), numVertices = m_mesh.bindVertices.size();
+
+	for (int i = 0; i < numVertices; ++i) {
 		Vector4f weighted(0.f);
 
 		for (int j = 0; j < numJoints; ++j)
 			weighted = weighted +
-				m_joints[j]->currentJointToWorldTransform
-				* m_joints[j]->bindWorldToJointTransform
+				skinningTransforms[j]
 				* Vector4f(m_mesh.bindVertices[i], 1.0f) * m_mesh.attachments[i][j];
 
-		m_mesh.currentVertices.push_back(weighted.xyz());
+		float *vertex = (float *) ((char *) vertices + i * stride);
+		vertex[0] = weighted[0];
+		vertex[1] = weighted[1];
+		vertex[2] = weighted[2];
+	}
+}
+
+void SkeletalModel::computeSkinningTransforms(const float *values, const Quat4f *rotations,
+	vector<Matrix4f> &jointTransforms) const
+{
+	// The joint to world transforms, like applyPose() and updateCurrentJointToWorldTransforms()
+	// but from the joints' fixed offsets; parents come before their children
+	int numJoints = m_joints.size();
+	jointTransforms.resize(numJoints);
+	for (int j = 0; j < numJoints; ++j) {
+		Vector3f offset = m_jointParents[j] < 0 ? m_rootTranslation + Vector3f(values[0], values[1], values[2]) : m_jointOffsets[j];
+		Matrix4f local = Matrix4f::translation(offset[0], offset[1], offset[2]);
+		if (rotations)
+			local.setSubmatrix3x3(0, 0, Matrix3f::rotation(rotations[j + 1]));
+		else {
+			const float *angles = values + 3 + j * 3;
+			Matrix4f rotate = Matrix4f::rotateX(angles[0]) * Matrix4f::rotateY(angles[1]) * Matrix4f::rotateZ(angles[2]);
+			local.setSubmatrix3x3(0, 0, rotate.getSubmatrix3x3(0, 0));
+		}
+		jointTransforms[j] = m_jointParents[j] < 0 ? local : jointTransforms[m_jointParents[j]] * local;
 	}
+
+	// Every parent is done, so the transforms can be turned into skinning transforms in place
+	for (int j = 0; j < numJoints; ++j)
+		jointTransforms[j] = jointTransforms[j] * m_joints[j]->bindWorldToJointTransform;
+}
+
+void SkeletalModel::skinPose(const float *values, const Quat4f *rotations, vector<Matrix4f> &jointTransforms,
+	vector<Vector3f> &vertices, vector<Vector3f> &normals) const
+{
+	TraceSpan span("skinPose", "vertices", m_mesh.bindVertices.size());
+	computeSkinningTransforms(values, rotations, jointTransforms);
+	skinVertices(jointTransforms, vertices);
+	m_mesh.computeNormals(vertices, normals);
+}
+
+void SkeletalModel::skinPose(const float *values, const Quat4f *rotations, vector<Matrix4f> &jointTransforms,
+	float *vertices, size_t vertexStride, float *normals, size_t normalStride) const
+{
+	TraceSpan span("skinPose", "vertices", m_mesh.bindVertices.size());
+	computeSkinningTransforms(values, rotations, jointTransforms);
+	skinVertices(jointTransforms, vertices, vertexStride);
+	if (normals)
+		m_mesh.computeNormals(vertices, vertexStride, normals, normalStride);
+}
+
+void SkeletalModel::swapSkinnedMesh(vector<Vector3f> &vertices, vector<Vector3f> &normals)
+{
+	m_mesh.currentVertices.swap(vertices);
+	m_mesh.currentNormals.swap(normals);
+	m_meshStale = false;
+}
+
+void SkeletalModel::setSkinnedMesh(const Vector3f *vertices, const Vector3f *normals)
+{
+	copy(vertices, vertices + m_mesh.bindVertices.size(), m_mesh.currentVertices.begin());
+	copy(normals, normals + m_mesh.faces.size(), m_mesh.currentNormals.begin());
+	m_meshStale = false;
+}
+
+void SkeletalModel::reportMemory(MemoryReport &report) const
+{
+	m_mesh.reportMemory(report);
+
+	// Every joint is allocated on its own
+	report.add("joints", m_joints);
+	report.add("joints", m_joints.size() * sizeof(Joint), m_joints.size());
+	for (const Joint *joint : m_joints)
+		report.add("joints", joint->children);
+	report.add("joints", m_jointParents);
+	report.add("joints", m_jointOffsets);
+	report.add("joint bounds", m_jointBounds);
+
+	report.add("bones", m_boneParents);
+	report.add("bones", m_boneFrames);
+	report.add("skeleton view", m_jointInstances);
+	report.add("skeleton view", m_boneInstances);
+
+	report.add("pose", m_pose);
+	report.add("pose", m_poseRotations);
+	report.add("pose", m_poseIsQuaternion);
+	report.add("skinning transforms", m_skinningTransforms);
 }
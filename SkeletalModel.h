@@ -1,22 +1,11 @@
 #ifndef SKELETALMODEL_H
 #define SKELETALMODEL_H
 
-#ifdef WIN32
-#include <windows.h>
-#endif
-
 #ifndef M_PI
 #define M_PI 3.14159265358979f
 #endif
 
 #include <cstdlib>
-#ifdef WIN32
-#include "GL/freeglut.h"
-#include "FL/gl.h"
-#else
-#include <GL/glut.h>
-#include <FL/gl.h>
-#endif
 #include <iostream>
 #include <fstream>
 #include <map>
@@ -28,13 +17,15 @@
 #include "Joint.h"
 #include "Mesh.h"
 #include "MatrixStack.h"
+#include "Bounds.h"
 
 class SkeletalModel
 {
 public:
 	// Already-implemented utility functions that call the code you will write.
 	void load(const char *skeletonFile, const char *meshFile, const char *attachmentsFile);
-	void draw(Matrix4f cameraMatrix, bool drawSkeleton);
+	// Extra: load PREFIX.skel, PREFIX.obj and PREFIX.attach
+	void load(const std::string &prefix);
 
 	// Part 1: Understanding Hierarchical Modeling
 
@@ -42,11 +33,10 @@ public:
 	// This method should compute m_rootJoint and populate m_joints.
 	void loadSkeleton( const char* filename );
 
-	// 1.1. Implement this method with a recursive helper to draw a sphere at each joint.
-	void drawJoints( );
-
-	// 1.2. Implement this method a recursive helper to draw a box between each pair of joints
-	void drawSkeleton( );
+	// 1.1. / 1.2. Collect the world transforms of a sphere at each joint and
+	// of a box between each pair of joints. They are appended to the lists,
+	// so that SkeletonRenderer can draw the skeletons of all models in a batch.
+	void getSkeletonInstances( std::vector< Matrix4f >& jointInstances, std::vector< Matrix4f >& boneInstances );
 
 	// 1.3. Implement this method to handle changes to your skeleton given
 	// changes in the slider values
@@ -55,6 +45,29 @@ public:
 	// Extra: Allow setting delta translation for root joint
 	void setRootTranslation(float dX, float dY, float dZ);
 
+	// Extra: number of control values of this model, laid out as the root
+	// translation followed by the rotation of every joint (3 values each)
+	int getNumControls() const;
+
+	// Extra: pose buffer. It holds the current pose as getNumControls() control
+	// values (root translation, then XYZ Euler angles of every joint), and is
+	// written directly by animation, file loading and the UI. The joint transforms
+	// are rebuilt from it by updateCurrentJointToWorldTransforms().
+	// rotations, if given, holds one quaternion per control track (the root
+	// translation's first, then every joint's) and replaces the joint angles.
+	const float *getPose() const;
+	void setControlValues(const float *values, const Quat4f *rotations = NULL);
+	void setControlValue(int control, float value);
+
+	// Extra: set a joint rotation as a quaternion. It is used as is, until the
+	// joint's angles are set again; its Euler angles are only computed when the
+	// pose buffer is read (e.g. to show it on the sliders).
+	void setJointRotation(int jointIndex, const Quat4f &rotation);
+
+	// Extra: incremented whenever the pose buffer changes, so that views of it
+	// (e.g. the sliders) can tell when to refresh
+	unsigned getPoseVersion() const { return m_poseVersion; }
+
 	// Part 2: Skeletal Subspace Deformation
 
 	// 2.3. Implement SSD
@@ -74,8 +87,47 @@ public:
 	// and the current joint --> world transforms.
 	void updateMesh();
 
-	// Extra: get number of joints for the loaded model
-	std::vector<Joint*> getJoints();
+	// Extra: world-space box around the mesh and skeleton in the current pose,
+	// refit from the per-joint boxes by updateCurrentJointToWorldTransforms()
+	const BoundingBox& getBounds() const { return m_bounds; }
+
+	// Extra: whether the mesh lags behind the pose, because updateMesh() was
+	// skipped while the model was culled
+	bool isMeshStale() const { return m_meshStale; }
+
+	// Extra: skin the mesh in the given pose (control values, and optionally
+	// rotations, as for setControlValues()) into separate buffers, without
+	// changing the model. It only reads what is fixed once the model is loaded,
+	// so it can run on another thread while the model is posed and drawn.
+	// jointTransforms is scratch space.
+	void skinPose(const float *values, const Quat4f *rotations, std::vector<Matrix4f> &jointTransforms,
+		std::vector<Vector3f> &vertices, std::vector<Vector3f> &normals) const;
+	// Extra: the same into caller buffers of 3 floats per vertex (and per face
+	// for the normals, which may be NULL), stride bytes apart
+	void skinPose(const float *values, const Quat4f *rotations, std::vector<Matrix4f> &jointTransforms,
+		float *vertices, size_t vertexStride, float *normals, size_t normalStride) const;
+
+	// Extra: skin the current pose as updateMesh() does, but into caller
+	// buffers as for skinPose(), leaving the mesh of the model as it was
+	void skinMesh(float *vertices, size_t vertexStride, float *normals, size_t normalStride);
+
+	// Extra: take vertices and face normals skinned for the current pose (e.g.
+	// by skinPose()) as the mesh, without copying; the buffers of the previous
+	// mesh are returned in their place
+	void swapSkinnedMesh(std::vector<Vector3f> &vertices, std::vector<Vector3f> &normals);
+
+	// Extra: replace the skinned mesh by vertices and face normals computed
+	// earlier for the current pose (e.g. by a VertexCache), instead of updateMesh()
+	void setSkinnedMesh(const Vector3f *vertices, const Vector3f *normals);
+
+	// Extra: get the joints of the loaded model (without copying them)
+	const std::vector<Joint*> &getJoints() const { return m_joints; }
+
+	// Extra: the skinned mesh, for the renderers (the model itself does not draw)
+	const Mesh& getMesh() const { return m_mesh; }
+
+	// Extra: add the bytes of the mesh, the joints and the pose to report
+	void reportMemory( MemoryReport& report ) const;
 
 private:
 
@@ -85,10 +137,47 @@ private:
 	Vector3f m_rootTranslation;
 	// the list of joints.
 	std::vector< Joint* > m_joints;
+	// parent (-1 for the root, otherwise before the joint) and bind translation of every joint
+	std::vector< int > m_jointParents;
+	std::vector< Vector3f > m_jointOffsets;
+
+	// box of every bone, relative to the frame of its parent joint.
+	// It only depends on the skeleton file, so it is computed once at load.
+	std::vector< int > m_boneParents;
+	std::vector< Matrix4f > m_boneFrames;
+
+	// world transforms of the joint spheres and bone boxes in the current pose
+	std::vector< Matrix4f > m_jointInstances;
+	std::vector< Matrix4f > m_boneInstances;
+
+	// the pose buffer, and per joint the quaternion overriding its Euler angles, if any
+	void applyPose();
+	mutable std::vector< float > m_pose;
+	std::vector< Quat4f > m_poseRotations;
+	std::vector< bool > m_poseIsQuaternion;
+	unsigned m_poseVersion = 0;
+	bool m_poseChanged = true;
+	mutable bool m_poseAnglesStale = false;
+
+	// box of every joint, in the joint's bind space. It holds the bind vertices
+	// influenced by the joint, the joint sphere and the boxes of its bones, so
+	// the transformed boxes of all joints bound every pose.
+	void computeJointBounds();
+
+	// blend the bind vertices by the joints' skinning transforms (current joint
+	// to world times bind world to joint)
+	void skinVertices(const std::vector<Matrix4f> &skinningTransforms, std::vector<Vector3f> &vertices) const;
+	void skinVertices(const std::vector<Matrix4f> &skinningTransforms, float *vertices, size_t stride) const;
+	// the skinning transforms of the current pose, or of the given one (see skinPose())
+	void updateSkinningTransforms();
+	void computeSkinningTransforms(const float *values, const Quat4f *rotations,
+		std::vector<Matrix4f> &jointTransforms) const;
+	std::vector< BoundingBox > m_jointBounds;
+	BoundingBox m_bounds;
 
 	Mesh m_mesh;
-
-	MatrixStack m_matrixStack;
+	bool m_meshStale = true;
+	std::vector< Matrix4f > m_skinningTransforms;
 };
 
 #endif
@@ -0,0 +1,64 @@
+#include "SkeletonRenderer.h"
+
+using namespace std;
+
+SkeletonRenderer::SkeletonRenderer()
+	: m_sphereList(0), m_cubeList(0)
+{
+	// The same primitives the skeleton used to draw through GLUT
+	buildSphere(0.025f, 12, 12, m_sphere);
+	buildCube(1.0f, m_cube);
+}
+
+void SkeletonRenderer::invalidate()
+{
+	m_sphereList = m_cubeList = 0;
+}
+
+static void compilePrimitive(const Primitive& primitive)
+{
+	glBegin(GL_TRIANGLES);
+	for (int i = 0, numVertices = primitive.positions.size(); i < numVertices; ++i) {
+		const Vector3f &n = primitive.normals[i], &v = primitive.positions[i];
+		glNormal3f(n[0], n[1], n[2]);
+		glVertex3f(v[0], v[1], v[2]);
+	}
+	glEnd();
+}
+
+void SkeletonRenderer::compileLists()
+{
+	m_sphereList = glGenLists(2);
+	m_cubeList = m_sphereList + 1;
+
+	glNewList(m_sphereList, GL_COMPILE);
+	compilePrimitive(m_sphere);
+	glEndList();
+
+	glNewList(m_cubeList, GL_COMPILE);
+	compilePrimitive(m_cube);
+	glEndList();
+}
+
+void SkeletonRenderer::drawInstances(GLuint list, const Matrix4f& cameraMatrix, const vector<Matrix4f>& instances)
+{
+	for (auto &instance : instances) {
+		glLoadMatrixf(cameraMatrix * instance);
+		glCallList(list);
+	}
+}
+
+void SkeletonRenderer::draw(const Matrix4f& cameraMatrix,
+	const vector<Matrix4f>& jointInstances,
+	const vector<Matrix4f>& boneInstances)
+{
+	// Display lists live in the GL context, so they are built on first use
+	if (m_sphereList == 0)
+		compileLists();
+
+	drawInstances(m_sphereList, cameraMatrix, jointInstances);
+	drawInstances(m_cubeList, cameraMatrix, boneInstances);
+
+	// Revert to the camera matrix for whatever is drawn next
+	glLoadMatrixf(cameraMatrix);
+}
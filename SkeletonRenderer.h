@@ -0,0 +1,42 @@
+#ifndef SKELETON_RENDERER_H
+#define SKELETON_RENDERER_H
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include <vector>
+#include <vecmath.h>
+#include <GL/gl.h>
+
+#include "Primitive.h"
+
+// Draws the joint spheres and bone boxes of all models in a single batch.
+// The primitives are tessellated once and compiled into display lists,
+// so each frame only submits one transform per instance.
+class SkeletonRenderer
+{
+public:
+	SkeletonRenderer();
+
+	// Forget the display lists, e.g. when the GL context has been recreated
+	void invalidate();
+
+	// Draw a sphere for every joint instance and a box for every bone instance.
+	// Instance transforms map primitive space into world space.
+	void draw( const Matrix4f& cameraMatrix,
+		const std::vector< Matrix4f >& jointInstances,
+		const std::vector< Matrix4f >& boneInstances );
+
+private:
+	void compileLists();
+	static void drawInstances( GLuint list, const Matrix4f& cameraMatrix, const std::vector< Matrix4f >& instances );
+
+	Primitive m_sphere;
+	Primitive m_cube;
+
+	GLuint m_sphereList;
+	GLuint m_cubeList;
+};
+
+#endif // SKELETON_RENDERER_H
@@ -0,0 +1,305 @@
+#include "SkinningCheck.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Animation.h"
+#include "PcaVertexAnimation.h"
+#include "RandomPoses.h"
+#include "SkeletalModel.h"
+#include "SkinningPipeline.h"
+#include "VertexCache.h"
+#include "ssd.h"
+
+using namespace std;
+
+
+static void printUsage(const char *program)
+{
+	cout << "Usage: " << program << " --check-skinning [options] [PREFIX1 PREFIX2 ...]" << endl
+		<< "Without models, checks data/Model1..4." << endl
+		<< "Options:" << endl
+		<< "  --poses N           random poses per model (default: 16)" << endl
+		<< "  --seed N            seed of the random poses (default: 1)" << endl
+		<< "  --tolerance D       largest distance allowed from the reference vertices (default: 1e-4)" << endl;
+}
+
+// The skinning loop of SkeletalModel::updateMesh() as it was first written.
+// It is the reference every other path is checked against, so it must not change.
+static void referenceSkin(const SkeletalModel &model, vector<Vector3f> &vertices)
+{
+	const vector<Joint*> &joints = model.getJoints();
+	const Mesh &mesh = model.getMesh();
+	vertices.clear();
+	int numJoints = joints.size();
+
+	for (int i = 0, numVertices = mesh.bindVertices.size(); i < numVertices; ++i) {
+		Vector4f weighted(0.f);
+
+		for (int j = 0; j < numJoints; ++j)
+			weighted = weighted +
+				joints[j]->currentJointToWorldTransform
+				* joints[j]->bindWorldToJointTransform
+				* Vector4f(mesh.bindVertices[i], 1.0f) * mesh.attachments[i][j];
+
+		vertices.push_back(weighted.xyz());
+	}
+}
+
+// Distances between the vertices of a path and of the reference
+struct Deviation
+{
+	double maxDistance = 0;
+	double squaredSum = 0;
+	size_t count = 0;
+
+	void add(const vector<Vector3f> &vertices, const vector<Vector3f> &reference)
+	{
+		// A mesh of the wrong size counts as infinitely far
+		if (vertices.size() != reference.size()) {
+			maxDistance = INFINITY;
+			return;
+		}
+		for (size_t i = 0; i < vertices.size(); ++i) {
+			double squared = (vertices[i] - reference[i]).absSquared();
+			maxDistance = max(maxDistance, sqrt(squared));
+			squaredSum += squared;
+		}
+		count += vertices.size();
+	}
+
+	double rms() const { return count ? sqrt(squaredSum / count) : 0; }
+};
+
+// The paths that are checked, in the order of the report
+enum Path
+{
+	UPDATE_MESH,
+	UPDATE_MESH_QUATERNION,
+	SKIN_POSE,
+	SKIN_POSE_QUATERNION,
+	PIPELINE,
+	VERTEX_CACHE,
+	PCA,
+	C_API_BATCH,
+	C_API_QUATERNION,
+	NUM_PATHS
+};
+
+static const char *PATH_NAMES[NUM_PATHS] = {
+	"updateMesh",
+	"updateMesh (quaternions)",
+	"skinPose",
+	"skinPose (quaternions)",
+	"SkinningPipeline",
+	"VertexCache",
+	"PcaVertexAnimation (all components)",
+	"ssd_model_skin_poses (padded)",
+	"ssd_model_skin (quaternions)"
+};
+
+int runCheckSkinning(int argc, char* argv[])
+{
+	vector<string> prefixes;
+	int numPoses = 16;
+	unsigned seed = 1;
+	double tolerance = 1e-4;
+
+	// argv[1] is "--check-skinning" itself
+	for (int i = 2; i < argc; ++i) {
+		string arg = argv[i];
+		int remaining = argc - i - 1;
+		if (arg == "--poses" && remaining >= 1)
+			numPoses = max(atoi(argv[++i]), 1);
+		else if (arg == "--seed" && remaining >= 1)
+			seed = (unsigned) atol(argv[++i]);
+		else if (arg == "--tolerance" && remaining >= 1)
+			tolerance = max(atof(argv[++i]), 0.0);
+		else if (arg.compare(0, 2, "--") == 0) {
+			cerr << "Error: unknown or incomplete option " << arg << endl;
+			printUsage(argv[0]);
+			return -1;
+		}
+		else
+			prefixes.push_back(arg);
+	}
+	if (prefixes.empty())
+		for (int m = 1; m <= 4; ++m)
+			prefixes.push_back("data/Model" + to_string(m));
+
+	int numModels = prefixes.size();
+	vector<SkeletalModel> models(numModels);
+	for (int m = 0; m < numModels; ++m) {
+		models[m].load(prefixes[m]);
+		if (models[m].getJoints().empty()) {
+			cerr << "Error: couldn't load " << prefixes[m] << endl;
+			return -1;
+		}
+	}
+
+	// Random poses within the slider ranges, as Euler angles and as quaternions,
+	// for all models one after the other (the layout of SkinningPipeline::submit())
+	RandomPoses random(seed);
+	vector<int> controlOffsets;
+	int numControls = 0;
+	for (const SkeletalModel &model : models) {
+		controlOffsets.push_back(numControls);
+		numControls += model.getNumControls();
+	}
+	vector<float> poses(numPoses * numControls);
+	vector<Quat4f> rotations(numPoses * numControls / 3);
+	for (int p = 0; p < numPoses; ++p)
+		for (int m = 0; m < numModels; ++m) {
+			int offset = p * numControls + controlOffsets[m];
+			random.next(models[m], &poses[offset]);
+			for (int c = 0, modelControls = models[m].getNumControls(); c < modelControls; c += 3)
+				rotations[(offset + c) / 3] = c == 0 ? Quat4f::IDENTITY : eulerToQuaternion(&poses[offset + c]);
+		}
+
+	vector<vector<Deviation>> deviations(numModels, vector<Deviation>(NUM_PATHS));
+	vector<vector<Vector3f>> references(numModels * numPoses);
+	vector<vector<Vector3f>> skinnedFrames(numModels);
+	vector<Matrix4f> jointTransforms;
+	vector<Vector3f> vertices, normals;
+
+	VertexCache cache;
+	cache.create(models, numPoses, VertexCache::requiredBytes(models, numPoses));
+	SkinningPipeline pipeline;
+
+	for (int p = 0; p < numPoses; ++p) {
+		const float *pose = &poses[p * numControls];
+		const Quat4f *poseRotations = &rotations[p * numControls / 3];
+
+		for (int m = 0; m < numModels; ++m) {
+			SkeletalModel &model = models[m];
+			const float *values = pose + controlOffsets[m];
+			const Quat4f *modelRotations = poseRotations + controlOffsets[m] / 3;
+			vector<Vector3f> &reference = references[m * numPoses + p];
+
+			model.setControlValues(values);
+			model.updateCurrentJointToWorldTransforms();
+			referenceSkin(model, reference);
+
+			model.updateMesh();
+			deviations[m][UPDATE_MESH].add(model.getMesh().currentVertices, reference);
+			cache.store(p, m, model.getMesh());
+			skinnedFrames[m].insert(skinnedFrames[m].end(), model.getMesh().currentVertices.begin(),
+				model.getMesh().currentVertices.end());
+
+			model.setControlValues(values, modelRotations);
+			model.updateCurrentJointToWorldTransforms();
+			model.updateMesh();
+			deviations[m][UPDATE_MESH_QUATERNION].add(model.getMesh().currentVertices, reference);
+
+			model.skinPose(values, NULL, jointTransforms, vertices, normals);
+			deviations[m][SKIN_POSE].add(vertices, reference);
+			model.skinPose(values, modelRotations, jointTransforms, vertices, normals);
+			deviations[m][SKIN_POSE_QUATERNION].add(vertices, reference);
+		}
+
+		// All models at once, on the pipeline's threads
+		pipeline.submit(models, p, pose, poseRotations);
+		bool presented = pipeline.present(models, p);
+		for (int m = 0; m < numModels; ++m)
+			deviations[m][PIPELINE].add(presented ? models[m].getMesh().currentVertices : vector<Vector3f>(),
+				references[m * numPoses + p]);
+	}
+
+	// The cached frames and the compressed ones, after all poses were skinned
+	for (int m = 0; m < numModels; ++m) {
+		int numVertices = models[m].getMesh().bindVertices.size();
+		PcaVertexAnimation pca;
+		pca.build(skinnedFrames[m], numPoses, numVertices, numPoses);
+		for (int p = 0; p < numPoses; ++p) {
+			const vector<Vector3f> &reference = references[m * numPoses + p];
+			if (cache.contains(p, m)) {
+				cache.load(p, m, models[m]);
+				deviations[m][VERTEX_CACHE].add(models[m].getMesh().currentVertices, reference);
+			}
+			else
+				deviations[m][VERTEX_CACHE].add(vector<Vector3f>(), reference);
+			pca.reconstruct(p, vertices);
+			deviations[m][PCA].add(vertices, reference);
+		}
+	}
+
+	// The C API, on its own instance of every model. The batch reads the poses in the
+	// layout of all models, and writes vertices and normals padded to 4 floats.
+	for (int m = 0; m < numModels; ++m) {
+		ssd_model *model = ssd_model_load(prefixes[m].c_str());
+		if (!model) {
+			cerr << "Error: " << ssd_last_error() << endl;
+			deviations[m][C_API_BATCH].add(vector<Vector3f>(), references[m * numPoses]);
+			deviations[m][C_API_QUATERNION].add(vector<Vector3f>(), references[m * numPoses]);
+			continue;
+		}
+		int numVertices = ssd_model_num_vertices(model), numJoints = ssd_model_num_joints(model);
+		size_t stride = 4 * sizeof(float), vertexPoseStride = numVertices * stride,
+			normalPoseStride = ssd_model_num_faces(model) * stride;
+		vector<float> padded(numPoses * vertexPoseStride / sizeof(float)),
+			paddedNormals(numPoses * normalPoseStride / sizeof(float));
+		ssd_model_set_threads(model, 0);
+		ssd_status status = ssd_model_skin_poses(model, numPoses, SSD_EULER_XYZ, &poses[controlOffsets[m]],
+			numControls * sizeof(float), &padded[0], stride, vertexPoseStride, &paddedNormals[0], stride,
+			normalPoseStride);
+
+		vector<float> quaternionPose(ssd_model_pose_size(model, SSD_QUATERNION));
+		for (int p = 0; p < numPoses; ++p) {
+			const vector<Vector3f> &reference = references[m * numPoses + p];
+			vertices.clear();
+			for (int v = 0; v < numVertices && status == SSD_OK; ++v) {
+				const float *vertex = &padded[(p * vertexPoseStride + v * stride) / sizeof(float)];
+				vertices.push_back(Vector3f(vertex[0], vertex[1], vertex[2]));
+			}
+			deviations[m][C_API_BATCH].add(vertices, reference);
+
+			const float *values = &poses[p * numControls + controlOffsets[m]];
+			const Quat4f *modelRotations = &rotations[(p * numControls + controlOffsets[m]) / 3];
+			copy(values, values + 3, quaternionPose.begin());
+			for (int j = 0; j < numJoints; ++j)
+				for (int k = 0; k < 4; ++k)
+					quaternionPose[3 + 4 * j + k] = modelRotations[j + 1][k];
+			vertices.resize(numVertices);
+			normals.resize(ssd_model_num_faces(model));
+			if (ssd_model_set_pose(model, SSD_QUATERNION, quaternionPose.data()) != SSD_OK
+				|| ssd_model_skin(model, vertices[0], sizeof(Vector3f), normals[0], sizeof(Vector3f)) != SSD_OK)
+				vertices.clear();
+			deviations[m][C_API_QUATERNION].add(vertices, reference);
+		}
+		ssd_model_free(model);
+	}
+
+	int numFailed = 0;
+	cout << "Deviation from the reference skinning over " << numPoses << " poses (seed " << seed
+		<< ", tolerance " << tolerance << "):" << endl;
+	// The name columns fit the longest name, plus a gap
+	size_t modelWidth = string("Model").size(), pathWidth = string("Path").size();
+	for (const string &prefix : prefixes)
+		modelWidth = max(modelWidth, prefix.size());
+	for (const char *name : PATH_NAMES)
+		pathWidth = max(pathWidth, string(name).size());
+	modelWidth += 2;
+	pathWidth += 2;
+	cout << left << setw(modelWidth) << "Model" << setw(pathWidth) << "Path" << setw(14) << "Max" << setw(14) << "RMS"
+		<< endl;
+	for (int m = 0; m < numModels; ++m)
+		for (int path = 0; path < NUM_PATHS; ++path) {
+			const Deviation &deviation = deviations[m][path];
+			bool failed = !(deviation.maxDistance <= tolerance);
+			numFailed += failed;
+			cout << setw(modelWidth) << prefixes[m] << setw(pathWidth) << PATH_NAMES[path] << setw(14) << deviation.maxDistance
+				<< setw(14) << deviation.rms() << (failed ? "FAILED" : "ok") << endl;
+		}
+
+	if (numFailed > 0) {
+		cout << numFailed << " of " << numModels * NUM_PATHS << " checks FAILED" << endl;
+		return 1;
+	}
+	cout << "All " << numModels * NUM_PATHS << " checks passed" << endl;
+	return 0;
+}
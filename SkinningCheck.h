@@ -0,0 +1,10 @@
+#ifndef SKINNING_CHECK_H
+#define SKINNING_CHECK_H
+
+// Entry point of "a3 --check-skinning ...": skin the models in random poses
+// through every skinning path and compare them, vertex by vertex, with the
+// skinning loop as first written. Returns non-zero if any path deviates more
+// than the tolerance.
+int runCheckSkinning(int argc, char* argv[]);
+
+#endif // SKINNING_CHECK_H
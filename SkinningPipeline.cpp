@@ -0,0 +1,126 @@
+#include "SkinningPipeline.h"
+#include "Trace.h"
+
+#include <algorithm>
+
+using namespace std;
+
+SkinningPipeline::SkinningPipeline(int numThreads)
+	: m_numThreads(numThreads), m_stop(false), m_busy(false), m_pending(false), m_models(NULL), m_frame(0)
+{
+	// The task is made once, so that frames do not allocate
+	m_skinModel = [this](int m) {
+		TraceSpan span("skin model ahead", "model", m);
+		ModelFrame &frame = m_frames[m];
+		(*m_models)[m].skinPose(frame.values.data(), frame.rotations.data(), frame.jointTransforms,
+			frame.vertices, frame.normals);
+	};
+}
+
+SkinningPipeline::~SkinningPipeline()
+{
+	{
+		unique_lock<mutex> lock(m_mutex);
+		waitIdle(lock);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	if (m_worker.joinable())
+		m_worker.join();
+}
+
+void SkinningPipeline::waitIdle(unique_lock<mutex> &lock)
+{
+	m_done.wait(lock, [this] { return !m_busy; });
+}
+
+void SkinningPipeline::submit(const vector<SkeletalModel> &models, unsigned frame, const float *values,
+	const Quat4f *rotations)
+{
+	// The threads are only started by the first frame
+	if (!m_worker.joinable()) {
+		m_pool.reset(new ThreadPool(m_numThreads));
+		m_worker = thread(&SkinningPipeline::workerLoop, this);
+	}
+
+	unique_lock<mutex> lock(m_mutex);
+	waitIdle(lock);
+
+	// Copy the pose of every model; the caller may reuse its buffers right away
+	int numModels = models.size();
+	m_frames.resize(numModels);
+	for (int m = 0; m < numModels; ++m) {
+		int numControls = models[m].getNumControls();
+		m_frames[m].values.assign(values, values + numControls);
+		m_frames[m].rotations.assign(rotations, rotations + numControls / 3);
+		values += numControls;
+		rotations += numControls / 3;
+	}
+
+	m_models = &models;
+	m_frame = frame;
+	m_pending = true;
+	m_busy = true;
+	lock.unlock();
+	m_wake.notify_one();
+}
+
+bool SkinningPipeline::present(vector<SkeletalModel> &models, unsigned frame)
+{
+	unique_lock<mutex> lock(m_mutex);
+	if (!m_pending || m_frame != frame || m_models != &models)
+		return false;
+	TraceSpan span("present frame ahead", "frame", frame);
+	waitIdle(lock);
+	m_pending = false;
+
+	// The skeletons follow the pose as usual; the meshes come from the back buffers
+	for (int m = 0, numModels = models.size(); m < numModels; ++m) {
+		ModelFrame &back = m_frames[m];
+		models[m].setControlValues(back.values.data(), back.rotations.data());
+		models[m].updateCurrentJointToWorldTransforms();
+		models[m].swapSkinnedMesh(back.vertices, back.normals);
+	}
+	return true;
+}
+
+void SkinningPipeline::cancel()
+{
+	unique_lock<mutex> lock(m_mutex);
+	waitIdle(lock);
+	m_pending = false;
+}
+
+void SkinningPipeline::workerLoop()
+{
+	Trace::setThreadName("skinning pipeline");
+	unique_lock<mutex> lock(m_mutex);
+	for (;;) {
+		m_wake.wait(lock, [this] { return m_stop || m_busy; });
+		if (m_stop)
+			return;
+
+		// The buffers of the frame belong to this thread until it is done
+		lock.unlock();
+		m_pool->parallelFor(m_frames.size(), m_skinModel);
+		lock.lock();
+
+		m_busy = false;
+		m_done.notify_all();
+	}
+}
+
+void SkinningPipeline::reportMemory(MemoryReport &report)
+{
+	// The worker owns the buffers while it skins a frame
+	unique_lock<mutex> lock(m_mutex);
+	waitIdle(lock);
+	for (const ModelFrame &frame : m_frames) {
+		report.add("poses", frame.values);
+		report.add("poses", frame.rotations);
+		report.add("joint transforms", frame.jointTransforms);
+		report.add("back buffers", frame.vertices);
+		report.add("back buffers", frame.normals);
+	}
+	report.add("poses", m_frames);
+}
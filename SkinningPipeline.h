@@ -0,0 +1,77 @@
+#ifndef SKINNING_PIPELINE_H
+#define SKINNING_PIPELINE_H
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "SkeletalModel.h"
+#include "ThreadPool.h"
+
+// Skins the next frame of an animation on worker threads while the current
+// one is drawn, so that a frame costs about max(skin, draw) instead of
+// skin + draw.
+//
+// Every model has a back mesh (vertices and face normals) next to the one it
+// draws. A frame is skinned into the back meshes by SkeletalModel::skinPose(),
+// which does not touch the models, and present() swaps them in once the frame
+// is due. Only one frame is in flight at a time.
+class SkinningPipeline
+{
+public:
+	// numThreads counts the background thread that runs the frames; 0 means one per hardware thread
+	explicit SkinningPipeline( int numThreads = 0 );
+	~SkinningPipeline();
+
+	// Start skinning the models in the pose of a frame. values holds the
+	// controls of all models one after the other (like
+	// ViewState::setControlValues()) and rotations one quaternion per 3 of
+	// them. Waits for the frame in flight, if any, which is dropped.
+	void submit( const std::vector< SkeletalModel >& models, unsigned frame,
+		const float *values, const Quat4f *rotations );
+
+	// If frame is the frame in flight, wait for it, then pose the models and
+	// swap in its meshes. Returns false, and changes nothing, otherwise.
+	bool present( std::vector< SkeletalModel >& models, unsigned frame );
+
+	// Wait for the frame in flight, if any, and drop it
+	void cancel();
+
+	// Add the poses and back buffers of the models to report
+	void reportMemory( MemoryReport& report );
+
+private:
+	// The pose of a model and the back buffers it is skinned into
+	struct ModelFrame
+	{
+		std::vector< float > values;
+		std::vector< Quat4f > rotations;
+		std::vector< Matrix4f > jointTransforms;
+		std::vector< Vector3f > vertices;
+		std::vector< Vector3f > normals;
+	};
+
+	void workerLoop();
+	void waitIdle( std::unique_lock< std::mutex >& lock );
+
+	int m_numThreads;
+	std::unique_ptr< ThreadPool > m_pool;
+	std::thread m_worker;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	bool m_stop;
+	bool m_busy;		// the worker is skinning a frame
+	bool m_pending;		// a frame was submitted and not presented or dropped
+
+	const std::vector< SkeletalModel > *m_models;
+	unsigned m_frame;
+	std::vector< ModelFrame > m_frames;
+	std::function< void( int ) > m_skinModel;
+};
+
+#endif // SKINNING_PIPELINE_H
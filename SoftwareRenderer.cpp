@@ -0,0 +1,403 @@
+#include "SoftwareRenderer.h"
+#include "camera.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOFTWARE_RENDERER_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// The lighting set up by SceneRenderer, and the GL defaults it relies on
+static const Vector3f LIGHT_POSITION(3, 3, 5);	// in eye space
+static const float GLOBAL_AMBIENT = 0.2f;
+static const float MATERIAL_DIFFUSE = 0.4f;		// and ambient
+static const float MATERIAL_SPECULAR = 0.6f;
+static const float MATERIAL_SHININESS = 50.0f;
+
+// Work items per chunk when setting up triangles in parallel
+static const int VERTICES_PER_CHUNK = 4096;
+static const int FACES_PER_CHUNK = 2048;
+
+// Per-vertex fixed-function lighting with an infinite viewer
+static Vector3f shade(const Vector3f &eyePosition, const Vector3f &eyeNormal, const Vector3f &diffuse)
+{
+	// GL_COLOR_MATERIAL tracks both the ambient and the diffuse color
+	Vector3f color = GLOBAL_AMBIENT * diffuse;
+
+	float length = eyeNormal.abs();
+	if (length > 0) {
+		Vector3f n = eyeNormal / length,
+			l = (LIGHT_POSITION - eyePosition).normalized();
+		float nDotL = Vector3f::dot(n, l);
+		if (nDotL > 0) {
+			Vector3f h = (l + Vector3f(0, 0, 1)).normalized();
+			float specular = MATERIAL_SPECULAR * pow(max(Vector3f::dot(n, h), 0.f), MATERIAL_SHININESS);
+			color += nDotL * diffuse + Vector3f(specular);
+		}
+	}
+
+	for (int k = 0; k < 3; ++k)
+		color[k] = min(max(color[k], 0.f), 1.f);
+	return color;
+}
+
+static inline unsigned char toByte(float c)
+{
+	return (unsigned char) (min(max(c, 0.f), 1.f) * 255 + 0.5f);
+}
+
+SoftwareRenderer::SoftwareRenderer(int numThreads)
+	: m_pool(numThreads), m_w(0), m_h(0), m_tilesX(0), m_tilesY(0)
+{
+	// The same primitives as SkeletonRenderer
+	buildSphere(0.025f, 12, 12, m_sphere);
+	buildCube(1.0f, m_cube);
+}
+
+void SoftwareRenderer::setup(Camera& camera, int w, int h)
+{
+	camera.SetDimensions( w, h );
+	camera.SetViewport( 0, 0, w, h );
+	camera.SetPerspective( 50.0f );
+	m_projection = camera.projectionMatrix();
+
+	m_w = w;
+	m_h = h;
+	m_tilesX = (w + TILE_SIZE - 1) / TILE_SIZE;
+	m_tilesY = (h + TILE_SIZE - 1) / TILE_SIZE;
+	m_bins.resize(m_tilesX * m_tilesY);
+
+	m_color.assign(3 * w * h, 0);
+	// Padded, so that a 4-wide depth load at the end of the last row stays in bounds
+	m_depth.assign(w * h + 4, 1.f);
+}
+
+void SoftwareRenderer::draw(Camera& camera, vector<SkeletalModel>& models, bool drawAxes, bool drawSkeleton, bool drawColor)
+{
+	fill(m_color.begin(), m_color.end(), 0);
+	fill(m_depth.begin(), m_depth.end(), 1.f);
+	m_triangles.clear();
+
+	Matrix4f viewMatrix = camera.viewMatrix();
+	Frustum frustum(m_projection * viewMatrix);
+
+	if (drawSkeleton) {
+		m_jointInstances.clear();
+		m_boneInstances.clear();
+		for (auto &model : models)
+			if (frustum.intersects(model.getBounds()))
+				model.getSkeletonInstances(m_jointInstances, m_boneInstances);
+		drawPrimitive(viewMatrix, m_sphere, m_jointInstances);
+		drawPrimitive(viewMatrix, m_cube, m_boneInstances);
+	}
+	else {
+		for (auto &model : models) {
+			if (!frustum.intersects(model.getBounds()))
+				continue;
+			if (model.isMeshStale())
+				model.updateMesh();
+			drawMesh(viewMatrix, model.getMesh(), drawColor);
+		}
+	}
+
+	rasterize();
+
+	// The axes are unlit lines, depth-tested against the models
+	if (drawAxes) {
+		drawLine(viewMatrix, Vector3f(0, 0, 0), Vector3f(1, 0, 0), Vector3f(1, 0, 0));
+		drawLine(viewMatrix, Vector3f(0, 0, 0), Vector3f(0, 1, 0), Vector3f(0, 1, 0));
+		drawLine(viewMatrix, Vector3f(0, 0, 0), Vector3f(0, 0, 1), Vector3f(0, 0, 1));
+	}
+}
+
+void SoftwareRenderer::setupChunks(int numChunks, const function<void(int, vector<RasterTriangle>&)> &setup)
+{
+	if ((int) m_chunks.size() < numChunks)
+		m_chunks.resize(numChunks);
+
+	m_pool.parallelFor(numChunks, [&](int chunk) {
+		m_chunks[chunk].clear();
+		setup(chunk, m_chunks[chunk]);
+	});
+
+	for (int chunk = 0; chunk < numChunks; ++chunk)
+		m_triangles.insert(m_triangles.end(), m_chunks[chunk].begin(), m_chunks[chunk].end());
+}
+
+void SoftwareRenderer::drawMesh(const Matrix4f& viewMatrix, const Mesh& mesh, bool drawColor)
+{
+	// Transform every vertex once, then light each face with its own normal
+	int numVertices = mesh.currentVertices.size();
+	m_eyePositions.resize(numVertices);
+	m_clipPositions.resize(numVertices);
+	m_pool.parallelFor((numVertices + VERTICES_PER_CHUNK - 1) / VERTICES_PER_CHUNK, [&](int chunk) {
+		for (int i = chunk * VERTICES_PER_CHUNK, end = min(i + VERTICES_PER_CHUNK, numVertices); i < end; ++i) {
+			Vector4f eye = viewMatrix * Vector4f(mesh.currentVertices[i], 1.f);
+			m_eyePositions[i] = eye.xyz();
+			m_clipPositions[i] = m_projection * eye;
+		}
+	});
+
+	Matrix3f normalMatrix = viewMatrix.getSubmatrix3x3(0, 0).inverse().transposed();
+	int numFaces = mesh.faces.size();
+	setupChunks((numFaces + FACES_PER_CHUNK - 1) / FACES_PER_CHUNK, [&](int chunk, vector<RasterTriangle>& out) {
+		for (int f = chunk * FACES_PER_CHUNK, end = min(f + FACES_PER_CHUNK, numFaces); f < end; ++f) {
+			int index[3] = { (int) mesh.faces[f][0] - 1, (int) mesh.faces[f][1] - 1, (int) mesh.faces[f][2] - 1 };
+			Vector3f normal = normalMatrix * mesh.currentNormals[f];
+
+			ClipVertex v[3];
+			for (int k = 0; k < 3; ++k) {
+				Vector3f diffuse = drawColor ? mesh.vertexColors[index[k]] : Vector3f(MATERIAL_DIFFUSE);
+				v[k].position = m_clipPositions[index[k]];
+				v[k].color = shade(m_eyePositions[index[k]], normal, diffuse);
+			}
+			setupTriangle(v, out);
+		}
+	});
+}
+
+void SoftwareRenderer::drawPrimitive(const Matrix4f& viewMatrix, const Primitive& primitive, const vector<Matrix4f>& instances)
+{
+	setupChunks(instances.size(), [&](int instance, vector<RasterTriangle>& out) {
+		Matrix4f modelView = viewMatrix * instances[instance];
+		Matrix3f normalMatrix = modelView.getSubmatrix3x3(0, 0).inverse().transposed();
+
+		for (int i = 0, numVertices = primitive.positions.size(); i + 2 < numVertices; i += 3) {
+			ClipVertex v[3];
+			for (int k = 0; k < 3; ++k) {
+				Vector4f eye = modelView * Vector4f(primitive.positions[i + k], 1.f);
+				v[k].position = m_projection * eye;
+				v[k].color = shade(eye.xyz(), normalMatrix * primitive.normals[i + k], Vector3f(MATERIAL_DIFFUSE));
+			}
+			setupTriangle(v, out);
+		}
+	});
+}
+
+void SoftwareRenderer::setupTriangle(const ClipVertex* v, vector<RasterTriangle>& out)
+{
+	// Only the near plane needs clipping: after it w > 0, and the
+	// other planes are handled by clamping to the viewport and depth testing
+	auto inside = [](const ClipVertex &p) { return p.position[2] + p.position[3] >= 0; };
+	int numInside = inside(v[0]) + inside(v[1]) + inside(v[2]);
+	if (numInside == 3) {
+		addTriangle(v[0], v[1], v[2], out);
+		return;
+	}
+	if (numInside == 0)
+		return;
+
+	// Sutherland-Hodgman against z + w >= 0
+	ClipVertex polygon[4];
+	int numPoints = 0;
+	for (int i = 0; i < 3; ++i) {
+		const ClipVertex &a = v[i], &b = v[(i + 1) % 3];
+		float da = a.position[2] + a.position[3], db = b.position[2] + b.position[3];
+		if (da >= 0)
+			polygon[numPoints++] = a;
+		if ((da >= 0) != (db >= 0)) {
+			float t = da / (da - db);
+			polygon[numPoints].position = a.position + t * (b.position - a.position);
+			polygon[numPoints].color = a.color + t * (b.color - a.color);
+			++numPoints;
+		}
+	}
+	for (int i = 1; i + 1 < numPoints; ++i)
+		addTriangle(polygon[0], polygon[i], polygon[i + 1], out);
+}
+
+void SoftwareRenderer::addTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, vector<RasterTriangle>& out)
+{
+	const ClipVertex *v[3] = { &a, &b, &c };
+	float x[3], y[3];
+	RasterTriangle t;
+
+	// Perspective divide and viewport transform
+	for (int k = 0; k < 3; ++k) {
+		const Vector4f &p = v[k]->position;
+		t.invW[k] = 1.f / p[3];
+		x[k] = (p[0] * t.invW[k] + 1) * 0.5f * m_w;
+		y[k] = (p[1] * t.invW[k] + 1) * 0.5f * m_h;
+		t.z[k] = (p[2] * t.invW[k] + 1) * 0.5f;
+		t.color[k] = v[k]->color;
+	}
+
+	// No face culling: make every triangle counter-clockwise
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (area == 0 || !(fabs(area) < 1e30f))
+		return;
+	if (area < 0) {
+		swap(x[1], x[2]);
+		swap(y[1], y[2]);
+		swap(t.z[1], t.z[2]);
+		swap(t.invW[1], t.invW[2]);
+		swap(t.color[1], t.color[2]);
+		area = -area;
+	}
+
+	// Pixels whose centers fall inside the bounding box, clamped to the viewport
+	t.minX = max((int) ceil(min({ x[0], x[1], x[2] }) - 0.5f), 0);
+	t.minY = max((int) ceil(min({ y[0], y[1], y[2] }) - 0.5f), 0);
+	t.maxX = min((int) floor(max({ x[0], x[1], x[2] }) - 0.5f), m_w - 1);
+	t.maxY = min((int) floor(max({ y[0], y[1], y[2] }) - 0.5f), m_h - 1);
+	if (t.minX > t.maxX || t.minY > t.maxY)
+		return;
+
+	for (int i = 0; i < 3; ++i) {
+		int j = (i + 1) % 3, k = (i + 2) % 3;
+		float edgeA = -(y[k] - y[j]), edgeB = x[k] - x[j];
+		// Consistent tie-breaking, so pixels on a shared edge are drawn exactly once
+		t.topLeft[i] = edgeA > 0 || (edgeA == 0 && edgeB < 0);
+		t.edgeA[i] = edgeA / area;
+		t.edgeB[i] = edgeB / area;
+		t.edgeC[i] = (-edgeB * y[j] - edgeA * x[j]) / area;
+	}
+	out.push_back(t);
+}
+
+void SoftwareRenderer::rasterize()
+{
+	// Bin the triangles into the tiles they overlap
+	for (auto &bin : m_bins)
+		bin.clear();
+	for (int i = 0, numTriangles = m_triangles.size(); i < numTriangles; ++i) {
+		const RasterTriangle &t = m_triangles[i];
+		for (int ty = t.minY / TILE_SIZE; ty <= t.maxY / TILE_SIZE; ++ty)
+			for (int tx = t.minX / TILE_SIZE; tx <= t.maxX / TILE_SIZE; ++tx)
+				m_bins[ty * m_tilesX + tx].push_back(i);
+	}
+
+	// Tiles own disjoint pixels, so they can be rasterized independently
+	m_pool.parallelFor(m_tilesX * m_tilesY, [this](int tile) { rasterizeTile(tile); });
+}
+
+// Write one fragment that passed the depth test
+static inline void writeFragment(unsigned char *color, float *depth, float z,
+	const SoftwareRenderer::RasterTriangle &t, float b0, float b1, float b2)
+{
+	// Perspective-correct weights
+	float q0 = b0 * t.invW[0], q1 = b1 * t.invW[1], q2 = b2 * t.invW[2],
+		norm = 1.f / (q0 + q1 + q2);
+	q0 *= norm;
+	q1 *= norm;
+	q2 *= norm;
+
+	*depth = z;
+	for (int k = 0; k < 3; ++k)
+		color[k] = toByte(q0 * t.color[0][k] + q1 * t.color[1][k] + q2 * t.color[2][k]);
+}
+
+void SoftwareRenderer::rasterizeTile(int tile)
+{
+	int tileX0 = (tile % m_tilesX) * TILE_SIZE, tileY0 = (tile / m_tilesX) * TILE_SIZE,
+		tileX1 = min(tileX0 + TILE_SIZE, m_w) - 1, tileY1 = min(tileY0 + TILE_SIZE, m_h) - 1;
+
+	for (int index : m_bins[tile]) {
+		const RasterTriangle &t = m_triangles[index];
+		int x0 = max(t.minX, tileX0), x1 = min(t.maxX, tileX1),
+			y0 = max(t.minY, tileY0), y1 = min(t.maxY, tileY1);
+
+		for (int y = y0; y <= y1; ++y) {
+			float py = y + 0.5f;
+			unsigned char *colorRow = &m_color[3 * y * m_w];
+			float *depthRow = &m_depth[y * m_w];
+			int x = x0;
+
+#ifdef SOFTWARE_RENDERER_SSE2
+			// Four pixels of the row at a time
+			__m128 zero = _mm_setzero_ps(), lanes = _mm_set_ps(3, 2, 1, 0);
+			__m128 e[3], step[3], topLeft[3];
+			for (int i = 0; i < 3; ++i) {
+				__m128 px = _mm_add_ps(_mm_set1_ps(x0 + 0.5f), lanes);
+				e[i] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.edgeA[i]), px), _mm_set1_ps(t.edgeB[i] * py + t.edgeC[i]));
+				step[i] = _mm_set1_ps(4 * t.edgeA[i]);
+				topLeft[i] = _mm_castsi128_ps(_mm_set1_epi32(t.topLeft[i] ? -1 : 0));
+			}
+			__m128 z0 = _mm_set1_ps(t.z[0]), z1 = _mm_set1_ps(t.z[1]), z2 = _mm_set1_ps(t.z[2]);
+
+			for (; x <= x1; x += 4) {
+				__m128 mask = _mm_cmplt_ps(lanes, _mm_set1_ps((float) (x1 - x + 1)));
+				for (int i = 0; i < 3; ++i)
+					mask = _mm_and_ps(mask, _mm_or_ps(_mm_cmpgt_ps(e[i], zero),
+						_mm_and_ps(_mm_cmpeq_ps(e[i], zero), topLeft[i])));
+
+				if (_mm_movemask_ps(mask)) {
+					__m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e[0], z0), _mm_mul_ps(e[1], z1)), _mm_mul_ps(e[2], z2));
+					// Pixels past the tile belong to another thread, so the last group only reads its own
+					__m128 depth;
+					if (x + 3 <= x1)
+						depth = _mm_loadu_ps(depthRow + x);
+					else {
+						float tail[4] = { 0, 0, 0, 0 };
+						for (int lane = 0; x + lane <= x1; ++lane)
+							tail[lane] = depthRow[x + lane];
+						depth = _mm_loadu_ps(tail);
+					}
+					int pass = _mm_movemask_ps(_mm_and_ps(mask, _mm_cmplt_ps(z, depth)));
+					if (pass) {
+						float zs[4], b[3][4];
+						_mm_storeu_ps(zs, z);
+						for (int i = 0; i < 3; ++i)
+							_mm_storeu_ps(b[i], e[i]);
+						for (int lane = 0; lane < 4; ++lane)
+							if (pass & (1 << lane))
+								writeFragment(colorRow + 3 * (x + lane), depthRow + x + lane, zs[lane],
+									t, b[0][lane], b[1][lane], b[2][lane]);
+					}
+				}
+				for (int i = 0; i < 3; ++i)
+					e[i] = _mm_add_ps(e[i], step[i]);
+			}
+#endif
+
+			// Scalar path (and the only one without SSE2)
+			for (; x <= x1; ++x) {
+				float px = x + 0.5f, b[3];
+				bool covered = true;
+				for (int i = 0; i < 3; ++i) {
+					b[i] = t.edgeA[i] * px + t.edgeB[i] * py + t.edgeC[i];
+					covered = covered && (b[i] > 0 || (b[i] == 0 && t.topLeft[i]));
+				}
+				if (!covered)
+					continue;
+				float z = b[0] * t.z[0] + b[1] * t.z[1] + b[2] * t.z[2];
+				if (z < depthRow[x])
+					writeFragment(colorRow + 3 * x, depthRow + x, z, t, b[0], b[1], b[2]);
+			}
+		}
+	}
+}
+
+void SoftwareRenderer::drawLine(const Matrix4f& viewMatrix, const Vector3f& from, const Vector3f& to, const Vector3f& color)
+{
+	Vector4f a = m_projection * viewMatrix * Vector4f(from, 1.f),
+		b = m_projection * viewMatrix * Vector4f(to, 1.f);
+
+	// Clip against the near plane
+	float da = a[2] + a[3], db = b[2] + b[3];
+	if (da < 0 && db < 0)
+		return;
+	if (da < 0)
+		a = a + (da / (da - db)) * (b - a);
+	else if (db < 0)
+		b = b + (db / (db - da)) * (a - b);
+
+	float ax = (a[0] / a[3] + 1) * 0.5f * m_w, ay = (a[1] / a[3] + 1) * 0.5f * m_h, az = (a[2] / a[3] + 1) * 0.5f,
+		bx = (b[0] / b[3] + 1) * 0.5f * m_w, by = (b[1] / b[3] + 1) * 0.5f * m_h, bz = (b[2] / b[3] + 1) * 0.5f;
+
+	int steps = (int) ceil(max(fabs(bx - ax), fabs(by - ay)));
+	for (int s = 0; s <= steps; ++s) {
+		float u = steps > 0 ? (float) s / steps : 0.f;
+		int x = (int) floor(ax + u * (bx - ax)), y = (int) floor(ay + u * (by - ay));
+		float z = az + u * (bz - az);
+		if (x < 0 || x >= m_w || y < 0 || y >= m_h || !(z < m_depth[y * m_w + x]))
+			continue;
+		m_depth[y * m_w + x] = z;
+		for (int k = 0; k < 3; ++k)
+			m_color[3 * (y * m_w + x) + k] = toByte(color[k]);
+	}
+}
@@ -0,0 +1,96 @@
+#ifndef SOFTWARE_RENDERER_H
+#define SOFTWARE_RENDERER_H
+
+#include <functional>
+#include <vector>
+#include <vecmath.h>
+
+#include "SkeletalModel.h"
+#include "Primitive.h"
+#include "ThreadPool.h"
+
+class Camera;
+
+// A pure-CPU replacement for SceneRenderer, for machines without a GPU.
+// It reproduces the fixed-function GL pipeline of the viewer: per-vertex
+// lighting with the camera-fixed light, depth testing and perspective-correct
+// color interpolation. Triangles are binned into screen tiles and the tiles
+// are rasterized in parallel, using SSE2 edge functions where available.
+class SoftwareRenderer
+{
+public:
+	// numThreads as for ThreadPool (0: one per hardware thread)
+	explicit SoftwareRenderer(int numThreads = 0);
+
+	// Same as SceneRenderer::setup(), sizing the framebuffer to w x h
+	void setup( Camera& camera, int w, int h );
+
+	// Same as SceneRenderer::draw(), culling included; drawColor replaces GL_COLOR_MATERIAL
+	void draw( Camera& camera, std::vector< SkeletalModel >& models, bool drawAxes, bool drawSkeleton, bool drawColor );
+
+	// Bottom-up RGB rows, like glReadPixels( GL_RGB, GL_UNSIGNED_BYTE )
+	const unsigned char *pixels() const { return m_color.data(); }
+	int width() const { return m_w; }
+	int height() const { return m_h; }
+
+	static const int TILE_SIZE = 64;
+
+	// Triangle after clipping and viewport transform, ready to rasterize
+	struct RasterTriangle
+	{
+		// Edge functions A * x + B * y + C, edge i facing vertex i,
+		// scaled so that they evaluate to the barycentric coordinates
+		float edgeA[ 3 ], edgeB[ 3 ], edgeC[ 3 ];
+		bool topLeft[ 3 ];				// owns the pixels exactly on the edge
+		float z[ 3 ];					// window depth, in [0, 1]
+		float invW[ 3 ];				// for perspective-correct interpolation
+		Vector3f color[ 3 ];			// lit vertex colors
+		int minX, minY, maxX, maxY;		// covered pixels (inclusive), inside the viewport
+	};
+
+private:
+	// A vertex in clip space, with its lit color
+	struct ClipVertex
+	{
+		Vector4f position;
+		Vector3f color;
+	};
+
+	void addTriangle( const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, std::vector< RasterTriangle >& out );
+	void setupTriangle( const ClipVertex* v, std::vector< RasterTriangle >& out );
+
+	// Set up triangles for numChunks chunks of work in parallel, keeping their order
+	void setupChunks( int numChunks, const std::function<void(int, std::vector< RasterTriangle >&)> &setup );
+
+	void drawMesh( const Matrix4f& viewMatrix, const Mesh& mesh, bool drawColor );
+	void drawPrimitive( const Matrix4f& viewMatrix, const Primitive& primitive, const std::vector< Matrix4f >& instances );
+	void drawLine( const Matrix4f& viewMatrix, const Vector3f& from, const Vector3f& to, const Vector3f& color );
+	void rasterize();
+	void rasterizeTile( int tile );
+
+	ThreadPool m_pool;
+
+	int m_w, m_h;
+	int m_tilesX, m_tilesY;
+	Matrix4f m_projection;
+
+	std::vector< unsigned char > m_color;
+	std::vector< float > m_depth;
+
+	// Triangles of the current frame, set up per chunk of input in parallel
+	std::vector< std::vector< RasterTriangle > > m_chunks;
+	std::vector< RasterTriangle > m_triangles;
+	// Indices into m_triangles of the triangles overlapping each tile, in submission order
+	std::vector< std::vector< int > > m_bins;
+
+	// Mesh vertices transformed into eye and clip space
+	std::vector< Vector3f > m_eyePositions;
+	std::vector< Vector4f > m_clipPositions;
+
+	// Skeleton geometry and instances
+	Primitive m_sphere, m_cube;
+	std::vector< Matrix4f > m_jointInstances;
+	std::vector< Matrix4f > m_boneInstances;
+};
+
+#endif // SOFTWARE_RENDERER_H
@@ -0,0 +1,238 @@
+#include "SyntheticRig.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "SkeletalModel.h"
+
+using namespace std;
+
+static const float TWO_PI = 6.28318531f;
+static const float DEGREES = TWO_PI / 360;
+
+// Extent of the model, within the unit cube the camera looks at
+static const float BOTTOM = 0.1f, HEIGHT = 0.8f, RADIUS = 0.05f;
+
+// Chains fan out over this angle either side of straight up
+static const float FAN_ANGLE = 60 * DEGREES;
+
+// Weight of the farthest of a vertex's influences, relative to the nearest
+static const float MIN_WEIGHT = 0.05f;
+
+// Buffered text output; models of tens of millions of vertices take gigabytes
+// of text, which streams formatting value by value write far too slowly
+class TextWriter
+{
+public:
+	explicit TextWriter(const string &filename) : m_file(filename, ios::binary) {}
+	~TextWriter() { flush(); }
+
+	void append(const char *text) { m_buffer += text; flushIfFull(); }
+	void append(const string &text) { m_buffer += text; flushIfFull(); }
+	void print(const char *format, ...)
+	{
+		char line[256];
+		va_list args;
+		va_start(args, format);
+		vsnprintf(line, sizeof(line), format, args);
+		va_end(args);
+		append(line);
+	}
+
+	bool good() { flush(); return m_file.good(); }
+
+private:
+	void flushIfFull() { if (m_buffer.size() >= (1 << 20)) flush(); }
+	void flush()
+	{
+		m_file.write(m_buffer.data(), m_buffer.size());
+		m_buffer.clear();
+	}
+
+	ofstream m_file;
+	string m_buffer;
+};
+
+// The weights of joints 1 .. numJoints - 1, as one line of an .attach file
+static string attachmentLine(const float *weights, int numJoints)
+{
+	string line;
+	char number[32];
+	for (int j = 1; j < numJoints; ++j) {
+		if (weights[j] == 0)
+			line += "0 ";
+		else {
+			snprintf(number, sizeof(number), "%g ", weights[j]);
+			line += number;
+		}
+	}
+	return line + "\n";
+}
+
+bool SyntheticRig::write(const string &prefix) const
+{
+	int numJoints = max(this->numJoints, 2);
+	int chainLength = depth > 0 ? min(depth, numJoints - 1) : numJoints - 1;
+	int numChains = (numJoints - 1 + chainLength - 1) / chainLength;
+	float boneLength = HEIGHT / chainLength;
+
+	// The joints: chains of joints below the root, one after the other
+	TextWriter skel(prefix + ".skel");
+	vector<Vector3f> directions(numChains);
+	skel.print("%g %g %g -1 joint0\n", 0.5, BOTTOM, 0.5);
+	for (int c = 0, joint = 1; c < numChains; ++c) {
+		float angle = numChains > 1 ? -FAN_ANGLE + 2 * FAN_ANGLE * c / (numChains - 1) : 0.f;
+		directions[c] = Vector3f(sin(angle), cos(angle), 0);
+		Vector3f bone = boneLength * directions[c];
+		for (int k = 0; k < chainLength && joint < numJoints; ++k, ++joint) {
+			skel.print("%g %g %g %d joint%d\n", bone[0], bone[1], bone[2], k == 0 ? 0 : joint - 1, joint);
+		}
+	}
+
+	TextWriter obj(prefix + ".obj"), attach(prefix + ".attach");
+	vector<float> weights(numJoints);
+	vector<pair<float, int>> nearest;
+	int firstVertex = 1;
+	for (int c = 0; c < numChains; ++c) {
+		// The last chain may be shorter; vertices are shared out by length
+		int firstJoint = 1 + c * chainLength, length = min(chainLength, numJoints - firstJoint);
+		int chainVertices = max((int) ((double) numVertices * length / (numJoints - 1)), 1);
+
+		// Rings of about a quarter as many vertices as there are rings
+		int ringSize = min(max((int) sqrt(chainVertices / 4.0), 3), 1024);
+		int numRings = max((chainVertices + ringSize / 2) / ringSize, 2);
+		Vector3f axis = directions[c], side(axis[1], -axis[0], 0), front(0, 0, 1);
+
+		for (int r = 0; r < numRings; ++r) {
+			// Position along the chain, in bones from the root
+			float position = (float) r / (numRings - 1) * length;
+			Vector3f center = Vector3f(0.5f, BOTTOM, 0.5f) + position * boneLength * axis;
+			for (int s = 0; s < ringSize; ++s) {
+				float angle = TWO_PI * s / ringSize;
+				Vector3f v = center + RADIUS * (cos(angle) * side + sin(angle) * front);
+				obj.print("v %g %g %g\n", v[0], v[1], v[2]);
+			}
+
+			// The nearest joints of the chain, by a tent falloff wide enough for all of them
+			int numInfluences = min(max(influences, 1), length);
+			nearest.clear();
+			for (int k = 1; k <= length; ++k)
+				nearest.push_back(make_pair(fabs(position - k), firstJoint + k - 1));
+			partial_sort(nearest.begin(), nearest.begin() + numInfluences, nearest.end());
+			fill(weights.begin(), weights.end(), 0.f);
+			float total = 0, radius = 0.5f * numInfluences;
+			for (int i = 0; i < numInfluences; ++i)
+				total += weights[nearest[i].second] = max(radius - nearest[i].first, MIN_WEIGHT * radius);
+			for (float &weight : weights)
+				weight /= total;
+			string line = attachmentLine(weights.data(), numJoints);
+			for (int s = 0; s < ringSize; ++s)
+				attach.append(line);
+		}
+
+		for (int r = 0; r + 1 < numRings; ++r)
+			for (int s = 0; s < ringSize; ++s) {
+				// 1-based corners of the quad between this ring and the next, counterclockwise from outside
+				int a = firstVertex + r * ringSize + s, b = firstVertex + r * ringSize + (s + 1) % ringSize;
+				obj.print("f %d %d %d\n", a, b + ringSize, b);
+				obj.print("f %d %d %d\n", a, a + ringSize, b + ringSize);
+			}
+		firstVertex += numRings * ringSize;
+	}
+
+	return skel.good() && obj.good() && attach.good();
+}
+
+bool SyntheticRig::writeSubdivided(const string &sourcePrefix, int levels, int influences, const string &prefix)
+{
+	string skelFile = sourcePrefix + ".skel";
+	SkeletalModel skeleton;
+	skeleton.loadSkeleton(skelFile.c_str());
+	int numJoints = skeleton.getJoints().size();
+	Mesh mesh;
+	mesh.load((sourcePrefix + ".obj").c_str());
+	mesh.loadAttachments((sourcePrefix + ".attach").c_str(), numJoints);
+	if (numJoints == 0 || mesh.bindVertices.empty())
+		return false;
+
+	// Vertices, their weights (numJoints per vertex) and 0-based faces
+	vector<Vector3f> vertices = mesh.bindVertices;
+	vector<float> weights;
+	for (const vector<float> &attachment : mesh.attachments)
+		weights.insert(weights.end(), attachment.begin(), attachment.end());
+	vector<unsigned> faces;
+	for (const Tuple3u &face : mesh.faces)
+		for (int k = 0; k < 3; ++k)
+			faces.push_back(face[k] - 1);
+
+	for (int level = 0; level < levels; ++level) {
+		// One new vertex per edge, shared by the two faces along it
+		unordered_map<unsigned long long, unsigned> midpoints;
+		auto midpoint = [&](unsigned a, unsigned b) {
+			unsigned long long key = (unsigned long long) min(a, b) << 32 | max(a, b);
+			auto found = midpoints.find(key);
+			if (found != midpoints.end())
+				return found->second;
+			unsigned index = vertices.size();
+			vertices.push_back(0.5f * (vertices[a] + vertices[b]));
+			for (int j = 0; j < numJoints; ++j)
+				weights.push_back(0.5f * (weights[a * numJoints + j] + weights[b * numJoints + j]));
+			midpoints[key] = index;
+			return index;
+		};
+
+		vector<unsigned> split;
+		split.reserve(faces.size() * 4);
+		for (size_t f = 0; f < faces.size(); f += 3) {
+			unsigned a = faces[f], b = faces[f + 1], c = faces[f + 2];
+			unsigned ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+			unsigned corners[] = { a, ab, ca, ab, b, bc, ca, bc, c, ab, bc, ca };
+			split.insert(split.end(), corners, corners + 12);
+		}
+		faces.swap(split);
+	}
+
+	// Copy the skeleton as is
+	{
+		ifstream source(skelFile, ios::binary);
+		ofstream target(prefix + ".skel", ios::binary);
+		target << source.rdbuf();
+		if (!target)
+			return false;
+	}
+
+	TextWriter obj(prefix + ".obj"), attach(prefix + ".attach");
+	for (const Vector3f &v : vertices)
+		obj.print("v %g %g %g\n", v[0], v[1], v[2]);
+	for (size_t f = 0; f < faces.size(); f += 3)
+		obj.print("f %u %u %u\n", faces[f] + 1u, faces[f + 1] + 1u, faces[f + 2] + 1u);
+
+	vector<int> order(numJoints);
+	for (size_t v = 0; v < vertices.size(); ++v) {
+		float *w = &weights[v * numJoints];
+		if (influences > 0 && influences < numJoints) {
+			// Drop all but the largest weights, and scale those back to a sum of 1
+			for (int j = 0; j < numJoints; ++j)
+				order[j] = j;
+			nth_element(order.begin(), order.begin() + influences, order.end(),
+				[&](int i, int j) { return w[i] > w[j]; });
+			for (int i = influences; i < numJoints; ++i)
+				w[order[i]] = 0;
+			float total = 0;
+			for (int j = 0; j < numJoints; ++j)
+				total += w[j];
+			for (int j = 0; j < numJoints && total > 0; ++j)
+				w[j] /= total;
+		}
+		attach.append(attachmentLine(w, numJoints));
+	}
+
+	return obj.good() && attach.good();
+}
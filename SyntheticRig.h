@@ -0,0 +1,30 @@
+#ifndef SYNTHETIC_RIG_H
+#define SYNTHETIC_RIG_H
+
+#include <string>
+
+// A generated model of any size, for measuring how skinning scales past the
+// bundled models: tubes of rings of vertices around chains of joints, which
+// fan out from the root joint. Every vertex is bound to the joints of its
+// chain nearest to its ring.
+struct SyntheticRig
+{
+	int numVertices = 10000;	// rounded to whole rings
+	int numJoints = 18;			// at least 2; the root joint carries no vertices
+	int depth = 0;				// joints per chain below the root; 0: a single chain of all joints
+	int influences = 2;			// joints per vertex, at most depth
+
+	// Write PREFIX.skel, PREFIX.obj and PREFIX.attach, readable by
+	// SkeletalModel::load(). Returns false if a file cannot be written.
+	bool write( const std::string& prefix ) const;
+
+	// Write a denser version of an existing model: every triangle of
+	// SOURCE.obj is split into 4 at its edge midpoints, levels times, and the
+	// new vertices blend the weights of the edge's ends. If influences > 0,
+	// every vertex then keeps only its influences largest weights. The
+	// skeleton is copied as is.
+	static bool writeSubdivided( const std::string& sourcePrefix, int levels, int influences,
+		const std::string& prefix );
+};
+
+#endif // SYNTHETIC_RIG_H
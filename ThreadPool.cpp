@@ -0,0 +1,87 @@
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <algorithm>
+
+using namespace std;
+
+ThreadPool::ThreadPool(int numThreads)
+	: m_stop(false), m_task(NULL), m_count(0), m_generation(0), m_next(0), m_busyWorkers(0)
+{
+	if (numThreads <= 0)
+		numThreads = max((int) thread::hardware_concurrency(), 1);
+
+	for (int i = 1; i < numThreads; ++i)
+		m_workers.push_back(thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for (auto &worker : m_workers)
+		worker.join();
+}
+
+void ThreadPool::runTasks()
+{
+	// Claim indices one at a time until the loop is exhausted
+	for (int i = m_next++; i < m_count; i = m_next++) {
+		TraceSpan span("task", "index", i);
+		(*m_task)(i);
+	}
+}
+
+void ThreadPool::parallelFor(int count, const function<void(int)> &task)
+{
+	if (count <= 0)
+		return;
+	TraceSpan span("parallelFor", "count", count);
+
+	if (m_workers.empty() || count == 1) {
+		for (int i = 0; i < count; ++i)
+			task(i);
+		return;
+	}
+
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_task = &task;
+		m_count = count;
+		m_next = 0;
+		m_busyWorkers = m_workers.size();
+		++m_generation;
+	}
+	m_wake.notify_all();
+
+	runTasks();
+
+	// Wait until every worker has left the loop before the task goes out of scope
+	unique_lock<mutex> lock(m_mutex);
+	m_done.wait(lock, [this] { return m_busyWorkers == 0; });
+	m_task = NULL;
+}
+
+void ThreadPool::workerLoop()
+{
+	Trace::setThreadName("pool worker");
+	unsigned seenGeneration = 0;
+	while (true) {
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_wake.wait(lock, [&] { return m_stop || m_generation != seenGeneration; });
+			if (m_stop)
+				return;
+			seenGeneration = m_generation;
+		}
+
+		runTasks();
+
+		lock_guard<mutex> lock(m_mutex);
+		if (--m_busyWorkers == 0)
+			m_done.notify_one();
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads running data-parallel loops.
+// The calling thread takes part in the work, so a pool of size 1
+// simply runs every loop inline.
+class ThreadPool
+{
+public:
+	// numThreads counts the calling thread; 0 means one per hardware thread
+	explicit ThreadPool(int numThreads = 0);
+	~ThreadPool();
+
+	int size() const { return m_workers.size() + 1; }
+
+	// Call task(i) for every i in [0, count) and return when all calls are done.
+	// Loops must not be started from inside a task.
+	void parallelFor(int count, const std::function<void(int)> &task);
+
+private:
+	void workerLoop();
+	void runTasks();
+
+	std::vector< std::thread > m_workers;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	bool m_stop;
+
+	// The loop currently running
+	const std::function<void(int)> *m_task;
+	int m_count;
+	unsigned m_generation;
+	std::atomic<int> m_next;
+	int m_busyWorkers;
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,158 @@
+#include "Trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+atomic<bool> Trace::s_enabled(false);
+
+namespace
+{
+	struct Event
+	{
+		const char *name;
+		double start, duration;		// microseconds
+		const char *argName;
+		long long arg;
+		string detail;
+	};
+
+	// The spans of one thread. Only that thread adds to them, but the lock
+	// lets stop() write them out while it is still running.
+	struct ThreadEvents
+	{
+		int id;
+		string name;
+		mutex lock;
+		vector<Event> events;
+	};
+
+	// Buffers outlive their threads, e.g. the workers of a pool that was destroyed
+	mutex s_threadsMutex;
+	vector<unique_ptr<ThreadEvents>> s_threads;
+	string s_filename;
+	chrono::steady_clock::time_point s_startTime;
+
+	thread_local ThreadEvents *t_events = NULL;
+	thread_local const char *t_threadName = NULL;
+
+	ThreadEvents &threadEvents()
+	{
+		if (!t_events) {
+			lock_guard<mutex> lock(s_threadsMutex);
+			s_threads.emplace_back(new ThreadEvents());
+			t_events = s_threads.back().get();
+			t_events->id = s_threads.size();
+			t_events->name = t_threadName ? t_threadName : "thread " + to_string(t_events->id);
+		}
+		return *t_events;
+	}
+
+	void writeString(ostream &out, const string &text)
+	{
+		out << '"';
+		for (char c : text) {
+			if (c == '"' || c == '\\')
+				out << '\\' << c;
+			else if ((unsigned char) c < 0x20) {
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				out << escaped;
+			}
+			else
+				out << c;
+		}
+		out << '"';
+	}
+}
+
+void Trace::start(const string &filename)
+{
+	lock_guard<mutex> lock(s_threadsMutex);
+	s_filename = filename;
+	s_startTime = chrono::steady_clock::now();
+	s_enabled = true;
+}
+
+bool Trace::stop(size_t *numEvents)
+{
+	if (numEvents)
+		*numEvents = 0;
+	if (!s_enabled.exchange(false))
+		return true;
+
+	lock_guard<mutex> lock(s_threadsMutex);
+	ofstream out(s_filename);
+	out << "{\"traceEvents\":[" << endl
+		<< "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"a3\"}}";
+
+	size_t numWritten = 0;
+	char line[256];
+	for (auto &thread : s_threads) {
+		lock_guard<mutex> threadLock(thread->lock);
+		out << "," << endl << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->id
+			<< ",\"args\":{\"name\":";
+		writeString(out, thread->name);
+		out << "}}";
+
+		// Complete events, timed in microseconds
+		for (const Event &event : thread->events) {
+			snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+				event.name, thread->id, event.start, event.duration);
+			out << line;
+			if (event.argName || !event.detail.empty()) {
+				out << ",\"args\":{";
+				if (event.argName)
+					out << "\"" << event.argName << "\":" << event.arg << (event.detail.empty() ? "" : ",");
+				if (!event.detail.empty()) {
+					out << "\"detail\":";
+					writeString(out, event.detail);
+				}
+				out << "}";
+			}
+			out << "}";
+		}
+		numWritten += thread->events.size();
+		thread->events.clear();
+	}
+	out << endl << "],\"displayTimeUnit\":\"ms\"}" << endl;
+
+	if (!out)
+		return false;
+	if (numEvents)
+		*numEvents = numWritten;
+	return true;
+}
+
+const string &Trace::filename()
+{
+	return s_filename;
+}
+
+void Trace::setThreadName(const char *name)
+{
+	t_threadName = name;
+	if (t_events) {
+		lock_guard<mutex> lock(t_events->lock);
+		t_events->name = name;
+	}
+}
+
+double Trace::now()
+{
+	return chrono::duration<double, micro>(chrono::steady_clock::now() - s_startTime).count();
+}
+
+void Trace::record(const char *name, double start, double end, const char *argName, long long arg,
+	const char *detail)
+{
+	ThreadEvents &thread = threadEvents();
+	Event event = { name, start, end - start, argName, arg, detail ? detail : "" };
+	lock_guard<mutex> lock(thread.lock);
+	thread.events.push_back(move(event));
+}
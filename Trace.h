@@ -0,0 +1,71 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+// Spans of time recorded per thread and written out in the Chrome trace-event
+// JSON format, for a timeline in chrome://tracing or ui.perfetto.dev.
+// Nothing is recorded until start(); until then a span costs one relaxed load.
+class Trace
+{
+public:
+	// Record spans from now on, until stop()
+	static void start(const std::string &filename);
+
+	// Write the spans recorded so far to the file given to start() and stop
+	// recording; false if the file cannot be written. numEvents, if given, is
+	// set to the number of spans written.
+	static bool stop(size_t *numEvents = NULL);
+
+	// The file given to start()
+	static const std::string &filename();
+
+	static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+	// Name of the calling thread in the timeline
+	static void setThreadName(const char *name);
+
+	// Microseconds since start()
+	static double now();
+
+	// A span of the calling thread, with an optional integer argument and text
+	// (e.g. a file name). name and argName are kept by pointer: use literals.
+	static void record(const char *name, double start, double end, const char *argName, long long arg,
+		const char *detail);
+
+private:
+	static std::atomic<bool> s_enabled;
+};
+
+// Records the time until it goes out of scope as a span, if tracing is on
+class TraceSpan
+{
+public:
+	explicit TraceSpan(const char *name)
+		: m_name(name), m_argName(NULL), m_arg(0), m_detail(NULL), m_start(Trace::enabled() ? Trace::now() : -1) {}
+
+	// With an integer argument, e.g. the index of a model
+	TraceSpan(const char *name, const char *argName, long long arg)
+		: m_name(name), m_argName(argName), m_arg(arg), m_detail(NULL), m_start(Trace::enabled() ? Trace::now() : -1) {}
+
+	// A span about something named at run time; detail must outlive the span
+	TraceSpan(const char *name, const char *detail)
+		: m_name(name), m_argName(NULL), m_arg(0), m_detail(detail), m_start(Trace::enabled() ? Trace::now() : -1) {}
+
+	~TraceSpan()
+	{
+		if (m_start >= 0 && Trace::enabled())
+			Trace::record(m_name, m_start, Trace::now(), m_argName, m_arg, m_detail);
+	}
+
+private:
+	const char *m_name;
+	const char *m_argName;
+	long long m_arg;
+	const char *m_detail;
+	double m_start;
+};
+
+#endif // TRACE_H
@@ -0,0 +1,141 @@
+#include "VertexCache.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Frames are copied to and from the meshes as packed floats
+static_assert(sizeof(Vector3f) == 3 * sizeof(float), "Vector3f must be 3 packed floats");
+
+VertexCache::VertexCache()
+	: m_numFrames(0), m_frameSize(0), m_data(NULL), m_mappedBytes(0)
+{
+}
+
+VertexCache::~VertexCache()
+{
+	destroy();
+}
+
+size_t VertexCache::requiredBytes(const vector<SkeletalModel> &models, unsigned numFrames)
+{
+	size_t frameSize = 0;
+	for (const SkeletalModel &model : models)
+		frameSize += 3 * (model.getMesh().bindVertices.size() + model.getMesh().faces.size());
+	return numFrames * frameSize * sizeof(float);
+}
+
+bool VertexCache::create(const vector<SkeletalModel> &models, unsigned numFrames, size_t budgetBytes, const string &mappedFile)
+{
+	destroy();
+	size_t bytes = requiredBytes(models, numFrames);
+	if (numFrames == 0 || bytes == 0 || bytes > budgetBytes)
+		return false;
+
+	// A frame holds the vertices then the face normals of every model
+	m_frameSize = 0;
+	for (const SkeletalModel &model : models) {
+		m_modelOffsets.push_back(m_frameSize);
+		m_numVertices.push_back(model.getMesh().bindVertices.size());
+		m_frameSize += 3 * (model.getMesh().bindVertices.size() + model.getMesh().faces.size());
+	}
+
+	if (!mappedFile.empty()) {
+#ifndef WIN32
+		// The file only backs the memory, so that the OS can page frames out; it is not reused
+		int fd = open(mappedFile.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		void *mapped = MAP_FAILED;
+		if (fd >= 0 && ftruncate(fd, bytes) == 0)
+			mapped = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (fd >= 0)
+			close(fd);
+		if (mapped == MAP_FAILED) {
+			m_modelOffsets.clear();
+			m_numVertices.clear();
+			return false;
+		}
+		m_data = static_cast<float *>(mapped);
+		m_mappedBytes = bytes;
+#endif
+	}
+	if (!m_data) {
+		m_heap.resize(bytes / sizeof(float));
+		m_data = m_heap.data();
+	}
+
+	m_numFrames = numFrames;
+	m_stored.assign(numFrames * models.size(), false);
+	return true;
+}
+
+void VertexCache::destroy()
+{
+#ifndef WIN32
+	if (m_mappedBytes > 0)
+		munmap(m_data, m_mappedBytes);
+#endif
+	m_mappedBytes = 0;
+	m_data = NULL;
+	vector<float>().swap(m_heap);
+	m_numFrames = 0;
+	m_frameSize = 0;
+	m_modelOffsets.clear();
+	m_numVertices.clear();
+	m_stored.clear();
+}
+
+float *VertexCache::frameData(unsigned frame, int model) const
+{
+	return m_data + frame * m_frameSize + m_modelOffsets[model];
+}
+
+bool VertexCache::contains(unsigned frame, int model) const
+{
+	return enabled() && frame < m_numFrames && m_stored[frame * m_modelOffsets.size() + model];
+}
+
+void VertexCache::store(unsigned frame, int model, const Mesh &mesh)
+{
+	if (!enabled() || frame >= m_numFrames)
+		return;
+
+	// Vector3f is 3 packed floats
+	float *data = frameData(frame, model);
+	memcpy(data, mesh.currentVertices.data(), mesh.currentVertices.size() * sizeof(Vector3f));
+	memcpy(data + 3 * m_numVertices[model], mesh.currentNormals.data(), mesh.currentNormals.size() * sizeof(Vector3f));
+	m_stored[frame * m_modelOffsets.size() + model] = true;
+}
+
+void VertexCache::load(unsigned frame, int model, SkeletalModel &skeletalModel) const
+{
+	const float *data = frameData(frame, model);
+	skeletalModel.setSkinnedMesh(reinterpret_cast<const Vector3f *>(data),
+		reinterpret_cast<const Vector3f *>(data + 3 * m_numVertices[model]));
+}
+
+void VertexCache::invalidate(int model)
+{
+	for (size_t i = model, numModels = m_modelOffsets.size(); i < m_stored.size(); i += numModels)
+		m_stored[i] = false;
+}
+
+void VertexCache::reportMemory(MemoryReport &report) const
+{
+	// The frames of all models are one block, counted as the first model's allocation;
+	// a mapped file is not allocated on the heap
+	for (size_t m = 0, numModels = m_modelOffsets.size(); m < numModels; ++m) {
+		size_t modelSize = (m + 1 < numModels ? m_modelOffsets[m + 1] : m_frameSize) - m_modelOffsets[m];
+		report.add("frames of model " + to_string(m) + (m_mappedBytes > 0 ? " (mapped)" : ""),
+			m_numFrames * modelSize * sizeof(float), m == 0 && m_heap.capacity() > 0);
+	}
+	report.add("bookkeeping", m_modelOffsets);
+	report.add("bookkeeping", m_numVertices);
+	report.add("bookkeeping", m_stored);
+}
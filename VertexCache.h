@@ -0,0 +1,66 @@
+#ifndef VERTEX_CACHE_H
+#define VERTEX_CACHE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "SkeletalModel.h"
+
+// Skinned meshes (vertex positions and face normals) of a set of models at
+// every frame of an animation, so that repeated playback streams them instead
+// of skinning the same poses again. All frames live in one contiguous block,
+// on the heap or in a memory-mapped file, and a frame is stored the first time
+// it is skinned (or ahead of time).
+class VertexCache
+{
+public:
+	VertexCache();
+	~VertexCache();
+
+	// Make room for numFrames frames of the models, all empty. Returns false,
+	// and leaves the cache disabled, if that needs more than budgetBytes (or if
+	// mappedFile, if given, cannot be mapped). On Windows, mappedFile is ignored.
+	bool create( const std::vector< SkeletalModel >& models, unsigned numFrames, size_t budgetBytes,
+		const std::string& mappedFile = "" );
+	void destroy();
+
+	bool enabled() const { return m_data != NULL; }
+	// True if the frames are in the file given to create()
+	bool mapped() const { return m_mappedBytes > 0; }
+	unsigned numFrames() const { return m_numFrames; }
+	size_t sizeInBytes() const { return m_numFrames * m_frameSize * sizeof( float ); }
+
+	// Bytes needed for numFrames frames of the models
+	static size_t requiredBytes( const std::vector< SkeletalModel >& models, unsigned numFrames );
+
+	bool contains( unsigned frame, int model ) const;
+
+	// Copy the skinned mesh of a model at a frame into the cache
+	void store( unsigned frame, int model, const Mesh& mesh );
+
+	// Replace the skinned mesh of a model by its cached frame
+	void load( unsigned frame, int model, SkeletalModel& skeletalModel ) const;
+
+	// Forget every frame of a model, e.g. when a control that the animation
+	// does not drive changes: frames are only keyed by frame and model
+	void invalidate( int model );
+
+	// Add the frames of every model and the bookkeeping to report
+	void reportMemory( MemoryReport& report ) const;
+
+private:
+	float *frameData( unsigned frame, int model ) const;
+
+	unsigned m_numFrames;
+	size_t m_frameSize;						// floats per frame, all models
+	std::vector< size_t > m_modelOffsets;	// floats from the start of a frame
+	std::vector< size_t > m_numVertices;
+	std::vector< bool > m_stored;			// per frame and model
+
+	float *m_data;
+	std::vector< float > m_heap;
+	size_t m_mappedBytes;					// 0 unless the data is a mapped file
+};
+
+#endif // VERTEX_CACHE_H
@@ -0,0 +1,150 @@
+#include "ViewState.h"
+
+#include "Animation.h"
+#include "Bounds.h"
+#include "Trace.h"
+
+using namespace std;
+
+ViewState::ViewState(int numThreads)
+	: m_pipeline(numThreads), m_numCacheLoads(0)
+{
+}
+
+void ViewState::update()
+{
+	ScopedPhaseTimer updateTimer(&timings, PhaseTimings::UPDATE);
+	TraceSpan span("update");
+	Frustum frustum(camera.projectionMatrix() * camera.viewMatrix());
+
+	for (SkeletalModel &model : models) {
+		// Update the bone to world transforms for SSD.
+		// This also refits the bounding box of the model.
+		{
+			ScopedPhaseTimer timer(&timings, PhaseTimings::JOINT_TRANSFORMS);
+			model.updateCurrentJointToWorldTransforms();
+		}
+
+		// update the mesh given the new skeleton
+		if (!drawSkeleton && frustum.intersects(model.getBounds())) {
+			ScopedPhaseTimer timer(&timings, PhaseTimings::SKINNING);
+			model.updateMesh();
+		}
+	}
+}
+
+void ViewState::updateFrame(unsigned frame)
+{
+	if (!vertexCache.enabled()) {
+		update();
+		return;
+	}
+
+	ScopedPhaseTimer updateTimer(&timings, PhaseTimings::UPDATE);
+	TraceSpan span("update frame", "frame", frame);
+	Frustum frustum(camera.projectionMatrix() * camera.viewMatrix());
+
+	for (int m = 0, numModels = models.size(); m < numModels; ++m) {
+		SkeletalModel &model = models[m];
+		// The skeleton and the bounds still follow the pose
+		{
+			ScopedPhaseTimer timer(&timings, PhaseTimings::JOINT_TRANSFORMS);
+			model.updateCurrentJointToWorldTransforms();
+		}
+		if (drawSkeleton || !frustum.intersects(model.getBounds()))
+			continue;
+
+		if (vertexCache.contains(frame, m)) {
+			ScopedPhaseTimer timer(&timings, PhaseTimings::CACHE_LOAD);
+			vertexCache.load(frame, m, model);
+			++m_numCacheLoads;
+		}
+		else {
+			{
+				ScopedPhaseTimer timer(&timings, PhaseTimings::SKINNING);
+				model.updateMesh();
+			}
+			vertexCache.store(frame, m, model.getMesh());
+		}
+	}
+}
+
+void ViewState::skinFrameAhead(unsigned frame, const float *values, const Quat4f *rotations, int count)
+{
+	bool cached = vertexCache.enabled();
+	for (int m = 0, numModels = models.size(); m < numModels && cached; ++m)
+		cached = vertexCache.contains(frame, m);
+	if (cached)
+		return;
+
+	// The pipeline needs every control; those beyond count keep the current pose
+	int offset = 0;
+	m_aheadValues.clear();
+	m_aheadRotations.clear();
+	for (SkeletalModel &model : models) {
+		const float *pose = model.getPose();
+		for (int c = 0, numControls = model.getNumControls(); c < numControls; c += 3, offset += 3) {
+			bool given = offset + 3 <= count;
+			m_aheadValues.insert(m_aheadValues.end(), given ? values + offset : pose + c,
+				given ? values + offset + 3 : pose + c + 3);
+			m_aheadRotations.push_back(given ? rotations[offset / 3] : eulerToQuaternion(pose + c));
+		}
+	}
+	m_pipeline.submit(models, frame, m_aheadValues.data(), m_aheadRotations.data());
+}
+
+bool ViewState::presentFrame(unsigned frame)
+{
+	// Waiting for the frame skinned ahead counts as updating
+	ScopedPhaseTimer updateTimer(&timings, PhaseTimings::UPDATE);
+	if (!m_pipeline.present(models, frame))
+		return false;
+
+	for (int m = 0, numModels = models.size(); m < numModels; ++m)
+		if (!vertexCache.contains(frame, m))
+			vertexCache.store(frame, m, models[m].getMesh());
+	return true;
+}
+
+void ViewState::cancelFrameAhead()
+{
+	m_pipeline.cancel();
+}
+
+void ViewState::controlChanged(int model)
+{
+	vertexCache.invalidate(model);
+	m_pipeline.cancel();
+}
+
+void ViewState::setControlValues(const float *values, const Quat4f *rotations, int count)
+{
+	for (SkeletalModel &model : models) {
+		int numControls = model.getNumControls();
+		if (count < numControls) {
+			// The values end inside this model
+			for (int i = 0; i < count; ++i)
+				model.setControlValue(i, values[i]);
+			for (int track = 1; rotations && 3 * track + 2 < count; ++track)
+				model.setJointRotation(track - 1, rotations[track]);
+			break;
+		}
+		model.setControlValues(values, rotations);
+		values += numControls;
+		if (rotations)
+			rotations += numControls / 3;
+		count -= numControls;
+	}
+}
+
+void ViewState::reportMemory(MemoryReport &report, const vector<string> &modelNames)
+{
+	for (size_t m = 0; m < models.size(); ++m) {
+		report.begin("Model " + to_string(m) + ": " + modelNames[m]);
+		models[m].reportMemory(report);
+	}
+	report.begin("Vertex cache");
+	vertexCache.reportMemory(report);
+	report.begin("Skinning pipeline");
+	m_pipeline.reportMemory(report);
+}
@@ -0,0 +1,78 @@
+#ifndef VIEW_STATE_H
+#define VIEW_STATE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "SkeletalModel.h"
+#include "VertexCache.h"
+#include "SkinningPipeline.h"
+#include "PhaseTimings.h"
+#include "camera.h"
+
+// The models of a view and how they are posed and skinned every frame: from
+// their pose buffers, or for a frame of an animation through the vertex cache
+// and the skinning pipeline. It does not depend on FLTK or GL, so the model
+// window, replay and headless rendering update their models the same way.
+class ViewState
+{
+public:
+	// numThreads is passed on to the skinning pipeline
+	explicit ViewState( int numThreads = 0 );
+
+	std::vector< SkeletalModel > models;
+
+	// Models outside its view frustum are not skinned
+	Camera camera;
+
+	// If true, the skeletons are drawn and no mesh is skinned
+	bool drawSkeleton = false;
+
+	// Skinned meshes of the frames of the loaded animation, when enabled
+	VertexCache vertexCache;
+
+	PhaseTimings timings;
+
+	// Pose the skeletons from the pose buffers of the models, which the
+	// sliders, file loading and animation write directly, and skin the visible
+	// meshes. The others are skinned by the renderer if they come into view.
+	void update();
+
+	// Like update(), for a frame of the animation: visible meshes are loaded from
+	// the vertex cache if it holds the frame, and stored in it after skinning otherwise
+	void updateFrame( unsigned frame );
+
+	// Skin a frame of the animation ahead on worker threads (see SkinningPipeline),
+	// from count control values and a rotation per 3 of them, like setControlValues()
+	void skinFrameAhead( unsigned frame, const float* values, const Quat4f* rotations, int count );
+	// Pose the models and swap in the meshes of frame, if it was skinned ahead.
+	// Returns false if it was not; the frame must then be posed and updated as usual.
+	bool presentFrame( unsigned frame );
+	// Drop the frame skinned ahead, e.g. when the animation changes
+	void cancelFrameAhead();
+
+	// A control of a model changed outside of the animation: drop its cached
+	// frames and the frame skinned ahead, which have the previous value
+	void controlChanged( int model );
+
+	// Write the pose buffers of all models from count control values, and
+	// optionally one rotation per 3 controls that replaces the joint angles.
+	// The models' controls follow each other in the order of the sliders.
+	void setControlValues( const float* values, const Quat4f* rotations, int count );
+
+	// Meshes loaded from the vertex cache so far
+	size_t numCacheLoads() const { return m_numCacheLoads; }
+
+	// Add every model, the vertex cache and the skinning pipeline to report
+	void reportMemory( MemoryReport& report, const std::vector< std::string >& modelNames );
+
+private:
+	SkinningPipeline m_pipeline;
+	std::vector< float > m_aheadValues;
+	std::vector< Quat4f > m_aheadRotations;
+
+	size_t m_numCacheLoads;
+};
+
+#endif // VIEW_STATE_H
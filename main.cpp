@@ -8,27 +8,86 @@
 #include <fstream>
 #include <vector>
 
-#ifdef WIN32
-#include "GL/freeglut.h"
-#else
-#include <GL/glut.h>
-#endif
 #include <vecmath.h>
 
+// Builds without FLTK (see CMakeLists.txt) only have the modes without a window
+#ifndef A3_NO_GUI
 #include "modelerapp.h"
 #include "ModelerView.h"
+#endif
+#include "Headless.h"
+#include "CompressTool.h"
+#include "Benchmark.h"
+#include "RigTool.h"
+#include "SkinningCheck.h"
+#include "Replay.h"
+#include "Trace.h"
 
 using namespace std;
 
+// Write the timeline on exit if a mode started a trace (see --trace)
+static void writeTrace()
+{
+	if( !Trace::enabled() )
+		return;
+
+	size_t numEvents;
+	if( Trace::stop( &numEvents ) )
+		cout << "Wrote " << numEvents << " trace events to " << Trace::filename() << endl;
+	else
+		cerr << "Error: couldn't write the trace to " << Trace::filename() << endl;
+}
+
 int main( int argc, char* argv[] )
 {
+	Trace::setThreadName( "main" );
+	atexit( writeTrace );
+
 	if( argc < 2 )
 	{
 		cout << "Usage: " << argv[ 0 ] << " PREFIX1 PREFIX2 ..." << endl;
 		cout << "For example, if you're trying to load data/cheb.skel, data/cheb.obj, and data/cheb.attach, run with: " << argv[ 0 ] << " data/cheb" << endl;
+		cout << "To write the phase timings of the model window to a CSV file on exit, add: --timings-csv FILE" << endl;
+		cout << "To write the latency from input to the frame that shows it to a CSV file on exit, add: --latency-csv FILE" << endl;
+		cout << "To record the session (sliders, camera, menus) to a binary log, add: --record FILE" << endl;
+		cout << "To write a Chrome trace-event timeline (chrome://tracing, ui.perfetto.dev) on exit, add: --trace FILE" << endl;
+		cout << "To render frames without a window, run with: " << argv[ 0 ] << " --headless [options] PREFIX1 PREFIX2 ..." << endl;
+		cout << "To convert an animation into a compressed .clip file, run with: " << argv[ 0 ] << " --compress-clip [options] IN.anim OUT.clip [PREFIX1 ...]" << endl;
+		cout << "To time loading, posing and skinning, run with: " << argv[ 0 ] << " --benchmark [options] [PREFIX1 ...]" << endl;
+		cout << "To generate a model for scaling tests, run with: " << argv[ 0 ] << " --generate-rig [options] OUT_PREFIX" << endl;
+		cout << "To check every skinning path against the reference, run with: " << argv[ 0 ] << " --check-skinning [options] [PREFIX1 ...]" << endl;
+		cout << "To replay a recorded session and time it, run with: " << argv[ 0 ] << " --replay FILE [options] [PREFIX1 ...]" << endl;
 		return -1;
 	}
 
+	// Render offscreen without creating any FLTK window
+	if( string( argv[ 1 ] ) == "--headless" )
+		return runHeadless( argc, argv );
+
+	// Convert an animation without creating any window
+	if( string( argv[ 1 ] ) == "--compress-clip" )
+		return runCompressClip( argc, argv );
+
+	// Time the model code without creating any window
+	if( string( argv[ 1 ] ) == "--benchmark" )
+		return runBenchmark( argc, argv );
+
+	// Write a synthetic model without creating any window
+	if( string( argv[ 1 ] ) == "--generate-rig" )
+		return runGenerateRig( argc, argv );
+
+	// Compare the skinning paths without creating any window
+	if( string( argv[ 1 ] ) == "--check-skinning" )
+		return runCheckSkinning( argc, argv );
+
+	// Replay a recorded session without creating any window
+	if( string( argv[ 1 ] ) == "--replay" )
+		return runReplay( argc, argv );
+
+#ifdef A3_NO_GUI
+	cerr << "Error: this build of " << argv[ 0 ] << " has no model window (FLTK or GLUT was not found); run it with one of the modes above" << endl;
+	return -1;
+#else
 	vector<string> jointNames = {
 		"Root (Translation)",
 		"Root",
@@ -60,4 +119,5 @@ int main( int argc, char* argv[] )
 	delete ModelerApplication::Instance();
 
 	return ret;
+#endif
 }
@@ -1,10 +1,13 @@
 #include "modelerapp.h"
 #include "ModelerView.h"
 #include "modelerui.h"
+#include "Trace.h"
 
 #include <FL/Fl_Value_Slider.H>
 #include <FL/Fl_Box.H>
 
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
@@ -28,6 +31,26 @@ void ModelerApplication::Init( int argc, char* argv[], vector<string> &defaultJo
 {
     m_ui = new ModelerUserInterface();
 
+    // Take out the options, so that only the model prefixes remain
+    string timingsFile, latencyFile, recordFile;
+    for (int i = 1; i + 1 < argc; ) {
+        string option = argv[i];
+        if (option == "--timings-csv")
+            timingsFile = argv[i + 1];
+        else if (option == "--latency-csv")
+            latencyFile = argv[i + 1];
+        else if (option == "--record")
+            recordFile = argv[i + 1];
+        else if (option == "--trace")
+            Trace::start(argv[i + 1]);
+        else {
+            ++i;
+            continue;
+        }
+        copy(argv + i + 2, argv + argc, argv + i);
+        argc -= 2;
+    }
+
     // Make sure that we remove the view from the
     // Fl_Group, otherwise, it'll blow up
     // THIS BUG FIXED 04-18-01 ehsu
@@ -38,7 +61,11 @@ void ModelerApplication::Init( int argc, char* argv[], vector<string> &defaultJo
     m_ui->m_modelerWindow->begin();
 
     m_ui->m_modelerView = new ModelerView(0, 0, m_ui->m_modelerWindow->w(), m_ui->m_modelerWindow->h(), NULL);
+    m_ui->m_modelerView->setTimingsFile(timingsFile);
+    m_ui->m_modelerView->setLatencyFile(latencyFile);
     m_ui->m_modelerView->loadModels(argc, argv);
+    if (!recordFile.empty())
+        m_ui->m_modelerView->startRecording(recordFile);
 
     Fl_Group::current()->resizable(m_ui->m_modelerView);
     m_ui->m_modelerWindow->end();
@@ -52,11 +79,15 @@ void ModelerApplication::Init( int argc, char* argv[], vector<string> &defaultJo
     const int sliderHeight = 20;
     const int packWidth = m_ui->m_controlsPack->w();
 
-    // Determine the total number of controls
-    auto allJoints = m_ui->m_modelerView->getJointsPerModel();
+    // Determine the total number of controls, and where the controls of every model start
+    auto &models = m_ui->m_modelerView->state().models;
     m_numControls = 0;
-    for (auto &modelJoints : allJoints)
-        m_numControls += (modelJoints.size() + 1) * 3; // Extra control for root joint translation
+    m_modelControlOffsets.clear();
+    for (auto &model : models) {
+        m_modelControlOffsets.push_back(m_numControls);
+        m_numControls += model.getNumControls(); // Including the root joint translation
+    }
+    m_modelControlOffsets.push_back(m_numControls);
 
     // Store pointers to the controls for manipulation
     m_controlLabelBoxes = new Fl_Box *[m_numControls];
@@ -65,9 +96,9 @@ void ModelerApplication::Init( int argc, char* argv[], vector<string> &defaultJo
     // Initialize controls for every model
     int controlIndex = 0, selectorIndex = 1, nonameJointIndex = 1;
     m_ui->m_controlsPack->begin();
-    for (int modelIndex = 0, numModels = allJoints.size(); modelIndex < numModels; ++modelIndex) {
+    for (int modelIndex = 0, numModels = models.size(); modelIndex < numModels; ++modelIndex) {
         // Note that we have an extra control for adjusting translation of the root joint, modelNumJoints is actually + 1
-        auto &modelJoints = allJoints[modelIndex];
+        auto &modelJoints = models[modelIndex].getJoints();
         int modelNumJoints = modelJoints.size() + 1;
 
         // Add "root" selector (as a label only) for every model
@@ -125,11 +156,12 @@ void ModelerApplication::Init( int argc, char* argv[], vector<string> &defaultJo
                 slider->hide();
                 m_controlValueSliders[controlIndex] = slider;
                 // Set slider callback
-                slider->callback((Fl_Callback *) ModelerApplication::SliderCallback);
+                slider->callback((Fl_Callback *) ModelerApplication::SliderCallback, (void *) (intptr_t) controlIndex);
 
                 // Finally, specify the mapping from this slider to its corresponding selector / joint
                 m_controlToSelector.push_back(selectorIndex);
                 m_controlToJoint.push_back(pair<int, int>(modelIndex, jointIndex == 0 ? 0 : jointIndex - 1));
+                m_controlToModelControl.push_back(controlIndex - m_modelControlOffsets[modelIndex]);
                 m_controlIsTranslation.push_back(jointIndex == 0);
 
                 // Index for next control
@@ -166,14 +198,54 @@ int ModelerApplication::Run()
     return Fl::run();
 }
 
+SkeletalModel &ModelerApplication::getControlModel(int controlNumber, int &modelControl)
+{
+    modelControl = m_controlToModelControl[controlNumber];
+    return m_ui->m_modelerView->state().models[m_controlToJoint[controlNumber].first];
+}
+
 double ModelerApplication::GetControlValue(int controlNumber)
 {
-    return m_controlValueSliders[controlNumber]->value();
+    // The pose buffers are authoritative; sliders may lag behind
+    int modelControl;
+    SkeletalModel &model = getControlModel(controlNumber, modelControl);
+    return model.getPose()[modelControl];
 }
 
 void ModelerApplication::SetControlValue(int controlNumber, double value)
 {
-    m_controlValueSliders[controlNumber]->value(value);
+    setControl(controlNumber, (float) value);
+    posesChanged();
+}
+
+void ModelerApplication::setControl(int controlNumber, float value)
+{
+    int modelControl;
+    SkeletalModel &model = getControlModel(controlNumber, modelControl);
+    model.setControlValue(modelControl, value);
+    m_ui->m_modelerView->state().controlChanged(m_controlToJoint[controlNumber].first);
+}
+
+void ModelerApplication::posesChanged()
+{
+    // Mirror the poses into the sliders a few times per second at most, not on every frame
+    if (!m_mirrorScheduled) {
+        m_mirrorScheduled = true;
+        Fl::add_timeout(0.1, MirrorSliders, this);
+    }
+}
+
+void ModelerApplication::MirrorSliders(void *that)
+{
+    ModelerApplication *app = static_cast<ModelerApplication*>(that);
+    app->m_mirrorScheduled = false;
+
+    // Hidden sliders are refreshed when they are shown
+    for (int i = 0; i < app->m_numControls; ++i) {
+        Fl_Value_Slider *slider = app->m_controlValueSliders[i];
+        if (slider->visible() && slider->value() != app->GetControlValue(i))
+            slider->value(app->GetControlValue(i));
+    }
 }
 
 unsigned ModelerApplication::GetNumControls()
@@ -183,6 +255,7 @@ unsigned ModelerApplication::GetNumControls()
 
 void ModelerApplication::ShowControl(int controlNumber)
 {
+    m_controlValueSliders[controlNumber]->value(GetControlValue(controlNumber));
     m_controlLabelBoxes[controlNumber]->show();
     m_controlValueSliders[controlNumber]->show();
 }
@@ -193,9 +266,17 @@ void ModelerApplication::HideControl(int controlNumber)
     m_controlValueSliders[controlNumber]->hide();
 }
 
-void ModelerApplication::SliderCallback(Fl_Slider *, void *)
+void ModelerApplication::SliderCallback(Fl_Slider *slider, void *controlNumber)
 {
+    TraceSpan span("slider", "control", (intptr_t) controlNumber);
+
+    // Write the new value into the pose buffer of its model
     auto app = ModelerApplication::Instance();
+    app->m_ui->m_modelerView->latency().eventReceived((int) (intptr_t) controlNumber);
+    app->m_ui->m_modelerView->recording().record(InputRecording::SLIDER, (int) (intptr_t) controlNumber, 0, 0,
+        (float) slider->value());
+    app->setControl((int) (intptr_t) controlNumber, (float) slider->value());
+
     app->m_ui->m_modelerView->update();
     app->m_ui->m_modelerView->redraw();
 }
@@ -204,13 +285,14 @@ int ModelerApplication::getControlToSelector(int controlIndex) {
     return m_controlToSelector[controlIndex];
 }
 
+int ModelerApplication::getJointToControl(int modelIndex, int jointIndex, bool isTranslation) {
+    // Controls of a model: the root translation, then the rotation of every joint
+    return m_modelControlOffsets[modelIndex] + (isTranslation ? 0 : 3 + 3 * jointIndex);
+}
+
 Vector3f ModelerApplication::getJointToControlValues(int modelIndex, int jointIndex, bool isTranslation) {
-    for (int i = 0; i < m_numControls; ++i) {
-        auto p = m_controlToJoint[i];
-        if (p.first == modelIndex && p.second == jointIndex && m_controlIsTranslation[i] == isTranslation)
-            return Vector3f(GetControlValue(i), GetControlValue(i + 1), GetControlValue(i + 2));
-    }
-    return NULL;
+    int i = getJointToControl(modelIndex, jointIndex, isTranslation);
+    return Vector3f(GetControlValue(i), GetControlValue(i + 1), GetControlValue(i + 2));
 }
 
 bool ModelerApplication::getControlIsTranslation(int controlIndex) {
@@ -30,24 +30,30 @@ public:
     // Starts the application, returns when application is closed
     int Run();
 
-    // Get and set slider values.
+    // Get and set control values. They live in the pose buffers of the
+    // models; the sliders only mirror them (see posesChanged()).
     double GetControlValue(int controlNumber);
     void SetControlValue(int controlNumber, double value);
     unsigned GetNumControls();
 
     // Extra: Get the mapping from control to selector
     int getControlToSelector(int controlIndex);
-    // Extra: Get the mapping from joint to control values
+    // Extra: Get the mapping from joint to its first control (X), and to the control values
+    int getJointToControl(int modelIndex, int jointIndex, bool isTranslation);
     Vector3f getJointToControlValues(int modelIndex, int jointIndex, bool isTranslation);
     // Extra: Check whether a control type is translation
     bool getControlIsTranslation(int controlIndex);
 
+    // Extra: Call after writing the pose buffers of the models directly,
+    // so that the visible sliders are refreshed soon
+    void posesChanged();
+
     // Redraw trigger
     void redrawControlsWindow();
 
 private:
     // Private for singleton
-    ModelerApplication() : m_numControls(-1) { }
+    ModelerApplication() : m_numControls(-1), m_mirrorScheduled(false) { }
     ModelerApplication(const ModelerApplication &) { }
 
     // The instance
@@ -55,6 +61,11 @@ private:
 
     friend class ModelerUserInterface;
 
+    // Model of a control, and the index of the control within the model
+    SkeletalModel &getControlModel(int controlNumber, int &modelControl);
+    // Write a control into the pose buffer of its model
+    void setControl(int controlNumber, float value);
+
     void ShowControl(int controlNumber);
     void HideControl(int controlNumber);
 
@@ -62,9 +73,14 @@ private:
 
     int m_numControls;
 
-    // Mapping between controls, selectors and joints
+    // Mapping between controls, selectors and joints, all built in Init().
+    // m_modelControlOffsets holds the first control of every model (and the
+    // total at the end); m_controlToModelControl the index of a control among
+    // the controls of its model.
     vector<pair<int, int>> m_controlToJoint;
     vector<int> m_controlToSelector;
+    vector<int> m_modelControlOffsets;
+    vector<int> m_controlToModelControl;
 
     // Control type (translation / rotation)
     vector<bool> m_controlIsTranslation;
@@ -73,6 +89,8 @@ private:
     Fl_Value_Slider ** m_controlValueSliders;
 
     static void SliderCallback(Fl_Slider *, void *);
+    static void MirrorSliders(void *);
+    bool m_mirrorScheduled;
     static void RedrawLoop(void *);
 };
 
@@ -2,18 +2,8 @@
 
 #include "modelerui.h"
 
-static inline void loadPosFile(string filename, vector<float> &posArray) {
-    // cout << filename << endl;
-    ifstream file(filename);
-    int index;
-    float val;
-    while (file >> index >> val) {
-        posArray.push_back(val);
-    }
-    file.close();
-}
-
 inline void ModelerUserInterface::cb_m_controlsWindow_i(Fl_Double_Window*, void*) {
+    m_modelerView->saveOnExit();
     exit(0);
 }
 void ModelerUserInterface::cb_m_controlsWindow(Fl_Double_Window* o, void* v) {
@@ -75,6 +65,8 @@ inline void ModelerUserInterface::cb_Open_i(Fl_Menu_*, void*) {
 
         int controlNum;
         float value;
+        std::vector<int> controls;
+        std::vector<float> values;
         while( ifs >> controlNum >> value )
         {
             if( controlNum >= ModelerApplication::Instance()->GetNumControls() ) {
@@ -82,7 +74,10 @@ inline void ModelerUserInterface::cb_Open_i(Fl_Menu_*, void*) {
             }
 
             ModelerApplication::Instance()->SetControlValue(controlNum, value);
+            controls.push_back(controlNum);
+            values.push_back(value);
         }
+        m_modelerView->recording().recordPositions(controls, values);
 
         m_modelerView->update();
         m_modelerView->redraw();
@@ -118,6 +113,7 @@ void ModelerUserInterface::cb_Save1(Fl_Menu_* o, void* v) {
 }
 
 inline void ModelerUserInterface::cb_Exit_i(Fl_Menu_*, void*) {
+    m_modelerView->saveOnExit();
     m_controlsWindow->hide();
     m_modelerWindow->hide();
 }
@@ -136,70 +132,40 @@ Fl_Menu_Item ModelerUserInterface::menu_m_controlsMenuBar[] = {
     // {"Enable", 0,  (Fl_Callback*)ModelerUserInterface::cb_m_controlsAnimOnMenu, 0, 2, 0, 0, 14, 56},
     {"Load Animation File", 0, (Fl_Callback*)ModelerUserInterface::cb_Load_Animate, 0, 128, 0, 0, 14, 56},
     {"Play Animation Once", 0, (Fl_Callback*)ModelerUserInterface::cb_Play_Animate_Once, 0, 0, 0, 0, 14, 56},
-    {"Play Animation Repeatedly", 0, (Fl_Callback*)ModelerUserInterface::cb_Play_Animate_Repeat, 0, 2, 0, 0, 14, 56},
+    {"Play Animation Repeatedly", 0, (Fl_Callback*)ModelerUserInterface::cb_Play_Animate_Repeat, 0, 130, 0, 0, 14, 56},
+    {"Capture Frames", 0, (Fl_Callback*)ModelerUserInterface::cb_Capture, 0, 2, 0, 0, 14, 56},
+    {"Cache Skinned Frames", 0, (Fl_Callback*)ModelerUserInterface::cb_Cache, 0, 2, 0, 0, 14, 56},
+    {"Skin Next Frame in Background", 0, (Fl_Callback*)ModelerUserInterface::cb_Pipeline, 0, 2, 0, 0, 14, 56},
     {0,0,0,0,0,0,0,0,0},
     {0,0,0,0,0,0,0,0,0}
 };
 Fl_Menu_Item* ModelerUserInterface::m_controlsAnimOnMenu = ModelerUserInterface::menu_m_controlsMenuBar + 9;
+Fl_Menu_Item* ModelerUserInterface::m_controlsCaptureMenu = ModelerUserInterface::menu_m_controlsMenuBar + 10;
+Fl_Menu_Item* ModelerUserInterface::m_controlsCacheMenu = ModelerUserInterface::menu_m_controlsMenuBar + 11;
+Fl_Menu_Item* ModelerUserInterface::m_controlsPipelineMenu = ModelerUserInterface::menu_m_controlsMenuBar + 12;
 
 void ModelerUserInterface::cb_Load_Animate_i(Fl_Menu_* o, void* v) {
     // If playing animation now, then do nothing
     if (m_animating) return;
 
     auto app = ModelerApplication::Instance();
-    char *animFilename = fl_file_chooser("Load Animation File", "*.anim", NULL);
+    char *animFilename = fl_file_chooser("Load Animation File", "*.{anim,clip}", NULL);
 
     if (animFilename) {
-        ifstream file(animFilename);
-        string filename(animFilename), fileDir;
-        float nextSecs;
-        int nextFrames;
-        vector<float> currentFrameControls;
-
-        fileDir = "";
-        if (filename.find('/') != string::npos)
-            fileDir = filename.substr(0, filename.rfind('/') + 1);
-        m_numFrames = 1;
-        m_animateFrames.clear();
-
-        file >> filename;
-        loadPosFile(fileDir + filename, currentFrameControls);
-        m_animateFrames.push_back(currentFrameControls);
-        int numControls = currentFrameControls.size();
-        auto frameIntervals = vector<float>(numControls);
-        auto temp = vector<float>(numControls);
-        while (file >> nextSecs >> filename) {
-            nextFrames = (int) ceil(nextSecs * m_animateFps);
-            currentFrameControls.clear();
-            loadPosFile(fileDir + filename, currentFrameControls);
-            auto &lastFrameControls = m_animateFrames.back();
-            // Determine the interpolation interval for each control
-            for (int i = 0; i < numControls; ++i) {
-                // If the i-th control is for root translation, then interpolate as usual
-                if (app->getControlIsTranslation(i)) {
-                    frameIntervals[i] = (currentFrameControls[i] - lastFrameControls[i]) / nextFrames;
-                }
-                else {
-                    float lastVal = lastFrameControls[i] + M_PI,
-                        currentVal = currentFrameControls[i] + M_PI;
-                    frameIntervals[i] = (abs(currentVal - lastVal) < 2 * M_PI - abs(currentVal - lastVal)
-                        ? (currentVal - lastVal)
-                        : (currentVal - lastVal < 0
-                            ? 2 * M_PI - currentVal + lastVal
-                            : currentVal - lastVal - 2 * M_PI)) / nextFrames;
-                }
-            }
-            // Insert interpolated frame controls
-            temp = lastFrameControls;
-            for (int i = 0; i < nextFrames; ++i) {
-                for (int j = 0; j < numControls; ++j)
-                    temp[j] += frameIntervals[j];
-                m_animateFrames.push_back(temp);
-            }
-            m_numFrames += nextFrames;
-        }
-        file.close();
-        cout << "Animation file loaded. " << m_numFrames << " frames in total." << endl;
+        auto controlIsTranslation = vector<bool>(app->GetNumControls());
+        for (int i = 0, numControls = controlIsTranslation.size(); i < numControls; ++i)
+            controlIsTranslation[i] = app->getControlIsTranslation(i);
+
+        // Only the keyframes are kept; frames are sampled from them while playing
+        m_clip.reset(loadAnimationClip(animFilename, controlIsTranslation));
+        m_modelerView->recording().recordText(InputRecording::LOAD_ANIMATION, animFilename);
+        m_numFrames = m_clip ? m_clip->numFrames(m_animateFps) : 0;
+        if (m_clip)
+            cout << "Animation file loaded. " << m_clip->duration() << " seconds." << endl;
+        else
+            cerr << "Error: couldn't read animation file " << animFilename << endl;
+        m_modelerView->state().cancelFrameAhead();
+        setupVertexCache();
     }
 }
 
@@ -215,9 +181,9 @@ void ModelerUserInterface::cb_Play_Animate_Once_i(Fl_Menu_* o, void* v) {
     if (m_animating) return;
 
     // Notify timer function to play animation
-    m_currentFrame = 0;
-    m_startTime = 0;
+    m_scheduler.start(m_numFrames, m_animateFps, false);
     m_animating = true;
+    m_modelerView->recording().record(InputRecording::PLAY, InputRecording::PLAY_ONCE);
 }
 
 void ModelerUserInterface::cb_Play_Animate_Once(Fl_Menu_* o, void* v) {
@@ -226,15 +192,18 @@ void ModelerUserInterface::cb_Play_Animate_Once(Fl_Menu_* o, void* v) {
 
 void ModelerUserInterface::cb_Play_Animate_Repeat_i(Fl_Menu_* o, void* v) {
     m_isPlayRepeat = m_controlsAnimOnMenu->value() != 0;
+    m_modelerView->recording().record(InputRecording::PLAY, m_isPlayRepeat ? InputRecording::PLAY_REPEAT
+        : InputRecording::STOP);
     if (m_isPlayRepeat) {
         if (m_numFrames > 0) {
-            m_currentFrame = 0;
-            m_startTime = 0;
+            m_scheduler.start(m_numFrames, m_animateFps, true);
             m_animating = true;
         }
     }
-    else {
+    else if (m_animating) {
+        m_scheduler.stop();
         m_animating = false;
+        reportPlayback();
     }
 }
 
@@ -242,6 +211,65 @@ void ModelerUserInterface::cb_Play_Animate_Repeat(Fl_Menu_* o, void* v) {
     ((ModelerUserInterface*)(o->parent()->user_data()))->cb_Play_Animate_Repeat_i(o, v);
 }
 
+void ModelerUserInterface::cb_Capture_i(Fl_Menu_* o, void* v) {
+    if (m_controlsCaptureMenu->value() == 0) {
+        m_modelerView->stopCapture();
+        return;
+    }
+
+    char *filename = fl_file_chooser("Capture Frames To", "*.{bmp,png,ppm,y4m}", NULL);
+    string path = filename ? filename : "";
+    // Image sequences need a frame number in their name
+    CaptureFormat format = FrameCapture::formatFromPath(path);
+    if ((format == CAPTURE_BMP || format == CAPTURE_PNG) && path.find('%') == string::npos) {
+        size_t dot = path.rfind('.');
+        path.insert(dot == string::npos ? path.size() : dot, "%04d");
+    }
+
+    if (!filename || !m_modelerView->startCapture(path, m_animateFps))
+        m_controlsCaptureMenu->clear();
+}
+
+void ModelerUserInterface::cb_Capture(Fl_Menu_* o, void* v) {
+    ((ModelerUserInterface*)(o->parent()->user_data()))->cb_Capture_i(o, v);
+}
+
+void ModelerUserInterface::cb_Cache_i(Fl_Menu_* o, void* v) {
+    m_modelerView->recording().record(InputRecording::CACHE, m_controlsCacheMenu->value() != 0);
+    setupVertexCache();
+}
+
+void ModelerUserInterface::cb_Cache(Fl_Menu_* o, void* v) {
+    ((ModelerUserInterface*)(o->parent()->user_data()))->cb_Cache_i(o, v);
+}
+
+void ModelerUserInterface::cb_Pipeline_i(Fl_Menu_* o, void* v) {
+    m_modelerView->recording().record(InputRecording::PIPELINE, m_controlsPipelineMenu->value() != 0);
+    // Frames are skinned ahead from the next one on
+    if (m_controlsPipelineMenu->value() == 0)
+        m_modelerView->state().cancelFrameAhead();
+}
+
+void ModelerUserInterface::cb_Pipeline(Fl_Menu_* o, void* v) {
+    ((ModelerUserInterface*)(o->parent()->user_data()))->cb_Pipeline_i(o, v);
+}
+
+void ModelerUserInterface::setupVertexCache() {
+    // The frames of the previous animation (or of no animation) are useless
+    auto &cache = m_modelerView->state().vertexCache;
+    cache.destroy();
+    if (m_controlsCacheMenu->value() == 0 || m_numFrames == 0)
+        return;
+
+    // Frames are stored as they are first played; over budget, every frame is skinned live
+    auto &models = m_modelerView->state().models;
+    if (cache.create(models, m_numFrames, m_vertexCacheBudget))
+        cout << "Caching skinned frames: " << cache.sizeInBytes() / (1 << 20) << " MB." << endl;
+    else
+        cout << "Not caching skinned frames: they need " << VertexCache::requiredBytes(models, m_numFrames) / (1 << 20)
+            << " MB, over the budget of " << m_vertexCacheBudget / (1 << 20) << " MB." << endl;
+}
+
 inline void ModelerUserInterface::cb_m_controlsBrowser_i(Fl_Browser*, void*) {
     auto app = ModelerApplication::Instance();
     for (int i = 0, numControls = app->GetNumControls(); i < numControls; ++i) {
@@ -258,6 +286,7 @@ void ModelerUserInterface::cb_m_controlsBrowser(Fl_Browser* o, void* v) {
 }
 
 inline void ModelerUserInterface::cb_m_modelerWindow_i(Fl_Double_Window*, void*) {
+    m_modelerView->saveOnExit();
     exit(0);
 }
 void ModelerUserInterface::cb_m_modelerWindow(Fl_Double_Window* o, void* v) {
@@ -310,6 +339,7 @@ ModelerUserInterface::ModelerUserInterface() {
 
     m_animateFps = 30;
     m_numFrames = 0;
+    m_vertexCacheBudget = (size_t) 512 << 20;
     m_isPlayRepeat = m_animating = false;
     // Set up timer function for playing animation
     Fl::add_timeout(1.0 / m_animateFps, animationCallback, (void *)this);
@@ -317,29 +347,52 @@ ModelerUserInterface::ModelerUserInterface() {
 
 void ModelerUserInterface::animationCallback(void *that) {
     ModelerUserInterface *ui = static_cast<ModelerUserInterface*>(that);
-    double delaySecs = 1.0 / ui->m_animateFps;
-    if (ui->m_startTime > 0) {
-        float elapsedTime = (float)(clock() - ui->m_startTime) / CLOCKS_PER_SEC;
-        delaySecs += delaySecs - elapsedTime;
-    }
-    ui->m_startTime = clock();
-    Fl::repeat_timeout(max(delaySecs, 0.001), animationCallback, that);
 
-    // If it is animating now, then render the current frame
-    if (ui->m_animating) {
-        auto &controls = ui->m_animateFrames[ui->m_currentFrame];
+    // If it is animating now, then render the frame due now (frames already past are skipped)
+    float t;
+    if (ui->m_animating && ui->m_scheduler.beginFrame(t)) {
+        // Pose the models directly (unless the frame was skinned ahead); the sliders catch up later
+        auto &controls = ui->m_animateControls;
+        auto &rotations = ui->m_animateRotations;
         auto app = ModelerApplication::Instance();
-        for (int i = 0, numControls = controls.size(); i < numControls; ++i) {
-            app->SetControlValue(i, controls[i]);
+        int count = min((int) ui->m_clip->numControls(), (int) app->GetNumControls());
+        unsigned frame = ui->m_scheduler.currentFrame();
+        ui->m_modelerView->recording().record(InputRecording::ANIMATION_FRAME, frame);
+        ViewState &state = ui->m_modelerView->state();
+        if (!state.presentFrame(frame)) {
+            ui->m_clip->sample(t, controls, rotations);
+            state.setControlValues(controls.data(), rotations.data(), count);
+            ui->m_modelerView->updateFrame(frame);
+        }
+        app->posesChanged();
+
+        // Skin the next frame while this one is drawn
+        bool last = !ui->m_isPlayRepeat && frame + 1 >= ui->m_numFrames;
+        if (ui->m_controlsPipelineMenu->value() != 0 && !last) {
+            unsigned next = (frame + 1) % ui->m_numFrames;
+            ui->m_clip->sample((float) next / ui->m_animateFps, controls, rotations);
+            state.skinFrameAhead(next, controls.data(), rotations.data(), count);
         }
-        ui->m_modelerView->update();
         ui->m_modelerView->redraw();
-        ui->m_currentFrame = (ui->m_currentFrame + 1) % ui->m_numFrames;
+        // Draw right away, so that the frame budget covers both update and draw
+        Fl::flush();
+        ui->m_scheduler.endFrame();
+    }
 
-        // Stop animating if the user only wants to play once, and the last frame is shown
-        if (ui->m_currentFrame == 0 && !ui->m_isPlayRepeat)
-            ui->m_animating = false;
+    // Stop animating if the user only wants to play once, and the last frame is shown
+    if (ui->m_animating && !ui->m_scheduler.playing()) {
+        ui->m_animating = false;
+        ui->reportPlayback();
     }
+
+    // Wake up when the next frame is due, measured from the start of playback so that errors do not accumulate
+    double delaySecs = ui->m_animating ? ui->m_scheduler.secondsToNextFrame() : 1.0 / ui->m_animateFps;
+    Fl::add_timeout(max(delaySecs, 0.001), animationCallback, that);
+}
+
+void ModelerUserInterface::reportPlayback() {
+    cout << "Animation played: " << m_scheduler.onTimeFrames() << " frames on time, "
+        << m_scheduler.lateFrames() << " late, " << m_scheduler.droppedFrames() << " dropped." << endl;
 }
 
 void ModelerUserInterface::show() {
@@ -9,8 +9,11 @@
 #include <FL/Fl_File_Chooser.H>
 #include <FL/fl_message.H>
 #include "bitmap.h"
+#include "Animation.h"
+#include "AnimationScheduler.h"
 #include <iostream>
 #include <fstream>
+#include <memory>
 #include "camera.h"
 #include <FL/Fl_Browser.H>
 #include <FL/Fl_Scroll.H>
@@ -39,12 +42,17 @@ private:
   static void cb_Exit(Fl_Menu_*, void*);
 public:
   static Fl_Menu_Item *m_controlsAnimOnMenu;
+  static Fl_Menu_Item *m_controlsCaptureMenu;
+  static Fl_Menu_Item *m_controlsCacheMenu;
+  static Fl_Menu_Item *m_controlsPipelineMenu;
   unsigned int m_animateFps;
   unsigned int m_numFrames;
-  unsigned int m_currentFrame;
   bool m_isPlayRepeat;
   bool m_animating;
-  vector<vector<float>> m_animateFrames;
+  std::unique_ptr<AnimationClip> m_clip;
+  size_t m_vertexCacheBudget;
+  vector<float> m_animateControls;
+  vector<Quat4f> m_animateRotations;
 private:
   void cb_Load_Animate_i(Fl_Menu_*, void*);
   static void cb_Load_Animate(Fl_Menu_*, void*);
@@ -52,7 +60,15 @@ private:
   static void cb_Play_Animate_Once(Fl_Menu_*, void*);
   void cb_Play_Animate_Repeat_i(Fl_Menu_*, void*);
   static void cb_Play_Animate_Repeat(Fl_Menu_*, void*);
+  void cb_Capture_i(Fl_Menu_*, void*);
+  static void cb_Capture(Fl_Menu_*, void*);
+  void cb_Cache_i(Fl_Menu_*, void*);
+  static void cb_Cache(Fl_Menu_*, void*);
+  void setupVertexCache();
+  void cb_Pipeline_i(Fl_Menu_*, void*);
+  static void cb_Pipeline(Fl_Menu_*, void*);
   static void animationCallback(void*);
+  void reportPlayback();
 public:
   Fl_Browser *m_controlsBrowser;
 private:
@@ -69,6 +85,6 @@ public:
   ModelerView *m_modelerView;
   void show();
 private:
-  clock_t m_startTime;
+  AnimationScheduler m_scheduler;
 };
 #endif
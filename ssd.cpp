@@ -0,0 +1,255 @@
+#include "ssd.h"
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "SkeletalModel.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+struct ssd_model
+{
+	// Taken by every call that reads or writes the pose, or uses the scratch space
+	mutex lock;
+	SkeletalModel model;
+
+	// Fixed once loaded, so they are read without the lock
+	int numJoints, numVertices, numFaces;
+
+	// Batches run on the calling thread without a pool
+	unique_ptr<ThreadPool> pool;
+
+	// Per thread of a batch: a pose converted to the layout of skinPose()
+	struct Scratch
+	{
+		vector<Quat4f> rotations;
+		vector<Matrix4f> jointTransforms;
+	};
+	vector<Scratch> scratch;
+};
+
+// The last failure of each thread, for ssd_last_error(). The library reports
+// through it and the status codes only, never on the host's standard streams.
+static thread_local string lastError;
+
+static ssd_status invalidArgument(const char *function)
+{
+	lastError = string(function) + ": a NULL pointer, an index out of range or a stride too small";
+	return SSD_INVALID_ARGUMENT;
+}
+
+static size_t rotationSize(ssd_rotation_format format)
+{
+	return format == SSD_QUATERNION ? 4 : 3;
+}
+
+static bool validFormat(ssd_rotation_format format)
+{
+	return format == SSD_EULER_XYZ || format == SSD_QUATERNION;
+}
+
+static bool validStride(const float *buffer, size_t stride)
+{
+	return !buffer || stride >= 3 * sizeof(float);
+}
+
+// The rotations of a quaternion pose, one per control track as setControlValues()
+// and skinPose() take them (the first, the root translation's, is unused)
+static const Quat4f *quaternionTracks(const float *pose, int numJoints, vector<Quat4f> &rotations)
+{
+	rotations.resize(numJoints + 1);
+	for (int j = 0; j < numJoints; ++j) {
+		const float *q = pose + 3 + 4 * j;
+		rotations[j + 1] = Quat4f(q[0], q[1], q[2], q[3]);
+	}
+	return rotations.data();
+}
+
+int ssd_api_version(void)
+{
+	return SSD_API_VERSION;
+}
+
+const char *ssd_last_error(void)
+{
+	return lastError.c_str();
+}
+
+ssd_model *ssd_model_load(const char *prefix)
+{
+	if (!prefix) {
+		invalidArgument(__func__);
+		return NULL;
+	}
+	string skeletonFile = string(prefix) + ".skel";
+	string meshFile = string(prefix) + ".obj";
+	string attachmentsFile = string(prefix) + ".attach";
+	return ssd_model_load_files(skeletonFile.c_str(), meshFile.c_str(), attachmentsFile.c_str());
+}
+
+ssd_model *ssd_model_load_files(const char *skeletonFile, const char *meshFile, const char *attachmentsFile)
+{
+	if (!skeletonFile || !meshFile || !attachmentsFile) {
+		invalidArgument(__func__);
+		return NULL;
+	}
+	for (const char *filename : { skeletonFile, meshFile, attachmentsFile })
+		if (!ifstream(filename)) {
+			lastError = string("couldn't read ") + filename;
+			return NULL;
+		}
+
+	unique_ptr<ssd_model> model(new ssd_model);
+	model->model.load(skeletonFile, meshFile, attachmentsFile);
+	const Mesh &mesh = model->model.getMesh();
+	model->numJoints = model->model.getJoints().size();
+	model->numVertices = mesh.bindVertices.size();
+	model->numFaces = mesh.faces.size();
+	if (model->numJoints == 0 || model->numVertices == 0) {
+		lastError = string("no joints or no vertices in ") + skeletonFile + " and " + meshFile;
+		ssd_model_free(model.release());
+		return NULL;
+	}
+	model->scratch.resize(1);
+	return model.release();
+}
+
+void ssd_model_free(ssd_model *model)
+{
+	if (!model)
+		return;
+	// SkeletalModel is copied by value in the modeler, so it leaves its joints alive
+	for (Joint *joint : model->model.getJoints())
+		delete joint;
+	delete model;
+}
+
+int ssd_model_num_joints(const ssd_model *model)
+{
+	return model ? model->numJoints : 0;
+}
+
+int ssd_model_num_vertices(const ssd_model *model)
+{
+	return model ? model->numVertices : 0;
+}
+
+int ssd_model_num_faces(const ssd_model *model)
+{
+	return model ? model->numFaces : 0;
+}
+
+int ssd_model_pose_size(const ssd_model *model, ssd_rotation_format format)
+{
+	return model && validFormat(format) ? 3 + model->numJoints * (int) rotationSize(format) : 0;
+}
+
+ssd_status ssd_model_faces(ssd_model *model, unsigned *indices)
+{
+	if (!model || !indices)
+		return invalidArgument(__func__);
+	const vector<Tuple3u> &faces = model->model.getMesh().faces;
+	for (size_t i = 0; i < faces.size(); ++i)
+		for (int k = 0; k < 3; ++k)
+			indices[3 * i + k] = faces[i][k] - 1;
+	return SSD_OK;
+}
+
+ssd_status ssd_model_set_threads(ssd_model *model, int numThreads)
+{
+	if (!model || numThreads < 0)
+		return invalidArgument(__func__);
+	lock_guard<mutex> guard(model->lock);
+	model->pool.reset(numThreads == 1 ? NULL : new ThreadPool(numThreads));
+	model->scratch.resize(model->pool ? model->pool->size() : 1);
+	return SSD_OK;
+}
+
+ssd_status ssd_model_set_joint_rotations(ssd_model *model, int firstJoint, int numJoints,
+	ssd_rotation_format format, const float *rotations)
+{
+	if (!model || !rotations || !validFormat(format) || firstJoint < 0 || numJoints < 0
+		|| firstJoint + numJoints > model->numJoints)
+		return invalidArgument(__func__);
+	lock_guard<mutex> guard(model->lock);
+	for (int j = 0; j < numJoints; ++j) {
+		const float *rotation = rotations + j * rotationSize(format);
+		int joint = firstJoint + j;
+		if (format == SSD_QUATERNION)
+			model->model.setJointRotation(joint, Quat4f(rotation[0], rotation[1], rotation[2], rotation[3]));
+		else
+			for (int k = 0; k < 3; ++k)
+				model->model.setControlValue(3 + 3 * joint + k, rotation[k]);
+	}
+	return SSD_OK;
+}
+
+ssd_status ssd_model_set_root_translation(ssd_model *model, const float *translation)
+{
+	if (!model || !translation)
+		return invalidArgument(__func__);
+	lock_guard<mutex> guard(model->lock);
+	for (int k = 0; k < 3; ++k)
+		model->model.setControlValue(k, translation[k]);
+	return SSD_OK;
+}
+
+ssd_status ssd_model_set_pose(ssd_model *model, ssd_rotation_format format, const float *pose)
+{
+	if (!model || !pose || !validFormat(format))
+		return invalidArgument(__func__);
+	lock_guard<mutex> guard(model->lock);
+	if (format == SSD_QUATERNION)
+		model->model.setControlValues(pose, quaternionTracks(pose, model->numJoints, model->scratch[0].rotations));
+	else
+		model->model.setControlValues(pose);
+	return SSD_OK;
+}
+
+ssd_status ssd_model_skin(ssd_model *model, float *vertices, size_t vertexStride, float *normals,
+	size_t normalStride)
+{
+	if (!model || !vertices || !validStride(vertices, vertexStride) || !validStride(normals, normalStride))
+		return invalidArgument(__func__);
+	lock_guard<mutex> guard(model->lock);
+	model->model.updateCurrentJointToWorldTransforms();
+	model->model.skinMesh(vertices, vertexStride, normals, normalStride);
+	return SSD_OK;
+}
+
+ssd_status ssd_model_skin_poses(ssd_model *model, int numPoses, ssd_rotation_format format,
+	const float *poses, size_t poseStride,
+	float *vertices, size_t vertexStride, size_t vertexPoseStride,
+	float *normals, size_t normalStride, size_t normalPoseStride)
+{
+	if (!model || numPoses < 0 || !poses || !vertices || !validFormat(format)
+		|| poseStride < ssd_model_pose_size(model, format) * sizeof(float)
+		|| !validStride(vertices, vertexStride) || !validStride(normals, normalStride))
+		return invalidArgument(__func__);
+	lock_guard<mutex> guard(model->lock);
+
+	// The poses are split into one contiguous range per thread, each with its own scratch space
+	int numRanges = max(min((int) model->scratch.size(), numPoses), 1);
+	auto skinRange = [&](int r) {
+		ssd_model::Scratch &scratch = model->scratch[r];
+		for (int p = numPoses * r / numRanges, end = numPoses * (r + 1) / numRanges; p < end; ++p) {
+			const float *pose = (const float *) ((const char *) poses + p * poseStride);
+			const Quat4f *rotations = format == SSD_QUATERNION
+				? quaternionTracks(pose, model->numJoints, scratch.rotations) : NULL;
+			float *poseVertices = (float *) ((char *) vertices + p * vertexPoseStride);
+			float *poseNormals = normals ? (float *) ((char *) normals + p * normalPoseStride) : NULL;
+			model->model.skinPose(pose, rotations, scratch.jointTransforms, poseVertices, vertexStride,
+				poseNormals, normalStride);
+		}
+	};
+	if (numRanges > 1)
+		model->pool->parallelFor(numRanges, skinRange);
+	else
+		skinRange(0);
+	return SSD_OK;
+}
@@ -0,0 +1,96 @@
+#ifndef SSD_H
+#define SSD_H
+
+// C API of ssd_core, to load models and skin them from other programs and
+// languages without the modeler UI.
+//
+// Every function taking a model may be called from any thread: calls on the
+// same model are serialized by a lock of that model, and calls on different
+// models run concurrently. Buffers are always the caller's; nothing is copied
+// out of them or kept after a call returns.
+//
+// Poses use the control layout of the modeler UI: the root translation (3
+// floats, added to the root's offset), then the rotation of every joint in the
+// order of the .skel file, either as XYZ Euler angles in radians (3 floats,
+// composed as Rx * Ry * Rz) or as unit quaternions (4 floats, w x y z).
+//
+// Skinned vertices and normals are written as 3 floats each, stride bytes
+// apart, so they can go straight into interleaved vertex buffers. There is one
+// normal per face (see ssd_model_faces()).
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Incremented whenever a function or a layout changes incompatibly
+#define SSD_API_VERSION 1
+
+typedef struct ssd_model ssd_model;
+
+typedef enum ssd_status
+{
+	SSD_OK = 0,
+	SSD_INVALID_ARGUMENT = -1	// a NULL pointer, an index out of range or a stride too small
+} ssd_status;
+
+typedef enum ssd_rotation_format
+{
+	SSD_EULER_XYZ = 0,		// 3 floats per joint
+	SSD_QUATERNION = 1		// 4 floats per joint
+} ssd_rotation_format;
+
+// SSD_API_VERSION of the library, to check it against the header
+int ssd_api_version( void );
+
+// What the last failing call of the calling thread failed on; a call that
+// succeeds leaves it as is. Nothing is ever written to stdout or stderr.
+const char* ssd_last_error( void );
+
+// Load PREFIX.skel, PREFIX.obj and PREFIX.attach, in the bind pose.
+// Returns NULL if a file cannot be read or holds no joints or vertices.
+ssd_model* ssd_model_load( const char* prefix );
+ssd_model* ssd_model_load_files( const char* skeletonFile, const char* meshFile, const char* attachmentsFile );
+void ssd_model_free( ssd_model* model );
+
+int ssd_model_num_joints( const ssd_model* model );
+int ssd_model_num_vertices( const ssd_model* model );
+int ssd_model_num_faces( const ssd_model* model );
+
+// Floats of one pose in the given format
+int ssd_model_pose_size( const ssd_model* model, ssd_rotation_format format );
+
+// The 0-based vertex indices of every face, 3 per face
+ssd_status ssd_model_faces( ssd_model* model, unsigned* indices );
+
+// Threads that ssd_model_skin_poses() splits a batch over, the calling thread
+// included; 0 means one per hardware thread. The default is 1.
+ssd_status ssd_model_set_threads( ssd_model* model, int numThreads );
+
+// Set the rotations of joints [firstJoint, firstJoint + numJoints) from one
+// array, in the given format; the other joints keep theirs
+ssd_status ssd_model_set_joint_rotations( ssd_model* model, int firstJoint, int numJoints,
+	ssd_rotation_format format, const float* rotations );
+ssd_status ssd_model_set_root_translation( ssd_model* model, const float* translation );
+// Set the whole pose (ssd_model_pose_size() floats)
+ssd_status ssd_model_set_pose( ssd_model* model, ssd_rotation_format format, const float* pose );
+
+// Skin the model in its current pose into vertices, and into normals unless
+// it is NULL
+ssd_status ssd_model_skin( ssd_model* model, float* vertices, size_t vertexStride, float* normals,
+	size_t normalStride );
+
+// Skin numPoses poses, poseStride bytes apart in poses, without changing the
+// pose of the model. The vertices (and normals, unless NULL) of pose p start
+// at p * vertexPoseStride (and p * normalPoseStride) bytes into the buffers.
+ssd_status ssd_model_skin_poses( ssd_model* model, int numPoses, ssd_rotation_format format,
+	const float* poses, size_t poseStride,
+	float* vertices, size_t vertexStride, size_t vertexPoseStride,
+	float* normals, size_t normalStride, size_t normalPoseStride );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SSD_H